@@ -39,6 +39,85 @@ function(escape_square_brackets output bracket placeholder placeholder_var outpu
     endif()
 endfunction()
 
+# The argument writing the XML report of a CTest test to a file of the directory
+# named after the test, with the characters unsafe in file names, such as the
+# '/' in the names of parameterized tests, replaced by '_'.
+function(xml_output_param output directory name)
+    string(REGEX REPLACE "[^-.a-zA-Z0-9_]" "_" name "${name}")
+    set(${output} "--cutest_output=xml:${directory}/${name}.xml" PARENT_SCOPE)
+endfunction()
+
+# Add a CTest test running the tests collected in batch_tests, named after the
+# suite when grouping by suite, and reset the batch. Reads and updates the
+# variables of cutest_discover_tests_impl().
+macro(add_batch)
+    if(NOT batch_tests STREQUAL "")
+        math(EXPR batch_index "${batch_index} + 1")
+        if(arg_TEST_GROUP_BY STREQUAL "SUITE")
+            set(batch_name "${pretty_suite}")
+            if(arg_TEST_BATCH_SIZE GREATER 1)
+                string(APPEND batch_name ".batch${batch_index}")
+            endif()
+        else()
+            set(batch_name "${executable_name}.batch${batch_index}")
+        endif()
+        set(testname "${prefix}${batch_name}${suffix}")
+        if(open_sb)
+            string(REPLACE "${open_sb}" "[" testname "${testname}")
+        endif()
+        if(close_sb)
+            string(REPLACE "${close_sb}" "]" testname "${testname}")
+        endif()
+        set(guarded_testname "${open_guard}${testname}${close_guard}")
+
+        # A whole suite is selected by name, keeping the command line short; the
+        # tests are listed one by one otherwise.
+        list(LENGTH batch_tests batch_length)
+        if(arg_TEST_GROUP_BY STREQUAL "SUITE" AND NOT arg_TEST_BATCH_SIZE GREATER 1 AND NOT arg_TEST_FILTER)
+            set(batch_filter "${suite}")
+        else()
+            list(JOIN batch_tests ":" batch_filter)
+        endif()
+        if(NOT "${arg_TEST_XML_OUTPUT_DIR}" STREQUAL "")
+            xml_output_param(TEST_XML_OUTPUT_PARAM "${arg_TEST_XML_OUTPUT_DIR}" "${prefix}${batch_name}${suffix}")
+        else()
+            unset(TEST_XML_OUTPUT_PARAM)
+        endif()
+
+        string(APPEND script "add_test(${guarded_testname} ${launcherArgs}")
+        foreach(arg IN ITEMS
+                "${arg_TEST_EXECUTABLE}"
+                "--cutest_filter=${batch_filter}"
+                ${TEST_XML_OUTPUT_PARAM}
+        )
+            if(arg MATCHES "[^-./:a-zA-Z0-9_]")
+                string(APPEND script " [==[${arg}]==]")
+            else()
+                string(APPEND script " ${arg}")
+            endif()
+        endforeach()
+        if(arg_TEST_EXTRA_ARGS)
+            list(JOIN arg_TEST_EXTRA_ARGS "]==] [==[" extra_args)
+            string(APPEND script " [==[${extra_args}]==]")
+        endif()
+        string(APPEND script ")\n")
+
+        add_command(set_tests_properties
+                    "${guarded_testname}"
+                    PROPERTIES
+                    WORKING_DIRECTORY "${arg_TEST_WORKING_DIR}"
+                    SKIP_REGULAR_EXPRESSION "\\[  SKIPPED \\]|Every selected test passed in a previous run"
+                    ${arg_TEST_PROPERTIES}
+        )
+
+        if(NOT "${testname}" MATCHES [=[(\[|\])]=])
+            string(REPLACE [[;]] [[\\;]] testname "${testname}")
+            list(APPEND tests_buffer "${testname}")
+        endif()
+        set(batch_tests "")
+    endif()
+endmacro()
+
 function(cutest_discover_tests_impl)
 
     set(options "")
@@ -53,6 +132,8 @@ function(cutest_discover_tests_impl)
         CTEST_FILE
         TEST_DISCOVERY_TIMEOUT
         TEST_XML_OUTPUT_DIR
+        TEST_BATCH_SIZE
+        TEST_GROUP_BY
         # The following are all multi-value arguments in cutest_discover_tests(),
         # but they are each given to us as a single argument. We parse them that
         # way to avoid problems with preserving empty list values and escaping.
@@ -79,6 +160,17 @@ function(cutest_discover_tests_impl)
     # is updated to APPEND after the first write.
     set(file_write_mode WRITE)
 
+    # With batching, tests are collected into batches run by a single CTest test
+    # each, instead of one process per test.
+    if(arg_TEST_GROUP_BY STREQUAL "SUITE" OR arg_TEST_BATCH_SIZE GREATER 1)
+        set(batching TRUE)
+    else()
+        set(batching FALSE)
+    endif()
+    get_filename_component(executable_name "${arg_TEST_EXECUTABLE}" NAME_WE)
+    set(batch_tests "")
+    set(batch_index 0)
+
     if(arg_TEST_FILTER)
         set(filter "--cutest_filter=${arg_TEST_FILTER}")
     else()
@@ -148,6 +240,10 @@ function(cutest_discover_tests_impl)
         if(NOT line MATCHES "cutest_main\\.c")
             # Do we have a module name or a test name?
             if(NOT line MATCHES "^  ")
+                if(arg_TEST_GROUP_BY STREQUAL "SUITE")
+                    add_batch()
+                    set(batch_index 0)
+                endif()
                 # Module; remove trailing '.' to get just the name...
                 string(REGEX REPLACE "\\.( *#.*)?$" "" suite "${line}")
                 if(line MATCHES "#")
@@ -172,8 +268,16 @@ function(cutest_discover_tests_impl)
                 endif()
                 string(REGEX REPLACE "^DISABLED_" "" pretty_test "${pretty_test}")
                 string(REGEX REPLACE " +#.*" "" test "${test}")
+                if(batching AND NOT suite MATCHES "^DISABLED_" AND NOT test MATCHES "^DISABLED_")
+                    list(APPEND batch_tests "${suite}.${test}")
+                    list(LENGTH batch_tests batch_length)
+                    if(arg_TEST_BATCH_SIZE GREATER 1 AND NOT batch_length LESS arg_TEST_BATCH_SIZE)
+                        add_batch()
+                    endif()
+                    continue()
+                endif()
                 if(NOT "${arg_TEST_XML_OUTPUT_DIR}" STREQUAL "")
-                    set(TEST_XML_OUTPUT_PARAM "--cutest_output=xml:${arg_TEST_XML_OUTPUT_DIR}/${prefix}${suite}.${test}${suffix}.xml")
+                    xml_output_param(TEST_XML_OUTPUT_PARAM "${arg_TEST_XML_OUTPUT_DIR}" "${prefix}${suite}.${test}${suffix}")
                 else()
                     unset(TEST_XML_OUTPUT_PARAM)
                 endif()
@@ -220,7 +324,7 @@ function(cutest_discover_tests_impl)
                             PROPERTIES
                             ${maybe_disabled}
                             WORKING_DIRECTORY "${arg_TEST_WORKING_DIR}"
-                            SKIP_REGULAR_EXPRESSION "\\[  SKIPPED \\]"
+                            SKIP_REGULAR_EXPRESSION "\\[  SKIPPED \\]|Every selected test passed in a previous run"
                             ${arg_TEST_PROPERTIES}
                 )
 
@@ -254,6 +358,8 @@ function(cutest_discover_tests_impl)
         endif()
     endforeach()
 
+    add_batch()
+
     if(NOT tests_buffer STREQUAL "")
         list(APPEND tests "${tests_buffer}")
     endif()
@@ -281,6 +387,8 @@ if(CMAKE_SCRIPT_MODE_FILE)
             CTEST_FILE ${CTEST_FILE}
             TEST_DISCOVERY_TIMEOUT ${TEST_DISCOVERY_TIMEOUT}
             TEST_XML_OUTPUT_DIR ${TEST_XML_OUTPUT_DIR}
+            TEST_BATCH_SIZE ${TEST_BATCH_SIZE}
+            TEST_GROUP_BY ${TEST_GROUP_BY}
             TEST_EXTRA_ARGS "${TEST_EXTRA_ARGS}"
             TEST_DISCOVERY_EXTRA_ARGS "${TEST_DISCOVERY_EXTRA_ARGS}"
             TEST_PROPERTIES "${TEST_PROPERTIES}"
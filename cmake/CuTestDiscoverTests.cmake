@@ -41,6 +41,9 @@ same as the CuTest name (i.e. ``suite.testcase``); see also
                           [XML_OUTPUT_DIR dir]
                           [DISCOVERY_MODE <POST_BUILD|PRE_TEST>]
                           [DISCOVERY_EXTRA_ARGS args...]
+                          [BATCH_SIZE count]
+                          [GROUP_BY <TEST|SUITE>]
+                          [CACHE_DIR dir]
     )
 
   ``cutest_discover_tests()`` sets up a post-build command on the test 
@@ -133,7 +136,9 @@ same as the CuTest name (i.e. ``suite.testcase``); see also
 
     If specified, the parameter is passed along with ``--cutest_output=xml:``
     to test executable. The actual file name is the same as the test target,
-    including prefix and suffix. This should be used instead of
+    including prefix and suffix, with the characters other than letters,
+    digits, ``-``, ``.`` and ``_`` (such as the ``/`` in the names of
+    parameterized tests) replaced by ``_``. This should be used instead of
     ``EXTRA_ARGS --cutest_output=xml`` to avoid race conditions writing the
     XML result output when using parallel test execution.
 
@@ -158,6 +163,79 @@ same as the CuTest name (i.e. ``suite.testcase``); see also
 
     Any extra arguments to pass on the command line for the discovery command.
 
+  ``GROUP_BY <TEST|SUITE>``
+
+    By default (``TEST``) a CTest test is created for each test case, running
+    the test executable once per test case.  With ``SUITE``, a single CTest test
+    named after the suite (``prefix<suite>suffix``) runs all the discovered test
+    cases of each suite in one process, saving the process start-up and test
+    registration costs of a large executable.
+
+  ``CACHE_DIR dir``
+
+    Passes ``--cutest_cache_dir=dir`` to each test, which then skips the test
+    cases that passed in a previous run of the same build of the executable.
+    When all of its test cases are cached, the test is reported as skipped
+    instead of running again; pass ``EXTRA_ARGS --cutest_no_cache`` to run
+    everything anyway.
+
+  ``BATCH_SIZE count``
+
+    Run the discovered test cases in batches of at most ``count`` test cases,
+    one CTest test per batch, selected with a ``--cutest_filter`` listing them.
+    Batches are named ``prefix<executable>.batch<N>suffix`` or, combined with
+    ``GROUP_BY SUITE``, ``prefix<suite>.batch<N>suffix`` and never span
+    suites.
+
+    The result of a batch is the result of all its test cases; the outcome of
+    each test case is printed in the output of the batch and, with
+    ``XML_OUTPUT_DIR``, written to a report named after the batch.
+
+.. command:: cutest_add_sharded_tests
+
+  Add one CTest test per shard of a CuTest executable:
+
+  .. code-block:: cmake
+
+    cutest_add_sharded_tests(target
+                             SHARDS count
+                             [EXTRA_ARGS args...]
+                             [WORKING_DIRECTORY dir]
+                             [TEST_PREFIX prefix]
+                             [PROPERTIES name1 value1...]
+    )
+
+  Each test runs the executable with ``CUTEST_TOTAL_SHARDS`` and
+  ``CUTEST_SHARD_INDEX`` set in its environment, so that it runs one
+  ``count``-th of the tests, and is named ``<prefix><target>.shard<index>``.
+  This lets :program:`ctest` spread a large executable over several processes
+  with ``--parallel`` without a test per test case.  The options have the same
+  meaning as for :command:`cutest_discover_tests`; pass
+  ``EXTRA_ARGS --cutest_shard_cost_file=file`` to balance the shards by the
+  test times recorded in a baseline file.
+
+.. command:: cutest_add_test_module
+
+  Build CuTest test sources as a test module for ``cutest_runner``:
+
+  .. code-block:: cmake
+
+    cutest_add_test_module(target sources...)
+
+  The module is a shared object that leaves the CuTest functions undefined and
+  resolves them in the runner that loads it, so it must not link ``cutest``
+  or ``cutest_main`` itself; link it with the code under test as usual.
+  ``cutest_runner`` loads the modules named on its command line into a single
+  registry and runs them with the usual options, saving a process per test
+  executable:
+
+  .. code-block:: cmake
+
+    add_test(NAME all_tests
+             COMMAND buracchi::cutest::cutest_runner
+                     $<TARGET_FILE:parser_tests> $<TARGET_FILE:queue_tests>
+                     --cutest_jobs=8)
+
 #]=======================================================================]
 
 function(cutest_discover_tests target)
@@ -173,6 +251,9 @@ function(cutest_discover_tests target)
         DISCOVERY_TIMEOUT
         XML_OUTPUT_DIR
         DISCOVERY_MODE
+        BATCH_SIZE
+        GROUP_BY
+        CACHE_DIR
     )
     set(multiValueArgs
         EXTRA_ARGS
@@ -193,6 +274,19 @@ function(cutest_discover_tests target)
     if(NOT arg_DISCOVERY_TIMEOUT)
         set(arg_DISCOVERY_TIMEOUT 5)
     endif()
+    if(arg_GROUP_BY AND NOT arg_GROUP_BY MATCHES "^(TEST|SUITE)$")
+        message(FATAL_ERROR "Unknown GROUP_BY: ${arg_GROUP_BY}")
+    endif()
+    if(arg_BATCH_SIZE AND NOT arg_BATCH_SIZE MATCHES "^[1-9][0-9]*$")
+        message(FATAL_ERROR "BATCH_SIZE must be a positive integer: ${arg_BATCH_SIZE}")
+    endif()
+    if(arg_XML_OUTPUT_DIR)
+        # The test executable writes its report but does not create directories.
+        file(MAKE_DIRECTORY "${arg_XML_OUTPUT_DIR}")
+    endif()
+    if(arg_CACHE_DIR)
+        list(APPEND arg_EXTRA_ARGS "--cutest_cache_dir=${arg_CACHE_DIR}")
+    endif()
     if(NOT arg_DISCOVERY_MODE)
         if(NOT CMAKE_CUTEST_DISCOVER_TESTS_DISCOVERY_MODE)
             set(CMAKE_CUTEST_DISCOVER_TESTS_DISCOVERY_MODE "POST_BUILD")
@@ -268,6 +362,8 @@ function(cutest_discover_tests target)
                 -D "TEST_DISCOVERY_TIMEOUT=${arg_DISCOVERY_TIMEOUT}"
                 -D "TEST_DISCOVERY_EXTRA_ARGS=${arg_DISCOVERY_EXTRA_ARGS}"
                 -D "TEST_XML_OUTPUT_DIR=${arg_XML_OUTPUT_DIR}"
+                -D "TEST_BATCH_SIZE=${arg_BATCH_SIZE}"
+                -D "TEST_GROUP_BY=${arg_GROUP_BY}"
                 -P "${_CUTEST_DISCOVER_TESTS_SCRIPT}"
                 VERBATIM
         )
@@ -311,6 +407,8 @@ function(cutest_discover_tests target)
                "      TEST_DISCOVERY_TIMEOUT" " [==[${arg_DISCOVERY_TIMEOUT}]==]"           "\n"
                "      TEST_DISCOVERY_EXTRA_ARGS [==[${arg_DISCOVERY_EXTRA_ARGS}]==]"        "\n"
                "      TEST_XML_OUTPUT_DIR"    " [==[${arg_XML_OUTPUT_DIR}]==]"              "\n"
+               "      TEST_BATCH_SIZE"        " [==[${arg_BATCH_SIZE}]==]"                  "\n"
+               "      TEST_GROUP_BY"          " [==[${arg_GROUP_BY}]==]"                    "\n"
                "    )"                                                                      "\n"
                "  endif()"                                                                  "\n"
                "  include(\"${ctest_tests_file}\")"                                         "\n"
@@ -351,6 +449,50 @@ function(cutest_discover_tests target)
 
 endfunction()
 
+function(cutest_add_sharded_tests target)
+    set(options "")
+    set(oneValueArgs
+        SHARDS
+        TEST_PREFIX
+        WORKING_DIRECTORY
+    )
+    set(multiValueArgs
+        EXTRA_ARGS
+        PROPERTIES
+    )
+    cmake_parse_arguments(PARSE_ARGV 1 arg
+                          "${options}" "${oneValueArgs}" "${multiValueArgs}"
+    )
+
+    if(NOT arg_SHARDS OR arg_SHARDS LESS 1)
+        message(FATAL_ERROR "cutest_add_sharded_tests requires a positive SHARDS count")
+    endif()
+    if(NOT arg_WORKING_DIRECTORY)
+        set(arg_WORKING_DIRECTORY "${CMAKE_CURRENT_BINARY_DIR}")
+    endif()
+
+    math(EXPR last_shard "${arg_SHARDS} - 1")
+    foreach(shard RANGE ${last_shard})
+        set(test_name "${arg_TEST_PREFIX}${target}.shard${shard}")
+        add_test(NAME "${test_name}"
+                 COMMAND ${target} ${arg_EXTRA_ARGS}
+                 WORKING_DIRECTORY "${arg_WORKING_DIRECTORY}"
+        )
+        set_tests_properties("${test_name}" PROPERTIES
+                             ENVIRONMENT "CUTEST_TOTAL_SHARDS=${arg_SHARDS};CUTEST_SHARD_INDEX=${shard}"
+                             ${arg_PROPERTIES}
+        )
+    endforeach()
+endfunction()
+
+function(cutest_add_test_module target)
+    add_library(${target} MODULE ${ARGN})
+    target_link_libraries(${target} PRIVATE "$<COMPILE_ONLY:buracchi::cutest::cutest>")
+    if(APPLE)
+        target_link_options(${target} PRIVATE "LINKER:-undefined,dynamic_lookup")
+    endif()
+endfunction()
+
 ###############################################################################
 
 set(_CUTEST_DISCOVER_TESTS_SCRIPT
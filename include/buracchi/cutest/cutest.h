@@ -2,15 +2,84 @@
 #define CUTEST_H
 
 #include <math.h>
+#include <stdatomic.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <strings.h>
 
+/*
+ * State of a benchmark run: the benchmark body repeats the measured code while
+ * cutest_benchmark_loop() returns true.
+ */
+struct cutest_benchmark_state {
+	size_t iterations;
+	size_t remaining;
+	bool running;
+	uint64_t start_time;
+	uint64_t elapsed_time;
+	size_t bytes_per_iteration;
+	size_t items_per_iteration;
+};
+
+/*
+ * Hooks of the tests defined with TEST_F(): set_up and tear_down run around
+ * every test on its own instance of the fixture, set_up_suite and
+ * tear_down_suite once around all the tests of the suite that run.
+ */
+struct cutest_fixture {
+	const char *name;
+	void (*set_up)(void *fixture);
+	void (*tear_down)(void *fixture);
+	void (*set_up_suite)();
+	void (*tear_down_suite)();
+};
+
+/*
+ * A global environment, set up before all the tests and torn down after them.
+ */
+struct cutest_environment {
+	void (*set_up)(void *context);
+	void (*tear_down)(void *context);
+	void *context;
+};
+
+/*
+ * Parameters of the tests of a suite defined with TEST_P(), registered by
+ * INSTANTIATE_TEST_SUITE_P() under the suite name "<prefix>/<suite>": size
+ * values stored in values or, when values is nullptr, computed on demand by
+ * generate into parameter.
+ */
+struct cutest_parameters {
+	const char *name;
+	const char *suite_name;
+	size_t size;
+	const void *values;
+	void (*generate)(size_t index, void *parameter);
+};
+
+/*
+ * A parameterized test is registered once per instantiation, with parameters
+ * set, and runs as one case per parameter: a copy of the test named
+ * "<name>/<index>" with parameter set to the index. cases is the number of
+ * cases that are selected, 1 for the other tests. The target of a fuzz test is
+ * fuzz, which its execute function runs on every input of the corpus
+ * directory.
+ */
 struct cutest_test {
 	const char *name;
 	void (*execute)();
-	bool result;
+	void (*benchmark)(struct cutest_benchmark_state state[static 1]);
+	void (*fuzz)(const uint8_t *data, size_t size);
+	const char *corpus;
+	const char *file;
+	int line;
+	const struct cutest_fixture *fixture;
+	const struct cutest_parameters *parameters;
+	size_t parameter;
+	size_t cases;
+	atomic_bool result;
 	bool enabled;
 };
 
@@ -21,6 +90,7 @@ struct cutest_test_suite {
 	struct cutest_test *test;
 	bool enabled;
 	size_t enabled_tests;
+	bool static_storage;
 };
 
 extern struct cutest {
@@ -31,8 +101,111 @@ extern struct cutest {
 	struct cutest_test_suite *suite;
 	size_t enabled_suites;
 	size_t enabled_tests;
+	struct cutest_test_block *test_blocks;
 } *cutest_;
 
+/*
+ * Compile-time description of a test emitted by TEST().
+ */
+struct cutest_test_descriptor {
+	const char *suite_name;
+	const char *name;
+	void (*execute)();
+	void (*benchmark)(struct cutest_benchmark_state state[static 1]);
+	void (*fuzz)(const uint8_t *data, size_t size);
+	const char *corpus;
+	const char *file;
+	int line;
+	const struct cutest_fixture *fixture;
+	const struct cutest_parameters *parameters;
+};
+
+/*
+ * Outcome of a test, of a test suite or of the whole run, with times in
+ * milliseconds. Cached tests passed in a previous run and were not run again.
+ */
+struct cutest_result {
+	size_t tests;
+	size_t failed_tests;
+	double wall_time;
+	double cpu_time;
+	size_t cached_tests;
+};
+
+/*
+ * Callbacks invoked along the run of the tests, each of which can be nullptr.
+ * The test and assertion callbacks run in the thread, and with isolation or the
+ * processes backend of --cutest_jobs in the process, that executes the test, so
+ * they must be thread-safe when tests run in parallel. In parallel runs the
+ * suite callbacks are invoked once all the tests completed. A test whose
+ * isolated process dies gets no on_test_end, but counts as failed in the
+ * results of its suite and of the run.
+ */
+struct cutest_listener {
+	void (*on_program_start)(void *context, const struct cutest cutest[static 1]);
+	void (*on_suite_start)(void *context, const struct cutest_test_suite suite[static 1]);
+	void (*on_test_start)(void *context,
+	                      const struct cutest_test_suite suite[static 1],
+	                      const struct cutest_test test[static 1]);
+	void (*on_assertion_failure)(void *context,
+	                             const struct cutest_test test[static 1],
+	                             const char file[static 1],
+	                             int line,
+	                             const char message[static 1]);
+	void (*on_test_end)(void *context,
+	                    const struct cutest_test_suite suite[static 1],
+	                    const struct cutest_test test[static 1],
+	                    const struct cutest_result result[static 1]);
+	void (*on_suite_end)(void *context,
+	                     const struct cutest_test_suite suite[static 1],
+	                     const struct cutest_result result[static 1]);
+	void (*on_program_end)(void *context, const struct cutest cutest[static 1], const struct cutest_result result[static 1]);
+	void *context;
+};
+
+/*
+ * The console printers: the default one prints every test as Google Test does,
+ * the brief one only the failures and the summary.
+ */
+extern const struct cutest_listener cutest_console_listener;
+extern const struct cutest_listener cutest_brief_console_listener;
+
+/*
+ * Register a listener after the ones already registered, cutest_console_listener
+ * being the first by default. The listener is referenced, not copied, and must
+ * stay valid while registered. Listeners are meant to be registered before the
+ * tests start, e.g. from a constructor function.
+ */
+extern bool cutest_listener_add(const struct cutest_listener listener[static 1]);
+extern bool cutest_listener_remove(const struct cutest_listener listener[static 1]);
+
+/*
+ * Register a global environment, referenced and not copied like a listener.
+ * Environments are set up in registration order and torn down in reverse. When
+ * a set-up fails, every test fails without running.
+ */
+extern bool cutest_environment_add(const struct cutest_environment environment[static 1]);
+
+/*
+ * What the assertions of a thread are attributed to: the test it runs, and
+ * where the failures and the output of the test are collected.
+ */
+struct cutest_thread_context {
+	struct cutest_test *test;
+	struct cutest_failures *failures;
+	struct cutest_buffer *output;
+};
+
+/*
+ * Attribute the assertions of the calling thread to the test of context, as
+ * returned by cutest_thread_context() in the thread running the test; a zeroed
+ * context detaches the thread. The assertions of threads that are not attached
+ * go to the running test when cutest_main runs one at a time, which is the
+ * default. Either way the threads must end before the test does.
+ */
+extern struct cutest_thread_context cutest_thread_context();
+extern void cutest_thread_attach(struct cutest_thread_context context);
+
 extern struct cutest *cutest_init(size_t initial_suite_capacity, size_t initial_test_capacity);
 [[gnu::nonnull(1)]]
 extern void cutest_destroy(struct cutest *cutest);
@@ -46,23 +219,473 @@ extern struct cutest_test *cutest_test_add(struct cutest cutest[static 1],
 
 [[gnu::nonnull(3)]]
 extern void cutest_test_add_(const char suite_name[static 1], const char test_name[static 1], void test());
+extern void cutest_test_register_(const struct cutest_test_descriptor descriptor[static 1]);
+extern void cutest_test_section_register_(const struct cutest_test_descriptor *const *begin,
+                                          const struct cutest_test_descriptor *const *end);
 [[gnu::format(printf, 4, 5)]]
 extern void cutest_test_fail_(const char test_function_name[static 8],
                               const char file[static 1],
                               int line,
                               const char *fmessage,
                               ...);
+[[gnu::format(printf, 1, 2)]]
+extern void cutest_test_note_(const char *fmessage, ...);
+extern void cutest_test_fail_end_();
+extern void cutest_fixture_test_run_(const struct cutest_fixture fixture[static 1], void *data, void body(void *data));
+extern void cutest_test_p_register_(const struct cutest_test_descriptor descriptor[static 1]);
+extern void cutest_parameters_register_(const struct cutest_parameters parameters[static 1]);
+extern const void *cutest_parameter_get_(void *storage, size_t size);
+extern void cutest_fuzz_replay_();
+extern bool cutest_benchmark_next_(struct cutest_benchmark_state state[static 1]);
+extern void cutest_do_not_optimize_(const volatile void *value);
+
+/*
+ * Instruction counter of a block checked by EXPECT_INSTRUCTIONS_LE().
+ */
+struct cutest_perf_scope_ {
+	int fd;
+	bool available;
+	bool running;
+};
+
+extern struct cutest_perf_scope_ cutest_perf_scope_begin_();
+extern bool cutest_perf_scope_end_(struct cutest_perf_scope_ scope[static 1],
+                                   uint64_t budget,
+                                   const char budget_expression[static 1],
+                                   const char test_function_name[static 8],
+                                   const char file[static 1],
+                                   int line);
+
+/*
+ * Span of the trace timed by CUTEST_TRACE_SCOPE().
+ */
+struct cutest_trace_scope_ {
+	const char *name;
+	uint64_t start_time;
+	bool running;
+};
+
+extern struct cutest_trace_scope_ cutest_trace_scope_begin_(const char name[static 1]);
+extern void cutest_trace_scope_end_(struct cutest_trace_scope_ scope[static 1]);
+
+/*
+ * Allocations of the calling thread before a block checked by
+ * EXPECT_ALLOCS_LE() or EXPECT_NO_ALLOC().
+ */
+struct cutest_alloc_scope_ {
+	size_t allocations;
+	size_t bytes;
+	bool available;
+	bool running;
+};
+
+extern struct cutest_alloc_scope_ cutest_alloc_scope_begin_();
+extern bool cutest_alloc_scope_end_(struct cutest_alloc_scope_ scope[static 1],
+                                    size_t max_allocations,
+                                    const char max_expression[static 1],
+                                    const char test_function_name[static 8],
+                                    const char file[static 1],
+                                    int line);
+
+/*
+ * Outcome of a CUTEST_STRESS() run: the iterations of all the threads per
+ * second, and the percentiles of the latency of an iteration, in nanoseconds,
+ * of the slowest thread.
+ */
+struct cutest_stress_result {
+	double seconds;
+	double throughput;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+	uint64_t max;
+};
+
+extern struct cutest_stress_result cutest_stress_(size_t threads,
+                                                  size_t iterations,
+                                                  void body(void *context, size_t thread, size_t iteration),
+                                                  void *context,
+                                                  const char test_function_name[static 8],
+                                                  const char file[static 1],
+                                                  int line);
+
+/*
+ * Source of a comparison of two memory blocks or arrays, reported on failure.
+ */
+struct cutest_comparison_ {
+	const char *lhs;
+	const char *rhs;
+	const char *size;
+	const char *max_ulps;
+	const char *test_function_name;
+	const char *file;
+	int line;
+};
+
+/*
+ * Return false after failing the test, leaving the failure open for
+ * cutest_test_note_() and cutest_test_fail_end_(), if the arrays differ.
+ */
+extern bool cutest_memory_eq_(const void *lhs,
+                              const void *rhs,
+                              size_t size,
+                              const struct cutest_comparison_ comparison[static 1]);
+extern bool cutest_array_eq_(const void *lhs,
+                             const void *rhs,
+                             size_t size,
+                             size_t element_size,
+                             const struct cutest_comparison_ comparison[static 1]);
+extern bool cutest_array_ulp_near_f_(const float lhs[],
+                                     const float rhs[],
+                                     size_t size,
+                                     int max_ulps,
+                                     const struct cutest_comparison_ comparison[static 1]);
+extern bool cutest_array_ulp_near_d_(const double lhs[],
+                                     const double rhs[],
+                                     size_t size,
+                                     int max_ulps,
+                                     const struct cutest_comparison_ comparison[static 1]);
+extern bool cutest_array_ulp_near_ld_(const long double lhs[],
+                                      const long double rhs[],
+                                      size_t size,
+                                      int max_ulps,
+                                      const struct cutest_comparison_ comparison[static 1]);
+extern bool cutest_golden_match_(const void *data,
+                                 size_t size,
+                                 const char path[static 1],
+                                 const struct cutest_comparison_ comparison[static 1]);
+
+/*
+ * By default every test registers itself from a constructor. When
+ * CUTEST_SECTION_REGISTRATION is defined on an ELF target, tests instead place
+ * a pointer to their descriptor in the cutest_test linker section and each
+ * image registers its whole section at once, building the registry with a
+ * handful of allocations instead of a few per test. In that mode suites are
+ * sorted by name and the tests of a suite by their source location.
+ */
+#if defined(CUTEST_SECTION_REGISTRATION) && defined(__ELF__)
+[[gnu::weak]] [[gnu::visibility("hidden")]]
+extern const struct cutest_test_descriptor *const __start_cutest_test[];
+[[gnu::weak]] [[gnu::visibility("hidden")]]
+extern const struct cutest_test_descriptor *const __stop_cutest_test[];
+
+[[maybe_unused]]
+[[gnu::constructor(120)]]
+static void cutest_test_section_register() {
+	cutest_test_section_register_(__start_cutest_test, __stop_cutest_test);
+}
 
-#define TEST(test_suite_name, test_name) void test_##test_suite_name##test_name();         \
-    [[maybe_unused]]                                                                       \
-    [[gnu::constructor(120)]]                                                              \
-    static void test_add_##test_suite_name##test_name() {                                  \
-        static_assert(sizeof(#test_suite_name) > 1, "test_suite_name must not be empty");  \
-        static_assert(sizeof(#test_name) > 1, "test_name must not be empty");              \
-        cutest_test_add_(#test_suite_name, #test_name, test_##test_suite_name##test_name); \
-    }                                                                                      \
+#define CUTEST_TEST_REGISTER_(descriptor) \
+    [[gnu::used]]                         \
+    [[gnu::section("cutest_test")]]       \
+    static const struct cutest_test_descriptor *const descriptor##_entry = &descriptor;
+#else
+#define CUTEST_TEST_REGISTER_(descriptor)   \
+    [[maybe_unused]]                        \
+    [[gnu::constructor(120)]]               \
+    static void descriptor##_register() {   \
+        cutest_test_register_(&descriptor); \
+    }
+#endif
+
+#define TEST(test_suite_name, test_name) void test_##test_suite_name##test_name();              \
+    static_assert(sizeof(#test_suite_name) > 1, "test_suite_name must not be empty");           \
+    static_assert(sizeof(#test_name) > 1, "test_name must not be empty");                       \
+    static const struct cutest_test_descriptor test_descriptor_##test_suite_name##test_name = { \
+        .suite_name = #test_suite_name,                                                         \
+        .name = #test_name,                                                                     \
+        .execute = test_##test_suite_name##test_name,                                           \
+        .file = __FILE__,                                                                       \
+        .line = __LINE__,                                                                       \
+    };                                                                                          \
+    CUTEST_TEST_REGISTER_(test_descriptor_##test_suite_name##test_name)                         \
     void test_##test_suite_name##test_name()
 
+/*
+ * Define the fixture fixture_name, followed by the members of its structure,
+ * which must not be empty. Every test defined with TEST_F() runs on a zeroed
+ * instance of the structure, passed to it and to the per-test hooks as
+ * fixture. The suite hooks share state with the tests through variables with
+ * static storage; they run once, before any test of the suite starts and after
+ * all of them completed, and not at all when no test of the suite is selected.
+ * When the suite set-up fails an assertion the tests of the suite fail without
+ * running, and when the set-up of a test does, its body is skipped.
+ *
+ *   FIXTURE(parser) {
+ *       struct parser *parser;
+ *   };
+ *
+ *   FIXTURE_SET_UP(parser) {
+ *       fixture->parser = parser_create(grammar);
+ *   }
+ *
+ *   FIXTURE_SET_UP_SUITE(parser) {
+ *       grammar = grammar_load("c23.ebnf");
+ *   }
+ *
+ *   TEST_F(parser, empty_input) {
+ *       EXPECT_EQ(parse(fixture->parser, ""), nullptr);
+ *   }
+ */
+#define FIXTURE(fixture_name)                                         \
+    static struct cutest_fixture cutest_fixture_##fixture_name##_ = { \
+        .name = #fixture_name,                                        \
+    };                                                                \
+    struct cutest_fixture_##fixture_name
+
+#define FIXTURE_SET_UP(fixture_name)                                                                          \
+    static void cutest_fixture_set_up_##fixture_name(struct cutest_fixture_##fixture_name fixture[static 1]); \
+    static void cutest_fixture_set_up_##fixture_name##_(void *fixture) {                                      \
+        cutest_fixture_set_up_##fixture_name(fixture);                                                        \
+    }                                                                                                         \
+    [[maybe_unused]]                                                                                          \
+    [[gnu::constructor(115)]]                                                                                 \
+    static void cutest_fixture_set_up_##fixture_name##_register() {                                           \
+        cutest_fixture_##fixture_name##_.set_up = cutest_fixture_set_up_##fixture_name##_;                    \
+    }                                                                                                         \
+    static void cutest_fixture_set_up_##fixture_name([[maybe_unused]] struct cutest_fixture_##fixture_name fixture[static 1])
+
+#define FIXTURE_TEAR_DOWN(fixture_name)                                                                          \
+    static void cutest_fixture_tear_down_##fixture_name(struct cutest_fixture_##fixture_name fixture[static 1]); \
+    static void cutest_fixture_tear_down_##fixture_name##_(void *fixture) {                                      \
+        cutest_fixture_tear_down_##fixture_name(fixture);                                                        \
+    }                                                                                                            \
+    [[maybe_unused]]                                                                                             \
+    [[gnu::constructor(115)]]                                                                                    \
+    static void cutest_fixture_tear_down_##fixture_name##_register() {                                           \
+        cutest_fixture_##fixture_name##_.tear_down = cutest_fixture_tear_down_##fixture_name##_;                 \
+    }                                                                                                            \
+    static void cutest_fixture_tear_down_##fixture_name([[maybe_unused]] struct cutest_fixture_##fixture_name fixture[static 1])
+
+#define FIXTURE_SET_UP_SUITE(fixture_name)                                                          \
+    static void cutest_fixture_set_up_suite_##fixture_name();                                       \
+    [[maybe_unused]]                                                                                \
+    [[gnu::constructor(115)]]                                                                       \
+    static void cutest_fixture_set_up_suite_##fixture_name##_register() {                           \
+        cutest_fixture_##fixture_name##_.set_up_suite = cutest_fixture_set_up_suite_##fixture_name; \
+    }                                                                                               \
+    static void cutest_fixture_set_up_suite_##fixture_name()
+
+#define FIXTURE_TEAR_DOWN_SUITE(fixture_name)                                                             \
+    static void cutest_fixture_tear_down_suite_##fixture_name();                                          \
+    [[maybe_unused]]                                                                                      \
+    [[gnu::constructor(115)]]                                                                             \
+    static void cutest_fixture_tear_down_suite_##fixture_name##_register() {                              \
+        cutest_fixture_##fixture_name##_.tear_down_suite = cutest_fixture_tear_down_suite_##fixture_name; \
+    }                                                                                                     \
+    static void cutest_fixture_tear_down_suite_##fixture_name()
+
+/*
+ * Define a test of the suite fixture_name running on the fixture of the same
+ * name, available in the body as fixture.
+ */
+#define TEST_F(fixture_name, test_name)                                                                             \
+    static void test_##fixture_name##test_name(struct cutest_fixture_##fixture_name fixture[static 1]);             \
+    static void test_f_##fixture_name##test_name##_(void *fixture) {                                                \
+        test_##fixture_name##test_name(fixture);                                                                    \
+    }                                                                                                               \
+    void test_f_##fixture_name##test_name();                                                                        \
+    static_assert(sizeof(#fixture_name) > 1, "fixture_name must not be empty");                                     \
+    static_assert(sizeof(#test_name) > 1, "test_name must not be empty");                                           \
+    static const struct cutest_test_descriptor test_descriptor_##fixture_name##test_name = {                        \
+        .suite_name = #fixture_name,                                                                                \
+        .name = #test_name,                                                                                         \
+        .execute = test_f_##fixture_name##test_name,                                                                \
+        .file = __FILE__,                                                                                           \
+        .line = __LINE__,                                                                                           \
+        .fixture = &cutest_fixture_##fixture_name##_,                                                               \
+    };                                                                                                              \
+    CUTEST_TEST_REGISTER_(test_descriptor_##fixture_name##test_name)                                                \
+    void test_f_##fixture_name##test_name() {                                                                       \
+        struct cutest_fixture_##fixture_name fixture = {};                                                          \
+        cutest_fixture_test_run_(&cutest_fixture_##fixture_name##_, &fixture, test_f_##fixture_name##test_name##_); \
+    }                                                                                                               \
+    static void test_##fixture_name##test_name([[maybe_unused]] struct cutest_fixture_##fixture_name fixture[static 1])
+
+/*
+ * Define a test of the suite test_suite_name run once for every parameter of
+ * the instantiations of the suite, which get the parameter as param, a pointer
+ * to a const parameter_type. The tests of a suite share their parameter type,
+ * and its instantiations must follow them in the same translation unit.
+ *
+ * The cases are not registered: each TEST_P() is registered once per
+ * instantiation and its cases, named "<prefix>/<suite>.<test>/<index>", are
+ * enumerated while listing, filtering and running the tests.
+ *
+ *   static const struct vector vectors[] = {{"f", "Zg=="}, {"fo", "Zm8="}};
+ *
+ *   TEST_P(base64, encode, struct vector) {
+ *       EXPECT_STREQ(encode(param->plain), param->encoded);
+ *   }
+ *
+ *   INSTANTIATE_TEST_SUITE_P(rfc4648, base64, vectors);
+ */
+#define TEST_P(test_suite_name, test_name, parameter_type)                                                      \
+    typedef typeof(parameter_type) cutest_parameter_##test_suite_name##_;                                       \
+    static void test_##test_suite_name##test_name(const cutest_parameter_##test_suite_name##_ param[static 1]); \
+    void test_p_##test_suite_name##test_name();                                                                 \
+    static_assert(sizeof(#test_suite_name) > 1, "test_suite_name must not be empty");                           \
+    static_assert(sizeof(#test_name) > 1, "test_name must not be empty");                                       \
+    static const struct cutest_test_descriptor test_descriptor_##test_suite_name##test_name = {                 \
+        .suite_name = #test_suite_name,                                                                         \
+        .name = #test_name,                                                                                     \
+        .execute = test_p_##test_suite_name##test_name,                                                         \
+        .file = __FILE__,                                                                                       \
+        .line = __LINE__,                                                                                       \
+    };                                                                                                          \
+    [[maybe_unused]]                                                                                            \
+    [[gnu::constructor(120)]]                                                                                   \
+    static void test_descriptor_##test_suite_name##test_name##_register() {                                     \
+        cutest_test_p_register_(&test_descriptor_##test_suite_name##test_name);                                 \
+    }                                                                                                           \
+    void test_p_##test_suite_name##test_name() {                                                                \
+        cutest_parameter_##test_suite_name##_ parameter;                                                        \
+        test_##test_suite_name##test_name(cutest_parameter_get_(&parameter, sizeof parameter));                 \
+    }                                                                                                           \
+    static void test_##test_suite_name##test_name([[maybe_unused]] const cutest_parameter_##test_suite_name##_ param[static 1])
+
+/*
+ * Instantiate the parameterized tests of test_suite_name over the elements of
+ * array, an array of their parameter type.
+ */
+#define INSTANTIATE_TEST_SUITE_P(prefix, test_suite_name, array)                          \
+    static_assert(_Generic(&(array)[0],                                                   \
+                      cutest_parameter_##test_suite_name##_ *: true,                      \
+                      const cutest_parameter_##test_suite_name##_ *: true,                \
+                      default: false),                                                    \
+                  "array must be an array of the parameter type of the suite");           \
+    static const struct cutest_parameters cutest_parameters_##prefix##test_suite_name = { \
+        .name = #prefix "/" #test_suite_name,                                             \
+        .suite_name = #test_suite_name,                                                   \
+        .size = sizeof(array) / sizeof *(array),                                          \
+        .values = (array),                                                                \
+    };                                                                                    \
+    [[maybe_unused]]                                                                      \
+    [[gnu::constructor(120)]]                                                             \
+    static void cutest_parameters_##prefix##test_suite_name##_register() {                \
+        cutest_parameters_register_(&cutest_parameters_##prefix##test_suite_name);        \
+    }                                                                                     \
+    static_assert(sizeof(#prefix) > 1, "prefix must not be empty")
+
+/*
+ * Instantiate the parameterized tests of test_suite_name over count parameters
+ * computed when a case runs by generator, a function taking the index of the
+ * case and a pointer to the parameter to fill.
+ */
+#define INSTANTIATE_TEST_SUITE_P_GENERATOR(prefix, test_suite_name, count, generator)                   \
+    static void cutest_parameters_##prefix##test_suite_name##_generate(size_t index, void *parameter) { \
+        generator(index, (cutest_parameter_##test_suite_name##_ *) parameter);                          \
+    }                                                                                                   \
+    static struct cutest_parameters cutest_parameters_##prefix##test_suite_name = {                     \
+        .name = #prefix "/" #test_suite_name,                                                           \
+        .suite_name = #test_suite_name,                                                                 \
+        .generate = cutest_parameters_##prefix##test_suite_name##_generate,                             \
+    };                                                                                                  \
+    [[maybe_unused]]                                                                                    \
+    [[gnu::constructor(120)]]                                                                           \
+    static void cutest_parameters_##prefix##test_suite_name##_register() {                              \
+        cutest_parameters_##prefix##test_suite_name.size = (count);                                     \
+        cutest_parameters_register_(&cutest_parameters_##prefix##test_suite_name);                      \
+    }                                                                                                   \
+    static_assert(sizeof(#prefix) > 1, "prefix must not be empty")
+
+/*
+ * Instantiate the parameterized tests of test_suite_name, whose parameter type
+ * must be an integer type, over the range [begin, end) with a positive step.
+ */
+#define INSTANTIATE_TEST_SUITE_P_RANGE(prefix, test_suite_name, begin, end, step)                                  \
+    static void cutest_parameters_##prefix##test_suite_name##_range(                                               \
+        size_t index,                                                                                              \
+        cutest_parameter_##test_suite_name##_ parameter[static 1]) {                                               \
+        *parameter = (begin) + (cutest_parameter_##test_suite_name##_) index * (step);                             \
+    }                                                                                                              \
+    INSTANTIATE_TEST_SUITE_P_GENERATOR(prefix,                                                                     \
+                                       test_suite_name,                                                            \
+                                       ((end) > (begin)) ? ((size_t) ((end) - (begin)) + (step) - 1) / (step) : 0, \
+                                       cutest_parameters_##prefix##test_suite_name##_range)
+
+/*
+ * Define a fuzz test, whose body takes an input as the parameters given after
+ * the test name, a pointer to its bytes and its size, and checks it with the
+ * assertions. The test runs on the empty input and on every file of the
+ * corpus directory corpus/<suite>.<name>, next to the source file of the test
+ * or in the directory given with --cutest_corpus_dir. --cutest_fuzz=<suite>.<name>
+ * runs it instead on inputs mutated from the corpus, guided by the edge coverage
+ * of the code compiled with -fsanitize-coverage=trace-pc-guard, adding the
+ * inputs that reach new edges to the corpus and saving the input of a failure.
+ *
+ *   FUZZ_TEST(json, parse, const uint8_t *data, size_t size) {
+ *       struct json *json = json_parse(data, size);
+ *       if (json != nullptr) {
+ *           EXPECT_TRUE(json_valid(json));
+ *       }
+ *       json_free(json);
+ *   }
+ */
+#define FUZZ_TEST(test_suite_name, test_name, ...)                                              \
+    static void fuzz_##test_suite_name##test_name(__VA_ARGS__);                                 \
+    static_assert(sizeof(#test_suite_name) > 1, "test_suite_name must not be empty");           \
+    static_assert(sizeof(#test_name) > 1, "test_name must not be empty");                       \
+    static const struct cutest_test_descriptor fuzz_descriptor_##test_suite_name##test_name = { \
+        .suite_name = #test_suite_name,                                                         \
+        .name = #test_name,                                                                     \
+        .execute = cutest_fuzz_replay_,                                                         \
+        .fuzz = fuzz_##test_suite_name##test_name,                                              \
+        .corpus = "corpus/" #test_suite_name "." #test_name,                                    \
+        .file = __FILE__,                                                                       \
+        .line = __LINE__,                                                                       \
+    };                                                                                          \
+    CUTEST_TEST_REGISTER_(fuzz_descriptor_##test_suite_name##test_name)                         \
+    static void fuzz_##test_suite_name##test_name(__VA_ARGS__)
+
+/*
+ * Define a benchmark, selected with --cutest_benchmark instead of running with
+ * the tests. The body gets a state parameter and must repeat the code to
+ * measure inside a loop driven by cutest_benchmark_loop(state); cutest_main
+ * calibrates the number of iterations.
+ */
+#define BENCHMARK(test_suite_name, benchmark_name)                                                        \
+    void benchmark_##test_suite_name##benchmark_name(struct cutest_benchmark_state state[static 1]);      \
+    static_assert(sizeof(#test_suite_name) > 1, "test_suite_name must not be empty");                     \
+    static_assert(sizeof(#benchmark_name) > 1, "benchmark_name must not be empty");                       \
+    static const struct cutest_test_descriptor benchmark_descriptor_##test_suite_name##benchmark_name = { \
+        .suite_name = #test_suite_name,                                                                   \
+        .name = #benchmark_name,                                                                          \
+        .benchmark = benchmark_##test_suite_name##benchmark_name,                                         \
+        .file = __FILE__,                                                                                 \
+        .line = __LINE__,                                                                                 \
+    };                                                                                                    \
+    CUTEST_TEST_REGISTER_(benchmark_descriptor_##test_suite_name##benchmark_name)                         \
+    void benchmark_##test_suite_name##benchmark_name(struct cutest_benchmark_state state[static 1])
+
+static inline bool cutest_benchmark_loop(struct cutest_benchmark_state state[static 1]) {
+	if (state->remaining != 0) {
+		state->remaining--;
+		return true;
+	}
+	return cutest_benchmark_next_(state);
+}
+
+static inline void cutest_benchmark_set_bytes_per_iteration(struct cutest_benchmark_state state[static 1], size_t bytes) {
+	state->bytes_per_iteration = bytes;
+}
+
+static inline void cutest_benchmark_set_items_per_iteration(struct cutest_benchmark_state state[static 1], size_t items) {
+	state->items_per_iteration = items;
+}
+
+/*
+ * Prevent the compiler from optimizing away the computation of value, or from
+ * assuming anything about the contents of memory across the barrier.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define cutest_do_not_optimize(value) __asm__ volatile("" : : "r,m"(value) : "memory")
+#define cutest_clobber_memory() __asm__ volatile("" : : : "memory")
+#else
+#define cutest_do_not_optimize(value) cutest_do_not_optimize_(&(value))
+#define cutest_clobber_memory() atomic_signal_fence(memory_order_seq_cst)
+#endif
+
 #define CUTEST_PREDICATE(is_fatal, predicate, REPORT_FAILURE) \
     do {                                                      \
         if (!(predicate)) {                                   \
@@ -77,8 +700,8 @@ extern void cutest_test_fail_(const char test_function_name[static 8],
     CUTEST_PREDICATE(is_fatal, condition,                               \
         do {                                                            \
             cutest_test_fail_(__func__, __FILE__, __LINE__, fmt, expr); \
-            __VA_OPT__(fprintf(stderr, __VA_ARGS__);)                   \
-            __VA_OPT__(fprintf(stderr, "\n");)                          \
+            __VA_OPT__(cutest_test_note_(__VA_ARGS__);)                 \
+            cutest_test_fail_end_();                                    \
         } while(0)                                                      \
     )
 
@@ -86,8 +709,8 @@ extern void cutest_test_fail_(const char test_function_name[static 8],
     CUTEST_PREDICATE(is_fatal, comparison,                                      \
         do {                                                                    \
             cutest_test_fail_(__func__, __FILE__, __LINE__, fmt, expr1, expr2); \
-            __VA_OPT__(fprintf(stderr, __VA_ARGS__);)                           \
-            __VA_OPT__(fprintf(stderr, "\n");)                                  \
+            __VA_OPT__(cutest_test_note_(__VA_ARGS__);)                         \
+            cutest_test_fail_end_();                                            \
         } while(0)                                                              \
     )
 
@@ -95,8 +718,8 @@ extern void cutest_test_fail_(const char test_function_name[static 8],
     CUTEST_PREDICATE(is_fatal, predicate,                                                                  \
         do {                                                                                               \
             cutest_test_fail_(__func__, __FILE__, __LINE__, fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10); \
-            __VA_OPT__(fprintf(stderr, __VA_ARGS__);)                                                      \
-            __VA_OPT__(fprintf(stderr, "\n");)                                                             \
+            __VA_OPT__(cutest_test_note_(__VA_ARGS__);)                                                    \
+            cutest_test_fail_end_();                                                                       \
         } while(0)                                                                                         \
     )
 
@@ -157,6 +780,44 @@ extern bool cutest_fpa_almost_equals_ld(long double lhs, long double rhs, int ma
         #abs_error, (long double)(abs_error),                                 \
         __VA_ARGS__)
 
+#define CUTEST_COMPARISON(lhs, rhs, size, max_ulps) \
+    (&(const struct cutest_comparison_) {#lhs, #rhs, #size, max_ulps, __func__, __FILE__, __LINE__})
+
+#define CUTEST_ARRAY(is_fatal, comparison, ...)         \
+    CUTEST_PREDICATE(is_fatal, comparison,              \
+        do {                                            \
+            __VA_OPT__(cutest_test_note_(__VA_ARGS__);) \
+            cutest_test_fail_end_();                    \
+        } while(0)                                      \
+    )
+
+#define CUTEST_ARRAY_MEMEQ(is_fatal, lhs, rhs, size, ...)                                    \
+    CUTEST_ARRAY(is_fatal,                                                                   \
+        cutest_memory_eq_((lhs), (rhs), (size), CUTEST_COMPARISON(lhs, rhs, size, nullptr)), \
+        __VA_ARGS__)
+
+#define CUTEST_ARRAY_EQ(is_fatal, lhs, rhs, size, ...)                                                         \
+    do {                                                                                                       \
+        static_assert(sizeof *(lhs) == sizeof *(rhs), "The elements of the arrays must have the same size");   \
+        CUTEST_ARRAY(is_fatal,                                                                                 \
+            cutest_array_eq_((lhs), (rhs), (size), sizeof *(lhs), CUTEST_COMPARISON(lhs, rhs, size, nullptr)), \
+            __VA_ARGS__);                                                                                      \
+    } while (0)
+
+#define CUTEST_ARRAY_FLOAT_ULP_NEAR(is_fatal, lhs, rhs, size, max_ulps, ...)                 \
+    CUTEST_ARRAY(is_fatal,                                                                   \
+        _Generic(*(lhs),                                                                     \
+            float: cutest_array_ulp_near_f_,                                                 \
+            double: cutest_array_ulp_near_d_,                                                \
+            long double: cutest_array_ulp_near_ld_)(                                         \
+            (lhs), (rhs), (size), (max_ulps), CUTEST_COMPARISON(lhs, rhs, size, #max_ulps)), \
+        __VA_ARGS__)
+
+#define CUTEST_MATCHES_GOLDEN(is_fatal, data, size, path, ...)                                      \
+    CUTEST_ARRAY(is_fatal,                                                                          \
+        cutest_golden_match_((data), (size), (path), CUTEST_COMPARISON(data, path, size, nullptr)), \
+        __VA_ARGS__)
+
 #define EXPECT_TRUE(condition, ...) CUTEST_COND_TRUE(false, condition, __VA_ARGS__)
 #define EXPECT_FALSE(condition, ...) CUTEST_COND_FALSE(false, condition, __VA_ARGS__)
 #define EXPECT_EQ(val1, val2, ...) CUTEST_COMP_EQ(false, val1, val2, __VA_ARGS__)
@@ -175,6 +836,90 @@ extern bool cutest_fpa_almost_equals_ld(long double lhs, long double rhs, int ma
 #define EXPECT_LONG_DOUBLE_EQ(val1, val2, ...) CUTEST_COMP_FPA_EQ(false, (long double)val1, val2, __VA_ARGS__)
 #define EXPECT_NEAR(val1, val2, abs_error, ...) CUTEST_COMP_NEAR(false, val1, val2, abs_error, __VA_ARGS__)
 
+/*
+ * Compare the size bytes at lhs and rhs, showing the rows around the first
+ * mismatch on failure. ARRAY_EQ compares size elements of two arrays by their
+ * object representation, which suits integers, pointers and structures without
+ * padding, and ARRAY_FLOAT_ULP_NEAR two arrays of float, double or long double
+ * as EXPECT_FLOAT_EQ() does with max_ulps ULPs. Failures report how many
+ * elements differ and list the first ones.
+ */
+#define EXPECT_MEMEQ(lhs, rhs, size, ...) CUTEST_ARRAY_MEMEQ(false, lhs, rhs, size, __VA_ARGS__)
+#define EXPECT_ARRAY_EQ(lhs, rhs, size, ...) CUTEST_ARRAY_EQ(false, lhs, rhs, size, __VA_ARGS__)
+#define EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs, rhs, size, max_ulps, ...) CUTEST_ARRAY_FLOAT_ULP_NEAR(false, lhs, rhs, size, max_ulps, __VA_ARGS__)
+
+/*
+ * Compare the size bytes at data with the contents of the golden file at path,
+ * relative to the directory of the calling source file, which is memory-mapped
+ * rather than read. Run with --cutest_update_golden to rewrite the golden files
+ * that do not match instead of failing.
+ */
+#define EXPECT_MATCHES_GOLDEN(data, size, path, ...) CUTEST_MATCHES_GOLDEN(false, data, size, path, __VA_ARGS__)
+
+/*
+ * Fail the test if the block following the macro retires more than budget
+ * user-space instructions, counted with perf_event_open(). Where the counter is
+ * not available the check is skipped with a note. The block must not be left
+ * with break, goto or return.
+ *
+ *   EXPECT_INSTRUCTIONS_LE(2000) {
+ *       parse(input);
+ *   }
+ */
+#define EXPECT_INSTRUCTIONS_LE(budget, ...)                                                                  \
+    for (struct cutest_perf_scope_ cutest_perf_scope = cutest_perf_scope_begin_();                           \
+         cutest_perf_scope.running;                                                                          \
+         (void) (cutest_perf_scope_end_(&cutest_perf_scope, (budget), #budget, __func__, __FILE__, __LINE__) \
+                 || (__VA_OPT__(cutest_test_note_(__VA_ARGS__), ) cutest_test_fail_end_(), true)))
+
+/*
+ * Fail the test if the block following the macro makes more than
+ * max_allocations calls to malloc(), calloc(), realloc(), aligned_alloc() or
+ * posix_memalign() on the calling thread. The functions are counted in test
+ * programs linking the cutest_alloc library, where the C library allows their
+ * replacement (glibc, without the sanitizers); elsewhere the check is skipped
+ * with a note. The block must not be left with break, goto or return.
+ *
+ *   EXPECT_NO_ALLOC() {
+ *       parse(input, &arena);
+ *   }
+ */
+#define EXPECT_ALLOCS_LE(max_allocations, ...)                                                                   \
+    for (struct cutest_alloc_scope_ cutest_alloc_scope = cutest_alloc_scope_begin_();                            \
+         cutest_alloc_scope.running;                                                                             \
+         (void) (cutest_alloc_scope_end_(&cutest_alloc_scope, (max_allocations), #max_allocations, __func__,     \
+                                         __FILE__, __LINE__)                                                     \
+                 || (__VA_OPT__(cutest_test_note_(__VA_ARGS__), ) cutest_test_fail_end_(), true)))
+#define EXPECT_NO_ALLOC(...) EXPECT_ALLOCS_LE(0, __VA_ARGS__)
+
+/*
+ * Record the block following the macro as a span named name, a string literal,
+ * in the trace written with --cutest_trace, which is not timed otherwise. The
+ * span is lost if the block is left with break, goto or return.
+ *
+ *   CUTEST_TRACE_SCOPE("parse") {
+ *       parse(input);
+ *   }
+ */
+#define CUTEST_TRACE_SCOPE(name)                                                          \
+    for (struct cutest_trace_scope_ cutest_trace_scope = cutest_trace_scope_begin_(name); \
+         cutest_trace_scope.running;                                                      \
+         cutest_trace_scope_end_(&cutest_trace_scope))
+
+/*
+ * Call body(context, thread, iteration) iterations times on each of threads
+ * new threads, pinned to a CPU each where supported and released together by a
+ * start barrier once all of them are ready. The assertions of body are
+ * attributed to the calling test. The total throughput and the latency
+ * percentiles of each thread are printed, and returned as a struct
+ * cutest_stress_result so that the test can check them.
+ *
+ *   struct cutest_stress_result result = CUTEST_STRESS(4, 100000, push_pop, &queue);
+ *   EXPECT_LT(result.p99, 10000);
+ */
+#define CUTEST_STRESS(threads, iterations, body, context) \
+    cutest_stress_((threads), (iterations), (body), (context), __func__, __FILE__, __LINE__)
+
 #define ASSERT_TRUE(condition, ...) CUTEST_COND_TRUE(true, condition, __VA_ARGS__)
 #define ASSERT_FALSE(condition, ...) CUTEST_COND_FALSE(true, condition, __VA_ARGS__)
 #define ASSERT_EQ(val1, val2, ...) CUTEST_COMP_EQ(true, val1, val2, __VA_ARGS__)
@@ -193,4 +938,9 @@ extern bool cutest_fpa_almost_equals_ld(long double lhs, long double rhs, int ma
 #define ASSERT_LONG_DOUBLE_EQ(val1, val2, ...) CUTEST_COMP_FPA_EQ(true, (long double)val1, val2, __VA_ARGS__)
 #define ASSERT_NEAR(val1, val2, abs_error, ...) CUTEST_COMP_NEAR(true, val1, val2, abs_error, __VA_ARGS__)
 
+#define ASSERT_MEMEQ(lhs, rhs, size, ...) CUTEST_ARRAY_MEMEQ(true, lhs, rhs, size, __VA_ARGS__)
+#define ASSERT_ARRAY_EQ(lhs, rhs, size, ...) CUTEST_ARRAY_EQ(true, lhs, rhs, size, __VA_ARGS__)
+#define ASSERT_ARRAY_FLOAT_ULP_NEAR(lhs, rhs, size, max_ulps, ...) CUTEST_ARRAY_FLOAT_ULP_NEAR(true, lhs, rhs, size, max_ulps, __VA_ARGS__)
+#define ASSERT_MATCHES_GOLDEN(data, size, path, ...) CUTEST_MATCHES_GOLDEN(true, data, size, path, __VA_ARGS__)
+
 #endif //CUTEST_H
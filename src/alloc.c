@@ -0,0 +1,116 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Set by the cutest_alloc library before the tests start, and never changed
+ * while they run.
+ */
+static struct cutest_alloc_counters *(*thread_counters)() = nullptr;
+static bool *tracking = nullptr;
+
+extern void cutest_alloc_interpose(struct cutest_alloc_counters *counters(), bool tracking_flag[static 1]) {
+	thread_counters = counters;
+	tracking = tracking_flag;
+}
+
+extern bool cutest_alloc_set_tracking(bool value) {
+	if (thread_counters == nullptr) {
+		errno = ENOTSUP;
+		return !value;
+	}
+	*tracking = value;
+	return true;
+}
+
+extern void cutest_alloc_pause() {
+	if (thread_counters != nullptr) {
+		thread_counters()->paused++;
+	}
+}
+
+extern void cutest_alloc_resume() {
+	if (thread_counters != nullptr) {
+		thread_counters()->paused--;
+	}
+}
+
+/*
+ * The peak restarts from the bytes allocated at the time of the sample, so that
+ * the peak of the next sample is the one of the code in between.
+ */
+extern struct cutest_alloc_stats cutest_alloc_sample() {
+	if (thread_counters == nullptr) {
+		return (struct cutest_alloc_stats) {};
+	}
+	struct cutest_alloc_counters *counters = thread_counters();
+	struct cutest_alloc_stats stats = {
+		.allocations = counters->allocations,
+		.bytes = counters->bytes,
+		.blocks = counters->blocks,
+		.live_bytes = counters->live_bytes,
+		.peak_bytes = counters->peak_bytes,
+	};
+	counters->peak_bytes = counters->live_bytes;
+	return stats;
+}
+
+extern struct cutest_alloc_stats cutest_alloc_delta(struct cutest_alloc_stats start, struct cutest_alloc_stats end) {
+	return (struct cutest_alloc_stats) {
+		.allocations = end.allocations - start.allocations,
+		.bytes = end.bytes - start.bytes,
+		.blocks = end.blocks - start.blocks,
+		.live_bytes = end.live_bytes - start.live_bytes,
+		.peak_bytes = end.peak_bytes - start.live_bytes,
+	};
+}
+
+extern struct cutest_alloc_scope_ cutest_alloc_scope_begin_() {
+	if (thread_counters == nullptr) {
+		return (struct cutest_alloc_scope_) {.running = true};
+	}
+	struct cutest_alloc_counters *counters = thread_counters();
+	return (struct cutest_alloc_scope_) {
+		.allocations = counters->allocations,
+		.bytes = counters->bytes,
+		.available = true,
+		.running = true,
+	};
+}
+
+extern bool cutest_alloc_scope_end_(struct cutest_alloc_scope_ scope[static 1],
+                                    size_t max_allocations,
+                                    const char max_expression[static 1],
+                                    const char test_function_name[static 8],
+                                    const char file[static 1],
+                                    int line) {
+	scope->running = false;
+	if (!scope->available) {
+		cutest_output_printf(stderr,
+		                     "%s:%d: Allocations cannot be counted, skipping the allocation budget of %s.\n",
+		                     file,
+		                     line,
+		                     max_expression);
+		return true;
+	}
+	struct cutest_alloc_scope_ end = cutest_alloc_scope_begin_();
+	size_t allocations = end.allocations - scope->allocations;
+	if (allocations > max_allocations) {
+		cutest_test_fail_(test_function_name,
+		                  file,
+		                  line,
+		                  "Expected the block to make at most %s allocations.\n"
+		                  "  Actual: %zu allocations of %zu bytes in total.",
+		                  max_expression,
+		                  allocations,
+		                  end.bytes - scope->bytes);
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,128 @@
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * The replacements of the allocator functions, linked only into the test
+ * programs that count their allocations. They need a C library exporting its
+ * own implementations under other names, as glibc does. The sanitizers replace
+ * them too, and count the allocations themselves.
+ */
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(memory_sanitizer) || __has_feature(thread_sanitizer)
+#define HAS_SANITIZER_ALLOCATOR
+#endif
+#endif
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define HAS_SANITIZER_ALLOCATOR
+#endif
+#if defined(__GLIBC__) && __has_include(<malloc.h>) && !defined(HAS_SANITIZER_ALLOCATOR)
+#define HAS_MALLOC_INTERPOSITION
+#include <malloc.h>
+#endif
+
+#ifdef HAS_MALLOC_INTERPOSITION
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+static bool tracking = false;
+
+// The initial-exec model keeps the accesses from calling into the dynamic
+// loader, which may allocate.
+static thread_local struct cutest_alloc_counters counters [[gnu::tls_model("initial-exec")]] = {};
+
+[[gnu::constructor]] static void interpose();
+static struct cutest_alloc_counters *thread_counters();
+static void count_allocation(void *ptr, size_t size);
+static void count_free(void *ptr);
+
+extern void *malloc(size_t size) {
+	void *ptr = __libc_malloc(size);
+	count_allocation(ptr, size);
+	return ptr;
+}
+
+extern void *calloc(size_t count, size_t size) {
+	void *ptr = __libc_calloc(count, size);
+	count_allocation(ptr, count * size);
+	return ptr;
+}
+
+/*
+ * Every reallocation counts as an allocation, whether or not the block moves:
+ * the code asked for one.
+ */
+extern void *realloc(void *ptr, size_t size) {
+	size_t usable_size = (tracking && ptr != nullptr) ? malloc_usable_size(ptr) : 0;
+	void *result = __libc_realloc(ptr, size);
+	if (counters.paused || (result == nullptr && size > 0)) {
+		return result;
+	}
+	if (tracking) {
+		counters.blocks -= ptr != nullptr;
+		counters.live_bytes -= (ptrdiff_t) usable_size;
+	}
+	count_allocation(result, size);
+	return result;
+}
+
+extern void *aligned_alloc(size_t alignment, size_t size) {
+	void *ptr = __libc_memalign(alignment, size);
+	count_allocation(ptr, size);
+	return ptr;
+}
+
+extern int posix_memalign(void **ptr, size_t alignment, size_t size) {
+	if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+		return EINVAL;
+	}
+	void *result = __libc_memalign(alignment, size);
+	if (result == nullptr) {
+		return ENOMEM;
+	}
+	count_allocation(result, size);
+	*ptr = result;
+	return 0;
+}
+
+extern void free(void *ptr) {
+	count_free(ptr);
+	__libc_free(ptr);
+}
+
+static void interpose() {
+	cutest_alloc_interpose(thread_counters, &tracking);
+}
+
+static struct cutest_alloc_counters *thread_counters() {
+	return &counters;
+}
+
+static void count_allocation(void *ptr, size_t size) {
+	if (ptr == nullptr || counters.paused) {
+		return;
+	}
+	counters.allocations++;
+	counters.bytes += size;
+	if (tracking) {
+		counters.blocks++;
+		counters.live_bytes += (ptrdiff_t) malloc_usable_size(ptr);
+		if (counters.live_bytes > counters.peak_bytes) {
+			counters.peak_bytes = counters.live_bytes;
+		}
+	}
+}
+
+static void count_free(void *ptr) {
+	if (ptr == nullptr || !tracking || counters.paused) {
+		return;
+	}
+	counters.blocks--;
+	counters.live_bytes -= (ptrdiff_t) malloc_usable_size(ptr);
+}
+#endif
@@ -0,0 +1,149 @@
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static int entry_compare(const void *lhs, const void *rhs);
+static int entry_key_compare(const struct cutest_baseline_entry entry[static 1],
+                             const char suite_name[static 1],
+                             const char test_name[static 1]);
+static bool parse_line(struct cutest_baseline baseline[static 1], char line[static 1]);
+
+extern bool cutest_baseline_add(struct cutest_baseline baseline[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1],
+                                double time) {
+	if (baseline->capacity == baseline->size) {
+		size_t capacity = baseline->capacity ? baseline->capacity * 2 : 64;
+		struct cutest_baseline_entry *ptr = realloc(baseline->entry, capacity * sizeof *ptr);
+		if (ptr == nullptr) {
+			return false;
+		}
+		baseline->entry = ptr;
+		baseline->capacity = capacity;
+	}
+	baseline->entry[baseline->size++] = (struct cutest_baseline_entry) {
+		.suite_name = suite_name,
+		.test_name = test_name,
+		.time = time,
+	};
+	return true;
+}
+
+extern bool cutest_baseline_load(struct cutest_baseline baseline[static 1], const char path[static 1]) {
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	struct cutest_buffer data = {};
+	char chunk[4096];
+	size_t size;
+	bool result = true;
+	while (result && (size = fread(chunk, 1, sizeof chunk, file)) != 0) {
+		result = cutest_buffer_append(&data, chunk, size);
+	}
+	result = result && !ferror(file) && cutest_buffer_append(&data, "", 0);
+	fclose(file);
+	if (!result) {
+		cutest_buffer_destroy(&data);
+		return false;
+	}
+	baseline->data = data.data;
+	for (char *line = data.data; result && line != nullptr && *line != '\0';) {
+		char *end = strchr(line, '\n');
+		if (end != nullptr) {
+			*end = '\0';
+		}
+		result = parse_line(baseline, line);
+		line = (end != nullptr) ? end + 1 : nullptr;
+	}
+	if (!result) {
+		errno = EINVAL;
+		return false;
+	}
+	qsort(baseline->entry, baseline->size, sizeof *baseline->entry, entry_compare);
+	return true;
+}
+
+extern bool cutest_baseline_save(const struct cutest_baseline baseline[static 1], const char path[static 1]) {
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	fprintf(file, "# cutest baseline: <suite>.<test> <median wall time in ns>\n");
+	for (size_t i = 0; i < baseline->size; i++) {
+		const struct cutest_baseline_entry *entry = &baseline->entry[i];
+		fprintf(file, "%s.%s %" PRIu64 "\n", entry->suite_name, entry->test_name, (uint64_t) (entry->time * 1e6));
+	}
+	bool result = !ferror(file);
+	return (fclose(file) == 0) && result;
+}
+
+extern const struct cutest_baseline_entry *cutest_baseline_find(const struct cutest_baseline baseline[static 1],
+                                                                const char suite_name[static 1],
+                                                                const char test_name[static 1]) {
+	size_t low = 0;
+	size_t high = baseline->size;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		int comparison = entry_key_compare(&baseline->entry[middle], suite_name, test_name);
+		if (comparison == 0) {
+			return &baseline->entry[middle];
+		}
+		if (comparison < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return nullptr;
+}
+
+extern void cutest_baseline_destroy(struct cutest_baseline baseline[static 1]) {
+	free(baseline->entry);
+	free(baseline->data);
+	*baseline = (struct cutest_baseline) {};
+}
+
+static int entry_compare(const void *lhs, const void *rhs) {
+	const struct cutest_baseline_entry *entry = lhs;
+	const struct cutest_baseline_entry *other = rhs;
+	return entry_key_compare(entry, other->suite_name, other->test_name);
+}
+
+static int entry_key_compare(const struct cutest_baseline_entry entry[static 1],
+                             const char suite_name[static 1],
+                             const char test_name[static 1]) {
+	int comparison = strcmp(entry->suite_name, suite_name);
+	return (comparison != 0) ? comparison : strcmp(entry->test_name, test_name);
+}
+
+/*
+ * Lines hold "<suite>.<test> <nanoseconds>"; blank lines and lines starting
+ * with '#' are ignored. The names are split in place.
+ */
+static bool parse_line(struct cutest_baseline baseline[static 1], char line[static 1]) {
+	line += strspn(line, " \t\r");
+	if (*line == '\0' || *line == '#') {
+		return true;
+	}
+	size_t name_length = strcspn(line, " \t");
+	size_t suite_name_length = strcspn(line, ".");
+	if (line[name_length] == '\0' || suite_name_length == 0 || suite_name_length + 1 >= name_length) {
+		return false;
+	}
+	char *end;
+	errno = 0;
+	unsigned long long time = strtoull(&line[name_length + 1], &end, 10);
+	if (errno != 0 || end == &line[name_length + 1] || end[strspn(end, " \t\r")] != '\0') {
+		return false;
+	}
+	line[suite_name_length] = '\0';
+	line[name_length] = '\0';
+	return cutest_baseline_add(baseline, line, &line[suite_name_length + 1], (double) time / 1e6);
+}
@@ -0,0 +1,111 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+enum {
+	MAX_CALIBRATION_ROUNDS = 64,
+	MAX_STABILIZATION_ROUNDS = 4,
+};
+
+// Relative difference under which two consecutive calibration rounds are
+// considered to agree on the time per iteration.
+static const double stable_tolerance = 0.05;
+
+static bool run_once(struct cutest_test test[static 1], size_t iterations, struct cutest_benchmark_state state[static 1]);
+static int time_compare(const void *lhs, const void *rhs);
+
+extern bool cutest_benchmark_next_(struct cutest_benchmark_state state[static 1]) {
+	if (!state->running) {
+		state->running = true;
+		state->remaining = state->iterations - 1;
+		state->start_time = cutest_clock_now();
+		return true;
+	}
+	state->elapsed_time = cutest_clock_now() - state->start_time;
+	state->running = false;
+	return false;
+}
+
+extern void cutest_do_not_optimize_(const volatile void *value) {
+	(void) value;
+}
+
+extern bool cutest_benchmark_measure(struct cutest_test test[static 1],
+                                     uint64_t min_time,
+                                     size_t repetitions,
+                                     struct cutest_benchmark_result result[static 1]) {
+	struct cutest_benchmark_state state;
+	size_t iterations = 1;
+	size_t stabilization_rounds = 0;
+	double reference = 0;
+	for (size_t round = 0; round < MAX_CALIBRATION_ROUNDS; round++) {
+		if (!run_once(test, iterations, &state)) {
+			return false;
+		}
+		double time = (double) state.elapsed_time / (double) iterations;
+		if (state.elapsed_time < min_time) {
+			// Predict the iterations needed to reach min_time, growing by at
+			// most ten times per round in case the first rounds were noisy.
+			double multiplier = state.elapsed_time ? 1.4 * (double) min_time / (double) state.elapsed_time : 10;
+			multiplier = fmin(fmax(multiplier, 2), 10);
+			iterations = (iterations < SIZE_MAX / 10) ? (size_t) ((double) iterations * multiplier) : SIZE_MAX;
+			reference = 0;
+			continue;
+		}
+		if (reference != 0 && fabs(time - reference) <= stable_tolerance * reference) {
+			break;
+		}
+		if (reference != 0) {
+			// Still noisy, measure over longer runs for a few more rounds.
+			if (++stabilization_rounds > MAX_STABILIZATION_ROUNDS) {
+				break;
+			}
+			if (iterations < SIZE_MAX / 2) {
+				iterations *= 2;
+			}
+		}
+		reference = time;
+	}
+	double *time = malloc(repetitions * sizeof *time);
+	if (time == nullptr) {
+		return false;
+	}
+	for (size_t i = 0; i < repetitions; i++) {
+		if (!run_once(test, iterations, &state)) {
+			free(time);
+			return false;
+		}
+		time[i] = (double) state.elapsed_time / (double) iterations;
+	}
+	qsort(time, repetitions, sizeof *time, time_compare);
+	double median_time = (repetitions % 2) ? time[repetitions / 2] : (time[repetitions / 2 - 1] + time[repetitions / 2]) / 2;
+	*result = (struct cutest_benchmark_result) {
+		.iterations = iterations,
+		.repetitions = repetitions,
+		.min_time = time[0],
+		.median_time = median_time,
+		.p99_time = time[(size_t) ceil(0.99 * (double) repetitions) - 1],
+		.bytes_per_second = median_time > 0 ? (double) state.bytes_per_iteration * 1e9 / median_time : 0,
+		.items_per_second = median_time > 0 ? (double) state.items_per_iteration * 1e9 / median_time : 0,
+	};
+	free(time);
+	return true;
+}
+
+static bool run_once(struct cutest_test test[static 1], size_t iterations, struct cutest_benchmark_state state[static 1]) {
+	*state = (struct cutest_benchmark_state) {
+		.iterations = iterations,
+	};
+	test->benchmark(state);
+	return test->result && state->start_time != 0 && !state->running;
+}
+
+static int time_compare(const void *lhs, const void *rhs) {
+	double l = *(const double *) lhs;
+	double r = *(const double *) rhs;
+	return (l > r) - (l < r);
+}
@@ -0,0 +1,88 @@
+#include "cutest_internal.h"
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool reserve(struct cutest_buffer buffer[static 1], size_t required);
+
+extern bool cutest_buffer_vprintf(struct cutest_buffer buffer[static 1], const char *format, va_list args) {
+	va_list args_copy;
+	va_copy(args_copy, args);
+	int length = vsnprintf(nullptr, 0, format, args_copy);
+	va_end(args_copy);
+	if (length < 0 || !reserve(buffer, buffer->size + (size_t) length + 1)) {
+		return false;
+	}
+	vsnprintf(buffer->data + buffer->size, buffer->capacity - buffer->size, format, args);
+	buffer->size += (size_t) length;
+	return true;
+}
+
+extern bool cutest_buffer_printf(struct cutest_buffer buffer[static 1], const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	bool result = cutest_buffer_vprintf(buffer, format, args);
+	va_end(args);
+	return result;
+}
+
+extern bool cutest_buffer_append(struct cutest_buffer buffer[static 1], const void *data, size_t size) {
+	if (!reserve(buffer, buffer->size + size + 1)) {
+		return false;
+	}
+	memcpy(buffer->data + buffer->size, data, size);
+	buffer->size += size;
+	buffer->data[buffer->size] = '\0';
+	return true;
+}
+
+extern bool cutest_buffer_append_json(struct cutest_buffer buffer[static 1], const char text[static 1]) {
+	static const char *const escape[UCHAR_MAX + 1] = {
+		['"'] = "\\\"", ['\\'] = "\\\\", ['\n'] = "\\n", ['\t'] = "\\t", ['\r'] = "\\r",
+	};
+	for (const unsigned char *c = (const unsigned char *) text; *c != '\0'; c++) {
+		bool result;
+		if (escape[*c] != nullptr) {
+			result = cutest_buffer_append(buffer, escape[*c], strlen(escape[*c]));
+		}
+		else if (*c < 0x20) {
+			result = cutest_buffer_printf(buffer, "\\u%04x", (unsigned) *c);
+		}
+		else {
+			result = cutest_buffer_append(buffer, c, 1);
+		}
+		if (!result) {
+			return false;
+		}
+	}
+	return true;
+}
+
+extern void cutest_buffer_clear(struct cutest_buffer buffer[static 1]) {
+	buffer->size = 0;
+}
+
+extern void cutest_buffer_destroy(struct cutest_buffer buffer[static 1]) {
+	free(buffer->data);
+	*buffer = (struct cutest_buffer) {};
+}
+
+static bool reserve(struct cutest_buffer buffer[static 1], size_t required) {
+	if (required <= buffer->capacity) {
+		return true;
+	}
+	size_t capacity = buffer->capacity ? buffer->capacity : 256;
+	while (capacity < required) {
+		capacity *= 2;
+	}
+	char *ptr = realloc(buffer->data, capacity);
+	if (ptr == nullptr) {
+		return false;
+	}
+	buffer->data = ptr;
+	buffer->capacity = capacity;
+	return true;
+}
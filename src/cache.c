@@ -0,0 +1,256 @@
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __has_include(<sys/stat.h>) && __has_include(<sys/types.h>)
+#define HAS_POSIX_FILES
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#if __has_include(<elf.h>) && __has_include(<link.h>)
+#include <elf.h>
+#include <link.h>
+#ifdef NT_GNU_BUILD_ID
+#define HAS_BUILD_ID
+#endif
+#endif
+
+/*
+ * The hash of the loaded objects, see hash_program().
+ */
+struct program_hash {
+	uint64_t hash;
+	const char *program;
+	bool failed;
+};
+
+static bool hash_program(uint64_t hash[static 1], const char program[static 1]);
+#ifdef HAS_BUILD_ID
+static int hash_object(struct dl_phdr_info *info, size_t size, void *data);
+#endif
+static bool hash_file(uint64_t hash[static 1], const char path[static 1]);
+static uint64_t hash_update(uint64_t hash, const void *data, size_t size);
+static bool set_entry_path(struct cutest_cache cache[static 1], const char suite_name[static 1], const char test_name[static 1]);
+static bool make_directories(char path[static 1]);
+
+static const uint64_t hash_offset = 0xcbf29ce484222325;
+
+extern bool cutest_cache_open(struct cutest_cache cache[static 1],
+                              const char directory[static 1],
+                              const char program[static 1],
+                              const char environment[static 1],
+                              const char mode[static 1]) {
+#ifdef HAS_POSIX_FILES
+	*cache = (struct cutest_cache) {};
+	uint64_t key = hash_offset;
+	if (!hash_program(&key, program)) {
+		return false;
+	}
+	struct cutest_buffer name = {};
+	for (const char *names = environment; *names != '\0';) {
+		size_t length = strcspn(names, ",");
+		cutest_buffer_clear(&name);
+		if (!cutest_buffer_append(&name, names, length) || !cutest_buffer_append(&name, "", 1)) {
+			cutest_buffer_destroy(&name);
+			return false;
+		}
+		// An unset variable differs from an empty one.
+		const char *value = getenv(name.data);
+		key = hash_update(key, name.data, length + 1);
+		key = (value != nullptr) ? hash_update(key, value, strlen(value) + 1) : hash_update(key, "\x01", 1);
+		names += length + (names[length] == ',');
+	}
+	cutest_buffer_destroy(&name);
+	key = hash_update(key, mode, strlen(mode) + 1);
+	if (!cutest_buffer_printf(&cache->path, "%s/%016" PRIx64 "/", directory, key)) {
+		cutest_buffer_destroy(&cache->path);
+		return false;
+	}
+	cache->directory_size = cache->path.size;
+	if (!make_directories(cache->path.data)) {
+		cutest_buffer_destroy(&cache->path);
+		return false;
+	}
+	return true;
+#else
+	(void) cache;
+	(void) directory;
+	(void) program;
+	(void) environment;
+	(void) mode;
+	errno = ENOTSUP;
+	return false;
+#endif
+}
+
+extern bool cutest_cache_contains(struct cutest_cache cache[static 1],
+                                  const char suite_name[static 1],
+                                  const char test_name[static 1]) {
+	if (!set_entry_path(cache, suite_name, test_name)) {
+		return false;
+	}
+	FILE *file = fopen(cache->path.data, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	// The entry holds the full name of its test, in case of a collision.
+	size_t suite_name_length = strlen(suite_name);
+	size_t test_name_length = strlen(test_name);
+	size_t length = suite_name_length + 1 + test_name_length;
+	char *content = malloc(length + 2);
+	if (content == nullptr) {
+		fclose(file);
+		return false;
+	}
+	bool result = fread(content, 1, length + 2, file) == length + 1 && content[length] == '\n'
+	              && memcmp(content, suite_name, suite_name_length) == 0 && content[suite_name_length] == '.'
+	              && memcmp(&content[suite_name_length + 1], test_name, test_name_length) == 0;
+	free(content);
+	fclose(file);
+	return result;
+}
+
+extern bool cutest_cache_update(struct cutest_cache cache[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1],
+                                bool passed) {
+	if (!set_entry_path(cache, suite_name, test_name)) {
+		return false;
+	}
+	if (!passed) {
+		return remove(cache->path.data) == 0 || errno == ENOENT;
+	}
+	FILE *file = fopen(cache->path.data, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool result = fprintf(file, "%s.%s\n", suite_name, test_name) >= 0;
+	return (fclose(file) == 0) && result;
+}
+
+extern void cutest_cache_destroy(struct cutest_cache cache[static 1]) {
+	cutest_buffer_destroy(&cache->path);
+	*cache = (struct cutest_cache) {};
+}
+
+/*
+ * Where the loaded objects carry an ELF build ID, the program is identified by
+ * the build IDs of all of them, so that the test modules loaded by
+ * cutest_runner and the shared libraries count as well. Objects without one
+ * are identified by their content, as is the whole program elsewhere.
+ */
+static bool hash_program(uint64_t hash[static 1], const char program[static 1]) {
+#ifdef HAS_BUILD_ID
+	struct program_hash program_hash = {.hash = *hash, .program = program};
+	dl_iterate_phdr(hash_object, &program_hash);
+	if (program_hash.failed) {
+		return false;
+	}
+	*hash = program_hash.hash;
+	return true;
+#else
+	return hash_file(hash, program);
+#endif
+}
+
+#ifdef HAS_BUILD_ID
+static int hash_object(struct dl_phdr_info *info, size_t size, void *data) {
+	(void) size;
+	struct program_hash *program_hash = data;
+	for (size_t i = 0; i < info->dlpi_phnum; i++) {
+		const ElfW(Phdr) *segment = &info->dlpi_phdr[i];
+		if (segment->p_type != PT_NOTE) {
+			continue;
+		}
+		const unsigned char *note = (const unsigned char *) (info->dlpi_addr + segment->p_vaddr);
+		const unsigned char *end = note + segment->p_memsz;
+		while ((size_t) (end - note) >= sizeof(ElfW(Nhdr))) {
+			const ElfW(Nhdr) *header = (const ElfW(Nhdr) *) note;
+			const unsigned char *name = note + sizeof *header;
+			const unsigned char *description = name + ((header->n_namesz + 3) & ~(size_t) 3);
+			if (description + header->n_descsz > end) {
+				break;
+			}
+			if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+				program_hash->hash = hash_update(program_hash->hash, description, header->n_descsz);
+				return 0;
+			}
+			note = description + ((header->n_descsz + 3) & ~(size_t) 3);
+		}
+	}
+	// The program itself has no name; other objects that cannot be read, such
+	// as the vDSO, are left out.
+	bool is_program = info->dlpi_name[0] == '\0';
+	const char *path = is_program ? "/proc/self/exe" : info->dlpi_name;
+	if (!hash_file(&program_hash->hash, path) && is_program && !hash_file(&program_hash->hash, program_hash->program)) {
+		program_hash->failed = true;
+		return 1;
+	}
+	return 0;
+}
+#endif
+
+static bool hash_file(uint64_t hash[static 1], const char path[static 1]) {
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	unsigned char buffer[BUFSIZ];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof buffer, file)) > 0) {
+		*hash = hash_update(*hash, buffer, size);
+	}
+	bool result = !ferror(file);
+	fclose(file);
+	return result;
+}
+
+/*
+ * FNV-1a.
+ */
+static uint64_t hash_update(uint64_t hash, const void *data, size_t size) {
+	const unsigned char *bytes = data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+/*
+ * Point the path of the cache to the entry of a test, named after the hash of
+ * its full name.
+ */
+static bool set_entry_path(struct cutest_cache cache[static 1], const char suite_name[static 1], const char test_name[static 1]) {
+	uint64_t hash = hash_update(hash_offset, suite_name, strlen(suite_name));
+	hash = hash_update(hash, ".", 1);
+	hash = hash_update(hash, test_name, strlen(test_name));
+	cache->path.size = cache->directory_size;
+	return cutest_buffer_printf(&cache->path, "%016" PRIx64, hash);
+}
+
+/*
+ * Create the directory path ends with and its missing parents, a component at
+ * a time.
+ */
+static bool make_directories(char path[static 1]) {
+#ifdef HAS_POSIX_FILES
+	for (char *separator = strchr(path + 1, '/'); separator != nullptr; separator = strchr(separator + 1, '/')) {
+		*separator = '\0';
+		bool created = mkdir(path, 0755) == 0 || errno == EEXIST;
+		*separator = '/';
+		if (!created) {
+			return false;
+		}
+	}
+	return true;
+#else
+	(void) path;
+	return false;
+#endif
+}
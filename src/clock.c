@@ -0,0 +1,27 @@
+#include "cutest_internal.h"
+
+#include <stdint.h>
+#include <time.h>
+
+extern uint64_t cutest_clock_now() {
+	struct timespec now;
+#if defined(CLOCK_MONOTONIC)
+	clock_gettime(CLOCK_MONOTONIC, &now);
+#elif defined(TIME_MONOTONIC)
+	timespec_get(&now, TIME_MONOTONIC);
+#else
+	timespec_get(&now, TIME_UTC);
+#endif
+	return (uint64_t) now.tv_sec * UINT64_C(1000000000) + (uint64_t) now.tv_nsec;
+}
+
+extern uint64_t cutest_clock_cpu_now(bool thread) {
+#if defined(CLOCK_PROCESS_CPUTIME_ID) && defined(CLOCK_THREAD_CPUTIME_ID)
+	struct timespec now;
+	clock_gettime(thread ? CLOCK_THREAD_CPUTIME_ID : CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (uint64_t) now.tv_sec * UINT64_C(1000000000) + (uint64_t) now.tv_nsec;
+#else
+	(void) thread;
+	return (uint64_t) clock() * (UINT64_C(1000000000) / CLOCKS_PER_SEC);
+#endif
+}
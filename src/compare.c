@@ -0,0 +1,496 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <float.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * The kernels compare blocks of VECTOR_SIZE bytes with the vector extensions of
+ * GCC and Clang, which compile to SSE2 or NEON, and on x86-64 glibc targets are
+ * also cloned for AVX2 and selected when the program is loaded. Only the blocks
+ * with a mismatch leave the fast path. The elements after the last whole block,
+ * and all of them with other compilers, are compared one at a time.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+#define HAS_VECTOR_EXTENSIONS
+#define VECTOR_SIZE 32
+#endif
+
+#if defined(HAS_VECTOR_EXTENSIONS) && defined(__x86_64__) && defined(__GLIBC__)
+#define VECTORIZED [[gnu::target_clones("avx2", "default")]]
+#else
+#define VECTORIZED
+#endif
+
+/*
+ * Rows of 16 bytes shown before and after the first mismatch of two memory
+ * blocks, and mismatching elements listed for two arrays.
+ */
+constexpr size_t HEXDUMP_ROW_SIZE = 16;
+constexpr size_t HEXDUMP_CONTEXT_ROWS = 2;
+constexpr size_t LISTED_MISMATCHES = 8;
+
+/*
+ * The number of mismatching elements and the index of the first one, or the
+ * size of the arrays if they match.
+ */
+struct mismatch {
+	size_t first;
+	size_t count;
+};
+
+#ifdef HAS_VECTOR_EXTENSIONS
+/*
+ * Every lane of the result of a vector comparison has all its bits set when the
+ * comparison holds and none otherwise.
+ */
+static inline void mask_add(struct mismatch mismatch[static 1], const void *mask, size_t index, size_t lane_bits) {
+	uint64_t word[VECTOR_SIZE / sizeof(uint64_t)];
+	memcpy(word, mask, sizeof word);
+	size_t bits = 0;
+	for (size_t i = 0; i < sizeof word / sizeof *word; i++) {
+		bits += (size_t) __builtin_popcountll(word[i]);
+	}
+	if (bits == 0) {
+		return;
+	}
+	if (mismatch->count == 0) {
+		size_t i = 0;
+		for (; word[i] == 0; i++);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		size_t bit = i * 64 + (size_t) __builtin_clzll(word[i]);
+#else
+		size_t bit = i * 64 + (size_t) __builtin_ctzll(word[i]);
+#endif
+		mismatch->first = index + bit / lane_bits;
+	}
+	mismatch->count += bits / lane_bits;
+}
+#endif
+
+static inline void scalar_add(struct mismatch mismatch[static 1], size_t index) {
+	if (mismatch->count++ == 0) {
+		mismatch->first = index;
+	}
+}
+
+/*
+ * Define compare_u<bits>(), comparing arrays of size elements of the given
+ * number of bits for equality.
+ */
+#ifdef HAS_VECTOR_EXTENSIONS
+#define DEFINE_EQUAL_KERNEL(bits)                                                                        \
+    typedef uint##bits##_t vector_u##bits [[gnu::vector_size(VECTOR_SIZE)]];                             \
+    typedef int##bits##_t vector_i##bits [[gnu::vector_size(VECTOR_SIZE)]];                              \
+                                                                                                         \
+    VECTORIZED                                                                                           \
+    static struct mismatch compare_u##bits(const void *lhs, const void *rhs, size_t size) {              \
+        constexpr size_t lanes = sizeof(vector_u##bits) / sizeof(uint##bits##_t);                        \
+        const unsigned char *l = lhs;                                                                    \
+        const unsigned char *r = rhs;                                                                    \
+        struct mismatch mismatch = {.first = size};                                                      \
+        size_t i = 0;                                                                                    \
+        for (; i + lanes <= size; i += lanes) {                                                          \
+            vector_u##bits l_block;                                                                      \
+            vector_u##bits r_block;                                                                      \
+            memcpy(&l_block, l + i * sizeof(uint##bits##_t), sizeof l_block);                            \
+            memcpy(&r_block, r + i * sizeof(uint##bits##_t), sizeof r_block);                            \
+            vector_i##bits different = l_block != r_block;                                               \
+            mask_add(&mismatch, &different, i, bits);                                                    \
+        }                                                                                                \
+        for (; i < size; i++) {                                                                          \
+            if (memcmp(l + i * sizeof(uint##bits##_t), r + i * sizeof(uint##bits##_t), bits / 8) != 0) { \
+                scalar_add(&mismatch, i);                                                                \
+            }                                                                                            \
+        }                                                                                                \
+        return mismatch;                                                                                 \
+    }
+#else
+#define DEFINE_EQUAL_KERNEL(bits)                                                           \
+    static struct mismatch compare_u##bits(const void *lhs, const void *rhs, size_t size) { \
+        return compare_elements(lhs, rhs, size, bits / 8);                                  \
+    }
+#endif
+
+/*
+ * Define ulps_<sfx>(), the ULP distance of two values of the floating-point
+ * type T, stored in the given number of bits with mantissa_digits digits, as
+ * cutest_fpa_almost_equals() computes it, and compare_ulps_<sfx>(), comparing
+ * arrays of T.
+ */
+#define DEFINE_ULP_KERNEL(T, sfx, bits, mantissa_digits)                                                              \
+    constexpr uint##bits##_t sign_bit_mask_##sfx = (uint##bits##_t) 1 << (bits - 1);                                  \
+    constexpr uint##bits##_t fraction_bit_mask_##sfx = ((uint##bits##_t) 1 << (mantissa_digits - 1)) - 1;             \
+    constexpr uint##bits##_t exponent_bit_mask_##sfx = ~(sign_bit_mask_##sfx | fraction_bit_mask_##sfx);              \
+                                                                                                                      \
+    /*                                                                                                                \
+     * Returns UINT64_MAX if either value is NaN.                                                                     \
+     */                                                                                                               \
+    static inline uint64_t ulps_##sfx(T lhs, T rhs) {                                                                 \
+        uint##bits##_t sam[2];                                                                                        \
+        memcpy(&sam[0], &lhs, sizeof sam[0]);                                                                         \
+        memcpy(&sam[1], &rhs, sizeof sam[1]);                                                                         \
+        for (size_t i = 0; i < 2; i++) {                                                                              \
+            if ((sam[i] & ~sign_bit_mask_##sfx) > exponent_bit_mask_##sfx) {                                          \
+                return UINT64_MAX;                                                                                    \
+            }                                                                                                         \
+            sam[i] = (sam[i] & sign_bit_mask_##sfx) ? ~sam[i] + 1 : sign_bit_mask_##sfx | sam[i];                     \
+        }                                                                                                             \
+        return (sam[0] >= sam[1]) ? sam[0] - sam[1] : sam[1] - sam[0];                                                \
+    }                                                                                                                 \
+                                                                                                                      \
+    VECTORIZED                                                                                                        \
+    static struct mismatch compare_ulps_##sfx(const T lhs[], const T rhs[], size_t size, uint##bits##_t max_ulps) {   \
+        struct mismatch mismatch = {.first = size};                                                                   \
+        size_t i = 0;                                                                                                 \
+        COMPARE_ULPS_BLOCKS(sfx, bits)                                                                                \
+        for (; i < size; i++) {                                                                                       \
+            if (ulps_##sfx(lhs[i], rhs[i]) > max_ulps) {                                                              \
+                scalar_add(&mismatch, i);                                                                             \
+            }                                                                                                         \
+        }                                                                                                             \
+        return mismatch;                                                                                              \
+    }
+
+/*
+ * The whole blocks of compare_ulps_<sfx>(), with the logic of ulps_<sfx>()
+ * applied to all the lanes at once: negative values are biased as ~x + 1 = -x
+ * and the others as x | sign, selected by the mask of the negative lanes, and
+ * the absolute difference of the biased values is (d ^ m) - m, where m masks
+ * the lanes in which d = l - r wrapped around.
+ */
+#ifdef HAS_VECTOR_EXTENSIONS
+#define COMPARE_ULPS_BLOCKS(sfx, bits)                                                           \
+    constexpr size_t lanes = sizeof(vector_u##bits) / sizeof(uint##bits##_t);                    \
+    for (; i + lanes <= size; i += lanes) {                                                      \
+        vector_u##bits l;                                                                        \
+        vector_u##bits r;                                                                        \
+        memcpy(&l, &lhs[i], sizeof l);                                                           \
+        memcpy(&r, &rhs[i], sizeof r);                                                           \
+        vector_u##bits l_negative = (vector_u##bits) ((vector_i##bits) l < 0);                   \
+        vector_u##bits r_negative = (vector_u##bits) ((vector_i##bits) r < 0);                   \
+        vector_u##bits l_biased = (-l & l_negative) | ((l | sign_bit_mask_##sfx) & ~l_negative); \
+        vector_u##bits r_biased = (-r & r_negative) | ((r | sign_bit_mask_##sfx) & ~r_negative); \
+        vector_u##bits wrapped = (vector_u##bits) (l_biased < r_biased);                         \
+        vector_u##bits distance = ((l_biased - r_biased) ^ wrapped) - wrapped;                   \
+        vector_i##bits different = ((l & ~sign_bit_mask_##sfx) > exponent_bit_mask_##sfx)        \
+                                 | ((r & ~sign_bit_mask_##sfx) > exponent_bit_mask_##sfx)        \
+                                 | (distance > max_ulps);                                        \
+        mask_add(&mismatch, &different, i, bits);                                                \
+    }
+#else
+#define COMPARE_ULPS_BLOCKS(sfx, bits)
+#endif
+
+/*
+ * Define cutest_array_ulp_near_<sfx>_(), listing the mismatching elements of
+ * two arrays of T with their ULP distance.
+ */
+#define DEFINE_ARRAY_ULP_NEAR(T, sfx, format)                                                          \
+    extern bool cutest_array_ulp_near_##sfx##_(const T lhs[],                                          \
+                                               const T rhs[],                                          \
+                                               size_t size,                                            \
+                                               int max_ulps,                                           \
+                                               const struct cutest_comparison_ comparison[static 1]) { \
+        struct mismatch mismatch = compare_ulps_##sfx(lhs, rhs, size, clamp_ulps(max_ulps));           \
+        if (mismatch.count == 0) {                                                                     \
+            return true;                                                                               \
+        }                                                                                              \
+        struct cutest_buffer message = {};                                                             \
+        append_ulp_near_header(&message, comparison, mismatch, size);                                  \
+        size_t listed = 0;                                                                             \
+        for (size_t i = mismatch.first; i < size && listed < LISTED_MISMATCHES; i++) {                 \
+            uint64_t ulps = ulps_##sfx(lhs[i], rhs[i]);                                                \
+            if (ulps <= clamp_ulps(max_ulps)) {                                                        \
+                continue;                                                                              \
+            }                                                                                          \
+            append(&message, "\n    [%zu] " format " vs " format, i, lhs[i], rhs[i]);                  \
+            if (ulps == UINT64_MAX) {                                                                  \
+                append(&message, " (NaN)");                                                            \
+            }                                                                                          \
+            else {                                                                                     \
+                append(&message, " (%" PRIu64 " ULPs)", ulps);                                         \
+            }                                                                                          \
+            listed++;                                                                                  \
+        }                                                                                              \
+        append_more(&message, mismatch.count - listed);                                                \
+        fail(comparison, &message);                                                                    \
+        return false;                                                                                  \
+    }
+
+static struct mismatch compare_elements(const void *lhs, const void *rhs, size_t size, size_t element_size);
+static struct mismatch compare_memory(const void *lhs, const void *rhs, size_t size, size_t element_size);
+static uint64_t clamp_ulps(int max_ulps);
+static void append_ulp_near_header(struct cutest_buffer buffer[static 1],
+                                   const struct cutest_comparison_ comparison[static 1],
+                                   struct mismatch mismatch,
+                                   size_t size);
+static void append_element(struct cutest_buffer buffer[static 1], const unsigned char element[], size_t element_size);
+static void append_more(struct cutest_buffer buffer[static 1], size_t unlisted);
+[[gnu::format(printf, 2, 3)]]
+static void append(struct cutest_buffer buffer[static 1], const char *format, ...);
+static void fail(const struct cutest_comparison_ comparison[static 1], struct cutest_buffer message[static 1]);
+
+DEFINE_EQUAL_KERNEL(8)
+DEFINE_EQUAL_KERNEL(16)
+DEFINE_EQUAL_KERNEL(32)
+DEFINE_EQUAL_KERNEL(64)
+
+static_assert(sizeof(float) == sizeof(uint32_t) && FLT_MANT_DIG == 24, "float must be IEEE-754 binary32");
+static_assert(sizeof(double) == sizeof(uint64_t) && DBL_MANT_DIG == 53, "double must be IEEE-754 binary64");
+DEFINE_ULP_KERNEL(float, f, 32, FLT_MANT_DIG)
+DEFINE_ULP_KERNEL(double, d, 64, DBL_MANT_DIG)
+
+extern bool cutest_memory_eq_(const void *lhs,
+                              const void *rhs,
+                              size_t size,
+                              const struct cutest_comparison_ comparison[static 1]) {
+	struct mismatch mismatch = compare_memory(lhs, rhs, size, 1);
+	if (mismatch.count == 0) {
+		return true;
+	}
+	struct cutest_buffer message = {};
+	append(&message,
+	       "Expected equality of these memory blocks of %s bytes:\n  %s\n  %s\n"
+	       "  %zu of %zu bytes differ, the first at offset %zu:\n",
+	       comparison->size,
+	       comparison->lhs,
+	       comparison->rhs,
+	       mismatch.count,
+	       size,
+	       mismatch.first);
+	cutest_memory_hexdump(&message, lhs, size, rhs, size, mismatch.first);
+	fail(comparison, &message);
+	return false;
+}
+
+extern bool cutest_array_eq_(const void *lhs,
+                             const void *rhs,
+                             size_t size,
+                             size_t element_size,
+                             const struct cutest_comparison_ comparison[static 1]) {
+	struct mismatch mismatch = compare_memory(lhs, rhs, size, element_size);
+	if (mismatch.count == 0) {
+		return true;
+	}
+	struct cutest_buffer message = {};
+	append(&message,
+	       "Expected equality of these arrays of %s elements:\n  %s\n  %s\n"
+	       "  %zu of %zu elements differ, the first at index %zu:",
+	       comparison->size,
+	       comparison->lhs,
+	       comparison->rhs,
+	       mismatch.count,
+	       size,
+	       mismatch.first);
+	const unsigned char *l = lhs;
+	const unsigned char *r = rhs;
+	size_t listed = 0;
+	for (size_t i = mismatch.first; i < size && listed < LISTED_MISMATCHES; i++) {
+		size_t offset = i * element_size;
+		if (memcmp(l + offset, r + offset, element_size) == 0) {
+			continue;
+		}
+		append(&message, "\n    [%zu] ", i);
+		append_element(&message, l + offset, element_size);
+		append(&message, " vs ");
+		append_element(&message, r + offset, element_size);
+		listed++;
+	}
+	append_more(&message, mismatch.count - listed);
+	fail(comparison, &message);
+	return false;
+}
+
+DEFINE_ARRAY_ULP_NEAR(float, f, "%.9g")
+DEFINE_ARRAY_ULP_NEAR(double, d, "%.17g")
+
+/*
+ * The ULP distance of long double depends on its format, so its elements are
+ * compared one at a time by cutest_fpa_almost_equals_ld().
+ */
+extern bool cutest_array_ulp_near_ld_(const long double lhs[],
+                                      const long double rhs[],
+                                      size_t size,
+                                      int max_ulps,
+                                      const struct cutest_comparison_ comparison[static 1]) {
+	struct mismatch mismatch = {.first = size};
+	for (size_t i = 0; i < size; i++) {
+		if (!cutest_fpa_almost_equals_ld(lhs[i], rhs[i], max_ulps)) {
+			scalar_add(&mismatch, i);
+		}
+	}
+	if (mismatch.count == 0) {
+		return true;
+	}
+	struct cutest_buffer message = {};
+	append_ulp_near_header(&message, comparison, mismatch, size);
+	size_t listed = 0;
+	for (size_t i = mismatch.first; i < size && listed < LISTED_MISMATCHES; i++) {
+		if (cutest_fpa_almost_equals_ld(lhs[i], rhs[i], max_ulps)) {
+			continue;
+		}
+		append(&message, "\n    [%zu] %.21Lg vs %.21Lg", i, lhs[i], rhs[i]);
+		listed++;
+	}
+	append_more(&message, mismatch.count - listed);
+	fail(comparison, &message);
+	return false;
+}
+
+static struct mismatch compare_elements(const void *lhs, const void *rhs, size_t size, size_t element_size) {
+	const unsigned char *l = lhs;
+	const unsigned char *r = rhs;
+	struct mismatch mismatch = {.first = size};
+	for (size_t i = 0; i < size; i++) {
+		if (memcmp(l + i * element_size, r + i * element_size, element_size) != 0) {
+			scalar_add(&mismatch, i);
+		}
+	}
+	return mismatch;
+}
+
+static struct mismatch compare_memory(const void *lhs, const void *rhs, size_t size, size_t element_size) {
+	static struct mismatch (*const kernel[])(const void *lhs, const void *rhs, size_t size) = {
+		[sizeof(uint8_t)] = compare_u8,
+		[sizeof(uint16_t)] = compare_u16,
+		[sizeof(uint32_t)] = compare_u32,
+		[sizeof(uint64_t)] = compare_u64,
+	};
+	if (size == 0 || lhs == rhs) {
+		return (struct mismatch) {.first = size};
+	}
+	if (element_size < sizeof kernel / sizeof *kernel && kernel[element_size] != nullptr) {
+		return kernel[element_size](lhs, rhs, size);
+	}
+	return compare_elements(lhs, rhs, size, element_size);
+}
+
+extern void cutest_memory_hexdump(struct cutest_buffer buffer[static 1],
+                                  const unsigned char lhs[],
+                                  size_t lhs_size,
+                                  const unsigned char rhs[],
+                                  size_t rhs_size,
+                                  size_t first) {
+	size_t size = (lhs_size > rhs_size) ? lhs_size : rhs_size;
+	size_t row = first / HEXDUMP_ROW_SIZE;
+	size_t rows = (size + HEXDUMP_ROW_SIZE - 1) / HEXDUMP_ROW_SIZE;
+	size_t begin = (row > HEXDUMP_CONTEXT_ROWS) ? row - HEXDUMP_CONTEXT_ROWS : 0;
+	size_t end = (row + HEXDUMP_CONTEXT_ROWS + 1 < rows) ? row + HEXDUMP_CONTEXT_ROWS + 1 : rows;
+	append(buffer, "    %-8s  %-*s  %s", "offset", (int) HEXDUMP_ROW_SIZE * 3 - 1, "lhs", "rhs");
+	if (begin > 0) {
+		append(buffer, "\n    ...");
+	}
+	for (size_t i = begin; i < end; i++) {
+		size_t offset = i * HEXDUMP_ROW_SIZE;
+		append(buffer, "\n    %08zx ", offset);
+		for (size_t j = offset; j < offset + HEXDUMP_ROW_SIZE; j++) {
+			if (j < lhs_size) {
+				append(buffer, " %02x", lhs[j]);
+			}
+			else {
+				append(buffer, "   ");
+			}
+		}
+		append(buffer, " ");
+		for (size_t j = offset; j < offset + HEXDUMP_ROW_SIZE && j < rhs_size; j++) {
+			if (j < lhs_size && lhs[j] == rhs[j]) {
+				append(buffer, " ..");
+			}
+			else {
+				append(buffer, " %02x", rhs[j]);
+			}
+		}
+	}
+	if (end < rows) {
+		append(buffer, "\n    ...");
+	}
+}
+
+extern size_t cutest_memory_mismatch(const void *lhs, const void *rhs, size_t size, size_t first[static 1]) {
+	struct mismatch mismatch = compare_memory(lhs, rhs, size, 1);
+	*first = mismatch.first;
+	return mismatch.count;
+}
+
+static uint64_t clamp_ulps(int max_ulps) {
+	return (max_ulps > 0) ? (uint64_t) max_ulps : 0;
+}
+
+static void append_ulp_near_header(struct cutest_buffer buffer[static 1],
+                                   const struct cutest_comparison_ comparison[static 1],
+                                   struct mismatch mismatch,
+                                   size_t size) {
+	append(buffer,
+	       "Expected the elements of these arrays of %s values to be within %s ULPs:\n  %s\n  %s\n"
+	       "  %zu of %zu elements differ, the first at index %zu:",
+	       comparison->size,
+	       comparison->max_ulps,
+	       comparison->lhs,
+	       comparison->rhs,
+	       mismatch.count,
+	       size,
+	       mismatch.first);
+}
+
+/*
+ * Elements with the size of an integer type are shown as its hexadecimal value,
+ * the others as their bytes.
+ */
+static void append_element(struct cutest_buffer buffer[static 1], const unsigned char element[], size_t element_size) {
+	uint64_t value = 0;
+	if (element_size == sizeof(uint8_t)) {
+		value = element[0];
+	}
+	else if (element_size == sizeof(uint16_t)) {
+		uint16_t v;
+		memcpy(&v, element, sizeof v);
+		value = v;
+	}
+	else if (element_size == sizeof(uint32_t)) {
+		uint32_t v;
+		memcpy(&v, element, sizeof v);
+		value = v;
+	}
+	else if (element_size == sizeof(uint64_t)) {
+		memcpy(&value, element, sizeof value);
+	}
+	else {
+		append(buffer, "{");
+		for (size_t i = 0; i < element_size; i++) {
+			append(buffer, (i == 0) ? "%02x" : " %02x", element[i]);
+		}
+		append(buffer, "}");
+		return;
+	}
+	append(buffer, "0x%0*" PRIx64, (int) element_size * 2, value);
+}
+
+static void append_more(struct cutest_buffer buffer[static 1], size_t unlisted) {
+	if (unlisted > 0) {
+		append(buffer, "\n    ... and %zu more", unlisted);
+	}
+}
+
+static void append(struct cutest_buffer buffer[static 1], const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	bool result = cutest_buffer_vprintf(buffer, format, args);
+	va_end(args);
+	if (!result) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
+static void fail(const struct cutest_comparison_ comparison[static 1], struct cutest_buffer message[static 1]) {
+	cutest_test_fail_(comparison->test_function_name, comparison->file, comparison->line, "%s", message->data);
+	cutest_buffer_destroy(message);
+}
@@ -0,0 +1,120 @@
+#include "cutest_internal.h"
+
+#include <stdio.h>
+
+static void print_program_start(void *context, const struct cutest cutest[static 1]);
+static void print_suite_start(void *context, const struct cutest_test_suite suite[static 1]);
+static void print_test_start(void *context,
+                             const struct cutest_test_suite suite[static 1],
+                             const struct cutest_test test[static 1]);
+static void print_assertion_failure(void *context,
+                                    const struct cutest_test test[static 1],
+                                    const char file[static 1],
+                                    int line,
+                                    const char message[static 1]);
+static void print_test_end(void *context,
+                           const struct cutest_test_suite suite[static 1],
+                           const struct cutest_test test[static 1],
+                           const struct cutest_result result[static 1]);
+static void print_test_failure(void *context,
+                               const struct cutest_test_suite suite[static 1],
+                               const struct cutest_test test[static 1],
+                               const struct cutest_result result[static 1]);
+static void print_suite_end(void *context,
+                            const struct cutest_test_suite suite[static 1],
+                            const struct cutest_result result[static 1]);
+static void print_program_end(void *context, const struct cutest cutest[static 1], const struct cutest_result result[static 1]);
+
+const struct cutest_listener cutest_console_listener = {
+	.on_program_start = print_program_start,
+	.on_suite_start = print_suite_start,
+	.on_test_start = print_test_start,
+	.on_assertion_failure = print_assertion_failure,
+	.on_test_end = print_test_end,
+	.on_suite_end = print_suite_end,
+	.on_program_end = print_program_end,
+};
+
+const struct cutest_listener cutest_brief_console_listener = {
+	.on_program_start = print_program_start,
+	.on_assertion_failure = print_assertion_failure,
+	.on_test_end = print_test_failure,
+	.on_program_end = print_program_end,
+};
+
+static void print_program_start(void *, const struct cutest cutest[static 1]) {
+	cutest_output_printf(stdout,
+	                     "[==========] Running %zu tests from %zu test suites.\n"
+	                     "[----------] Global test environment set-up.\n",
+	                     cutest->enabled_tests,
+	                     cutest->enabled_suites);
+}
+
+static void print_suite_start(void *, const struct cutest_test_suite suite[static 1]) {
+	cutest_output_printf(stdout, "[----------] %zu tests from %s\n", suite->enabled_tests, suite->name);
+}
+
+static void print_test_start(void *,
+                             const struct cutest_test_suite suite[static 1],
+                             const struct cutest_test test[static 1]) {
+	cutest_output_printf(stdout, "[ RUN      ] %s.%s\n", suite->name, test->name);
+}
+
+static void print_assertion_failure(void *,
+                                    const struct cutest_test[static 1],
+                                    const char file[static 1],
+                                    int line,
+                                    const char message[static 1]) {
+	cutest_output_printf(stderr, "%s:%d: Failure\n%s\n", file, line, message);
+}
+
+static void print_test_end(void *,
+                           const struct cutest_test_suite suite[static 1],
+                           const struct cutest_test test[static 1],
+                           const struct cutest_result result[static 1]) {
+	cutest_output_printf(stdout,
+	                     "%s %s.%s (%.2f ms, %.2f ms CPU)\n",
+	                     result->failed_tests == 0 ? "[       OK ]" : "[  FAILED  ]",
+	                     suite->name,
+	                     test->name,
+	                     result->wall_time,
+	                     result->cpu_time);
+}
+
+static void print_test_failure(void *context,
+                               const struct cutest_test_suite suite[static 1],
+                               const struct cutest_test test[static 1],
+                               const struct cutest_result result[static 1]) {
+	if (result->failed_tests != 0) {
+		print_test_end(context, suite, test, result);
+	}
+}
+
+static void print_suite_end(void *,
+                            const struct cutest_test_suite suite[static 1],
+                            const struct cutest_result result[static 1]) {
+	cutest_output_printf(stdout,
+	                     "[----------] %zu tests from %s (%.2f ms total, %.2f ms CPU)\n",
+	                     result->tests,
+	                     suite->name,
+	                     result->wall_time,
+	                     result->cpu_time);
+}
+
+static void print_program_end(void *, const struct cutest cutest[static 1], const struct cutest_result result[static 1]) {
+	cutest_output_printf(stdout,
+	                     "\n[----------] Global test environment tear-down.\n"
+	                     "[==========] %zu test from %zu test suite ran. (%.2f ms total, %.2f ms CPU)\n"
+	                     "[  PASSED  ] %zu tests.\n",
+	                     result->tests,
+	                     cutest->enabled_suites,
+	                     result->wall_time,
+	                     result->cpu_time,
+	                     result->tests - result->failed_tests);
+	if (result->cached_tests > 0) {
+		cutest_output_printf(stdout, "[  CACHED  ] %zu tests, passed in a previous run.\n", result->cached_tests);
+	}
+	if (result->failed_tests > 0) {
+		cutest_output_printf(stdout, "[  FAILED  ] %zu test, listed below:\n", result->failed_tests);
+	}
+}
@@ -1,15 +1,73 @@
 #include <buracchi/cutest/cutest.h>
 
+#include "cutest_internal.h"
+
 #include <assert.h>
 #include <errno.h>
+#include <signal.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+
+/*
+ * Storage for the tests of one registered linker section: a single allocation
+ * holding every test of the section, grouped by suite.
+ */
+struct cutest_test_block {
+	struct cutest_test_block *next;
+	const struct cutest_test_descriptor *const *begin;
+	struct cutest_test test[];
+};
+
+/*
+ * A failed assertion of the calling thread waiting for its message.
+ */
+struct pending_failure {
+	struct cutest_test *test;
+	struct cutest_thread_context context;
+	const char *file;
+	int line;
+	struct cutest_buffer message;
+};
 
 struct cutest *cutest_ = nullptr;
 
+static thread_local struct cutest_buffer *output_capture = nullptr;
+static thread_local struct cutest_test *current_test = nullptr;
+static thread_local struct cutest_failures *failure_capture = nullptr;
+static thread_local struct pending_failure pending_failure = {};
+static thread_local bool delivering = false;
+
+/*
+ * Assertions of a thread that is not attached to a test go to the test of the
+ * only thread running one, if any: running counts the threads running a test,
+ * and sole is the context of the last one to start, cleared when it ends.
+ * Both are guarded by context_lock, which also serializes the delivery of the
+ * failures.
+ */
+static atomic_flag context_lock = ATOMIC_FLAG_INIT;
+static size_t running = 0;
+static struct cutest_thread_context sole = {};
+static atomic_bool break_on_failure = false;
+// Set by an assertion failing where no test could be found for it.
+static atomic_bool unattributed_failure = false;
+
+static void lock();
+static void unlock();
+static struct cutest_thread_context running_context();
+static void fail_unattributed(const char file[static 1], int line, const char *fmessage, va_list args);
+static void break_if_requested();
 static struct cutest_test *find_test(const char test_function_name[static 8]);
+static struct cutest_test *test_add(struct cutest cutest[static 1],
+                                    const struct cutest_test_descriptor descriptor[static 1]);
+static struct cutest_test test_from_descriptor(const struct cutest_test_descriptor descriptor[static 1]);
+static bool test_section_add(struct cutest cutest[static 1],
+                             const struct cutest_test_descriptor *const *begin,
+                             const struct cutest_test_descriptor *const *end);
+static int descriptor_compare(const void *lhs, const void *rhs);
 
 [[maybe_unused]]
 [[gnu::constructor(110)]]
@@ -28,6 +86,21 @@ extern void cutest_test_add_(const char suite_name[static 1], const char test_na
 	}
 }
 
+extern void cutest_test_register_(const struct cutest_test_descriptor descriptor[static 1]) {
+	if (test_add(cutest_, descriptor) == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
+extern void cutest_test_section_register_(const struct cutest_test_descriptor *const *begin,
+                                          const struct cutest_test_descriptor *const *end) {
+	if (!test_section_add(cutest_, begin, end)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
 extern struct cutest *cutest_init(size_t initial_suite_capacity, size_t initial_test_capacity) {
 	assert((initial_suite_capacity > 0) && "Initial suite capacity must be greater than zero.");
 	assert((initial_test_capacity > 0) && "Initial test capacity must be greater than zero.");
@@ -52,7 +125,14 @@ extern struct cutest *cutest_init(size_t initial_suite_capacity, size_t initial_
 
 extern void cutest_destroy(struct cutest *cutest) {
 	for (size_t i = 0; i < cutest->size; i++) {
-		free(cutest->suite[i].test);
+		if (!cutest->suite[i].static_storage) {
+			free(cutest->suite[i].test);
+		}
+	}
+	while (cutest->test_blocks != nullptr) {
+		struct cutest_test_block *next = cutest->test_blocks->next;
+		free(cutest->test_blocks);
+		cutest->test_blocks = next;
 	}
 	free(cutest->suite);
 	free(cutest);
@@ -97,56 +177,289 @@ extern struct cutest_test *cutest_test_add(struct cutest cutest[static 1],
                                            const char suite_name[static 1],
                                            const char test_name[static 1],
                                            void test()) {
-	struct cutest_test_suite *suite = cutest_test_suite_get(cutest, suite_name);
-	if (suite == nullptr) {
-		suite = cutest_test_suite_add(cutest, suite_name);
-	}
-	if (suite == nullptr) {
-		return nullptr;
-	}
-	if (suite->capacity == suite->size) {
-		suite->capacity *= 2;
-		size_t new_size = suite->capacity * sizeof(struct cutest_test);
-		struct cutest_test *ptr = realloc(suite->test, new_size);
-		if (ptr == nullptr) {
-			suite->capacity /= 2;
-			return nullptr;
-		}
-		suite->test = ptr;
-	}
-	suite->test[suite->size] = (struct cutest_test) {
+	return test_add(cutest, &(struct cutest_test_descriptor) {
+		.suite_name = suite_name,
 		.name = test_name,
 		.execute = test,
-		.result = true,
-		.enabled = true,
-	};
-	suite->size++;
-	suite->enabled_tests++;
-	cutest->total_tests++;
-	cutest->enabled_tests++;
-	return &suite->test[suite->size - 1];
+	});
 }
 
+/*
+ * The failure is held until cutest_test_fail_end_(), so that the message of the
+ * assertion, if any, is delivered with it.
+ */
 extern void cutest_test_fail_(const char test_function_name[static 8],
                               const char file[static 1],
                               int line,
                               const char *fmessage,
                               ...) {
-	struct cutest_test *test;
+	cutest_test_fail_end_();
+	struct cutest_thread_context context = (current_test != nullptr) ? cutest_thread_context() : running_context();
+	// Assertions outside a test run by the runner (e.g. a test function called
+	// directly from a custom main) are attributed by the name of the caller.
+	struct cutest_test *test = (context.test != nullptr) ? context.test : find_test(test_function_name);
+	if (test == nullptr) {
+		va_list args;
+		va_start(args, fmessage);
+		fail_unattributed(file, line, fmessage, args);
+		va_end(args);
+		return;
+	}
+	test->result = false;
+	cutest_alloc_pause();
+	if (cutest_trace_enabled()) {
+		cutest_trace_record(&(struct cutest_trace_event) {
+			.phase = CUTEST_TRACE_INSTANT,
+			.category = "assertion",
+			.name = "failure",
+			.time = cutest_clock_now(),
+			.file = file,
+			.line = line,
+		});
+	}
+	pending_failure = (struct pending_failure) {
+		.test = test,
+		.context = context,
+		.file = file,
+		.line = line,
+	};
+	va_list args;
+	va_start(args, fmessage);
+	if (!cutest_buffer_vprintf(&pending_failure.message, fmessage, args)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	va_end(args);
+	cutest_alloc_resume();
+}
+
+extern void cutest_test_note_(const char *fmessage, ...) {
 	va_list args;
 	va_start(args, fmessage);
-	fprintf(stderr, "%s:%d: Failure\n", file, line);
-	test = find_test(test_function_name);
-	assert((test != nullptr) && "CuTest assert macros must be called within a test.");
-	if (test != nullptr) {
-		test->result = false;
-		vfprintf(stderr, fmessage, args);
-		fprintf(stderr, "\n");
+	cutest_alloc_pause();
+	if (pending_failure.test == nullptr) {
+		cutest_output_vprintf(stderr, fmessage, args);
+		cutest_output_printf(stderr, "\n");
+	}
+	else if (!cutest_buffer_append(&pending_failure.message, "\n", 1)
+	         || !cutest_buffer_vprintf(&pending_failure.message, fmessage, args)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	cutest_alloc_resume();
+	va_end(args);
+}
+
+extern void cutest_test_fail_end_() {
+	if (pending_failure.test == nullptr) {
+		return;
+	}
+	cutest_alloc_pause();
+	struct pending_failure failure = pending_failure;
+	pending_failure = (struct pending_failure) {};
+	const char *message = (failure.message.data != nullptr) ? failure.message.data : "";
+	// The failures of the threads of a test are delivered one at a time, so that
+	// their messages never interleave. A listener may fail in turn.
+	bool locked = !delivering;
+	if (locked) {
+		lock();
+		delivering = true;
+	}
+	struct cutest_buffer *previous_output = output_capture;
+	output_capture = failure.context.output;
+	if (failure.context.failures != nullptr
+	    && !cutest_failures_add(failure.context.failures, failure.file, failure.line, "%s", message)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	cutest_listeners_assertion_failure(failure.test, failure.file, failure.line, message);
+	output_capture = previous_output;
+	if (locked) {
+		delivering = false;
+		unlock();
+	}
+	cutest_buffer_destroy(&failure.message);
+	cutest_alloc_resume();
+	break_if_requested();
+}
+
+extern void cutest_failure_set_break(bool value) {
+	atomic_store_explicit(&break_on_failure, value, memory_order_relaxed);
+}
+
+extern bool cutest_failure_unattributed() {
+	return atomic_load_explicit(&unattributed_failure, memory_order_relaxed);
+}
+
+extern struct cutest_thread_context cutest_thread_context() {
+	return (struct cutest_thread_context) {
+		.test = current_test,
+		.failures = failure_capture,
+		.output = output_capture,
+	};
+}
+
+extern void cutest_thread_attach(struct cutest_thread_context context) {
+	current_test = context.test;
+	failure_capture = context.failures;
+	output_capture = context.output;
+}
+
+extern struct cutest_test *cutest_test_current() {
+	return current_test;
+}
+
+extern struct cutest_test *cutest_test_set_current(struct cutest_test *test) {
+	struct cutest_test *previous = current_test;
+	current_test = test;
+	lock();
+	if (previous == nullptr && test != nullptr) {
+		running++;
+		sole = cutest_thread_context();
+	}
+	else if (previous != nullptr && test == nullptr) {
+		running--;
+		if (sole.test == previous) {
+			sole = (struct cutest_thread_context) {};
+		}
+	}
+	else if (sole.test == previous) {
+		sole.test = test;
+	}
+	unlock();
+	return previous;
+}
+
+extern struct cutest_buffer *cutest_output_capture(struct cutest_buffer *buffer) {
+	struct cutest_buffer *previous = output_capture;
+	output_capture = buffer;
+	return previous;
+}
+
+extern struct cutest_failures *cutest_failure_capture(struct cutest_failures *failures) {
+	struct cutest_failures *previous = failure_capture;
+	failure_capture = failures;
+	return previous;
+}
+
+extern bool cutest_failures_vadd(struct cutest_failures failures[static 1],
+                                 const char *file,
+                                 int line,
+                                 const char *format,
+                                 va_list args) {
+	if (failures->capacity == failures->size) {
+		size_t capacity = failures->capacity ? failures->capacity * 2 : 4;
+		struct cutest_failure *ptr = realloc(failures->failure, capacity * sizeof *ptr);
+		if (ptr == nullptr) {
+			return false;
+		}
+		failures->failure = ptr;
+		failures->capacity = capacity;
+	}
+	size_t message = failures->message.size;
+	// Messages are stored one after the other, each with its terminator.
+	if (!cutest_buffer_vprintf(&failures->message, format, args) || !cutest_buffer_append(&failures->message, "", 1)) {
+		return false;
+	}
+	failures->failure[failures->size++] = (struct cutest_failure) {
+		.file = file,
+		.line = line,
+		.message = message,
+	};
+	return true;
+}
+
+extern bool cutest_failures_add(struct cutest_failures failures[static 1],
+                                const char *file,
+                                int line,
+                                const char *format,
+                                ...) {
+	va_list args;
+	va_start(args, format);
+	bool result = cutest_failures_vadd(failures, file, line, format, args);
+	va_end(args);
+	return result;
+}
+
+extern void cutest_failures_destroy(struct cutest_failures failures[static 1]) {
+	free(failures->failure);
+	cutest_buffer_destroy(&failures->message);
+	*failures = (struct cutest_failures) {};
+}
+
+extern void cutest_output_vprintf(FILE stream[static 1], const char *format, va_list args) {
+	cutest_alloc_pause();
+	if (output_capture == nullptr || !cutest_buffer_vprintf(output_capture, format, args)) {
+		vfprintf(stream, format, args);
 	}
+	cutest_alloc_resume();
+}
+
+extern void cutest_output_printf(FILE stream[static 1], const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	cutest_output_vprintf(stream, format, args);
 	va_end(args);
 }
 
+static void lock() {
+	while (atomic_flag_test_and_set_explicit(&context_lock, memory_order_acquire)) {
+		thrd_yield();
+	}
+}
+
+static void unlock() {
+	atomic_flag_clear_explicit(&context_lock, memory_order_release);
+}
+
+static struct cutest_thread_context running_context() {
+	lock();
+	struct cutest_thread_context context = (running == 1) ? sole : (struct cutest_thread_context) {};
+	unlock();
+	return context;
+}
+
+/*
+ * A failure from a thread that is not attached to a test, while several tests
+ * run, in a function whose name does not lead to a test. It is reported on its
+ * own and fails the whole run, rather than being dropped.
+ */
+static void fail_unattributed(const char file[static 1], int line, const char *fmessage, va_list args) {
+	atomic_store_explicit(&unattributed_failure, true, memory_order_relaxed);
+	cutest_alloc_pause();
+	struct cutest_buffer message = {};
+	if (!cutest_buffer_vprintf(&message, fmessage, args)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	cutest_output_printf(stderr,
+	                     "%s:%d: Failure outside of any test\n%s\n",
+	                     file,
+	                     line,
+	                     (message.data != nullptr) ? message.data : "");
+	cutest_buffer_destroy(&message);
+	cutest_alloc_resume();
+	break_if_requested();
+}
+
+static void break_if_requested() {
+	if (atomic_load_explicit(&break_on_failure, memory_order_relaxed)) {
+#ifdef SIGTRAP
+		raise(SIGTRAP);
+#else
+		abort();
+#endif
+	}
+}
+
+/*
+ * Test functions are named test_<suite><test>; assertions may also fail in
+ * other functions, such as the hooks of an environment.
+ */
 static struct cutest_test *find_test(const char test_function_name[static 8]) {
+	if (strncmp(test_function_name, "test_", sizeof("test")) != 0) {
+		return nullptr;
+	}
 	for (size_t i = 0; i < cutest_->size; i++) {
 		struct cutest_test_suite *suite = &cutest_->suite[i];
 		const char *tfn_ptr = test_function_name + sizeof("test");
@@ -162,3 +475,151 @@ static struct cutest_test *find_test(const char test_function_name[static 8]) {
 	}
 	return nullptr;
 }
+
+static struct cutest_test *test_add(struct cutest cutest[static 1],
+                                    const struct cutest_test_descriptor descriptor[static 1]) {
+	struct cutest_test_suite *suite = cutest_test_suite_get(cutest, descriptor->suite_name);
+	if (suite == nullptr) {
+		suite = cutest_test_suite_add(cutest, descriptor->suite_name);
+	}
+	if (suite == nullptr) {
+		return nullptr;
+	}
+	if (suite->capacity == suite->size || suite->static_storage) {
+		// Tests registered from a linker section live in a shared block, the
+		// suite gets storage of its own the first time it grows at runtime.
+		size_t new_size = 2 * suite->capacity * sizeof(struct cutest_test);
+		struct cutest_test *ptr = suite->static_storage ? malloc(new_size) : realloc(suite->test, new_size);
+		if (ptr == nullptr) {
+			return nullptr;
+		}
+		if (suite->static_storage) {
+			memcpy(ptr, suite->test, suite->size * sizeof(struct cutest_test));
+			suite->static_storage = false;
+		}
+		suite->capacity *= 2;
+		suite->test = ptr;
+	}
+	suite->test[suite->size] = test_from_descriptor(descriptor);
+	size_t cases = suite->test[suite->size].cases;
+	suite->size++;
+	suite->enabled_tests += cases;
+	cutest->total_tests += cases;
+	cutest->enabled_tests += cases;
+	return &suite->test[suite->size - 1];
+}
+
+static struct cutest_test test_from_descriptor(const struct cutest_test_descriptor descriptor[static 1]) {
+	return (struct cutest_test) {
+		.name = descriptor->name,
+		.execute = descriptor->execute,
+		.benchmark = descriptor->benchmark,
+		.fuzz = descriptor->fuzz,
+		.corpus = descriptor->corpus,
+		.file = descriptor->file,
+		.line = descriptor->line,
+		.fixture = descriptor->fixture,
+		.parameters = descriptor->parameters,
+		.cases = (descriptor->parameters != nullptr) ? descriptor->parameters->size : 1,
+		.result = true,
+		.enabled = true,
+	};
+}
+
+static bool test_section_add(struct cutest cutest[static 1],
+                             const struct cutest_test_descriptor *const *begin,
+                             const struct cutest_test_descriptor *const *end) {
+	if (begin == end) {
+		return true;
+	}
+	// Every translation unit of an image registers the same section.
+	for (struct cutest_test_block *block = cutest->test_blocks; block != nullptr; block = block->next) {
+		if (block->begin == begin) {
+			return true;
+		}
+	}
+	size_t n = (size_t) (end - begin);
+	const struct cutest_test_descriptor **entry = malloc(n * sizeof *entry);
+	struct cutest_test_block *block = malloc(sizeof *block + n * sizeof(struct cutest_test));
+	if (entry == nullptr || block == nullptr) {
+		free(entry);
+		free(block);
+		return false;
+	}
+	memcpy(entry, begin, n * sizeof *entry);
+	qsort(entry, n, sizeof *entry, descriptor_compare);
+	size_t suites = 1;
+	for (size_t i = 1; i < n; i++) {
+		if (strcmp(entry[i - 1]->suite_name, entry[i]->suite_name) != 0) {
+			suites++;
+		}
+	}
+	if (cutest->capacity < cutest->size + suites) {
+		struct cutest_test_suite *ptr = realloc(cutest->suite, (cutest->size + suites) * sizeof(struct cutest_test_suite));
+		if (ptr == nullptr) {
+			free(entry);
+			free(block);
+			return false;
+		}
+		cutest->suite = ptr;
+		cutest->capacity = cutest->size + suites;
+	}
+	*block = (struct cutest_test_block) {
+		.next = cutest->test_blocks,
+		.begin = begin,
+	};
+	cutest->test_blocks = block;
+	// Suites of this section are unique after sorting, they only need to be
+	// looked up among the ones that were registered before it.
+	size_t registered_suites = cutest->size;
+	for (size_t i = 0; i < n;) {
+		const char *suite_name = entry[i]->suite_name;
+		size_t first = i;
+		for (; i < n && strcmp(entry[i]->suite_name, suite_name) == 0; i++) {
+			block->test[i] = test_from_descriptor(entry[i]);
+		}
+		struct cutest_test_suite *suite = nullptr;
+		for (size_t j = 0; j < registered_suites; j++) {
+			if (strcmp(cutest->suite[j].name, suite_name) == 0) {
+				suite = &cutest->suite[j];
+				break;
+			}
+		}
+		if (suite != nullptr) {
+			for (size_t j = first; j < i; j++) {
+				if (test_add(cutest, entry[j]) == nullptr) {
+					free(entry);
+					return false;
+				}
+			}
+			continue;
+		}
+		cutest->suite[cutest->size++] = (struct cutest_test_suite) {
+			.name = suite_name,
+			.capacity = i - first,
+			.size = i - first,
+			.test = &block->test[first],
+			.enabled = true,
+			.enabled_tests = i - first,
+			.static_storage = true,
+		};
+		cutest->enabled_suites++;
+		cutest->total_tests += i - first;
+		cutest->enabled_tests += i - first;
+	}
+	free(entry);
+	return true;
+}
+
+static int descriptor_compare(const void *lhs, const void *rhs) {
+	const struct cutest_test_descriptor *l = *(const struct cutest_test_descriptor *const *) lhs;
+	const struct cutest_test_descriptor *r = *(const struct cutest_test_descriptor *const *) rhs;
+	int result = strcmp(l->suite_name, r->suite_name);
+	if (result == 0) {
+		result = strcmp(l->file, r->file);
+	}
+	if (result == 0) {
+		result = (l->line > r->line) - (l->line < r->line);
+	}
+	return result;
+}
@@ -0,0 +1,497 @@
+#ifndef CUTEST_INTERNAL_H
+#define CUTEST_INTERNAL_H
+
+#include <buracchi/cutest/cutest.h>
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Declarations shared between the cutest and cutest_main libraries that are
+ * not part of the public interface.
+ */
+
+struct cutest_buffer {
+	char *data;
+	size_t size;
+	size_t capacity;
+};
+
+[[gnu::format(printf, 2, 0)]]
+extern bool cutest_buffer_vprintf(struct cutest_buffer buffer[static 1], const char *format, va_list args);
+[[gnu::format(printf, 2, 3)]]
+extern bool cutest_buffer_printf(struct cutest_buffer buffer[static 1], const char *format, ...);
+/*
+ * Append size bytes of data, keeping the contents null-terminated.
+ */
+extern bool cutest_buffer_append(struct cutest_buffer buffer[static 1], const void *data, size_t size);
+/*
+ * Append text escaped for the inside of a JSON string.
+ */
+extern bool cutest_buffer_append_json(struct cutest_buffer buffer[static 1], const char text[static 1]);
+extern void cutest_buffer_clear(struct cutest_buffer buffer[static 1]);
+extern void cutest_buffer_destroy(struct cutest_buffer buffer[static 1]);
+
+/*
+ * Redirect everything the calling thread reports through the cutest output
+ * functions (runner messages and assertion failures) into buffer, or back to
+ * the standard streams when buffer is nullptr. Returns the previous buffer.
+ */
+extern struct cutest_buffer *cutest_output_capture(struct cutest_buffer *buffer);
+[[gnu::format(printf, 2, 0)]]
+extern void cutest_output_vprintf(FILE stream[static 1], const char *format, va_list args);
+[[gnu::format(printf, 2, 3)]]
+extern void cutest_output_printf(FILE stream[static 1], const char *format, ...);
+
+/*
+ * A failed assertion, at file and line when it has a source location, whose
+ * message starts at the offset message in the storage of its list.
+ */
+struct cutest_failure {
+	const char *file;
+	int line;
+	size_t message;
+};
+
+/*
+ * Failures of a test, with their null-terminated messages stored one after the
+ * other in message.
+ */
+struct cutest_failures {
+	size_t size;
+	size_t capacity;
+	struct cutest_failure *failure;
+	struct cutest_buffer message;
+};
+
+/*
+ * Also record the failures of the assertions run by the calling thread in
+ * failures, or stop when failures is nullptr. Returns the previous list.
+ */
+extern struct cutest_failures *cutest_failure_capture(struct cutest_failures *failures);
+/*
+ * Make every failed assertion raise SIGTRAP once delivered, so that a debugger
+ * attached to the run stops where it failed.
+ */
+extern void cutest_failure_set_break(bool value);
+/*
+ * Whether an assertion failed where it could not be attributed to any test:
+ * in a thread that is not attached to one while several tests run. Such a
+ * failure is printed on its own and must fail the run.
+ */
+extern bool cutest_failure_unattributed();
+[[gnu::format(printf, 4, 0)]]
+extern bool cutest_failures_vadd(struct cutest_failures failures[static 1],
+                                 const char *file,
+                                 int line,
+                                 const char *format,
+                                 va_list args);
+[[gnu::format(printf, 4, 5)]]
+extern bool cutest_failures_add(struct cutest_failures failures[static 1],
+                                const char *file,
+                                int line,
+                                const char *format,
+                                ...);
+extern void cutest_failures_destroy(struct cutest_failures failures[static 1]);
+
+/*
+ * Invoke the callbacks of the registered listeners in registration order.
+ */
+extern void cutest_listeners_program_start(const struct cutest cutest[static 1]);
+extern void cutest_listeners_suite_start(const struct cutest_test_suite suite[static 1]);
+extern void cutest_listeners_test_start(const struct cutest_test_suite suite[static 1],
+                                        const struct cutest_test test[static 1]);
+extern void cutest_listeners_assertion_failure(const struct cutest_test test[static 1],
+                                               const char file[static 1],
+                                               int line,
+                                               const char message[static 1]);
+extern void cutest_listeners_test_end(const struct cutest_test_suite suite[static 1],
+                                      const struct cutest_test test[static 1],
+                                      const struct cutest_result result[static 1]);
+extern void cutest_listeners_suite_end(const struct cutest_test_suite suite[static 1],
+                                       const struct cutest_result result[static 1]);
+extern void cutest_listeners_program_end(const struct cutest cutest[static 1], const struct cutest_result result[static 1]);
+
+/*
+ * Make test the one the calling thread is executing, so that failing
+ * assertions are attributed to it without a lookup by name. Returns the
+ * previously executing test.
+ */
+extern struct cutest_test *cutest_test_set_current(struct cutest_test *test);
+extern struct cutest_test *cutest_test_current();
+
+/*
+ * Run the set-up or the tear-down of the global environments or of the suite
+ * of a fixture. Failed assertions of the hooks are reported against a
+ * placeholder test named after the hook. Return false if one failed.
+ */
+extern bool cutest_environments_set_up();
+extern bool cutest_environments_tear_down();
+extern bool cutest_fixture_set_up_suite(const struct cutest_fixture fixture[static 1]);
+extern bool cutest_fixture_tear_down_suite(const struct cutest_fixture fixture[static 1]);
+
+/*
+ * Compare the size bytes at lhs and rhs. Returns the number of bytes that
+ * differ and stores the offset of the first one in first, or size if none does.
+ */
+extern size_t cutest_memory_mismatch(const void *lhs, const void *rhs, size_t size, size_t first[static 1]);
+/*
+ * Append a hexdump of the rows of lhs and rhs around the offset first, with the
+ * bytes of rhs that equal those of lhs shown as "..".
+ */
+extern void cutest_memory_hexdump(struct cutest_buffer buffer[static 1],
+                                  const unsigned char lhs[],
+                                  size_t lhs_size,
+                                  const unsigned char rhs[],
+                                  size_t rhs_size,
+                                  size_t first);
+
+/*
+ * Make EXPECT_MATCHES_GOLDEN() rewrite the golden files that do not match
+ * instead of failing.
+ */
+extern void cutest_golden_set_update(bool update);
+/*
+ * Resolve path, when relative, against the directory of the source file file
+ * if its name is absolute, into buffer.
+ */
+extern void cutest_source_path(struct cutest_buffer buffer[static 1], const char path[static 1], const char file[static 1]);
+
+/*
+ * Settings of a fuzzing run: it stops after runs inputs or time nanoseconds
+ * when they are not 0, mutates inputs of at most max_size bytes with a random
+ * generator seeded with seed, and saves the input of a failure in
+ * artifact_dir. When minimize is true it only removes from the corpus the
+ * inputs that reach no edge not reached by the smaller ones.
+ */
+struct cutest_fuzz_options {
+	size_t runs;
+	uint64_t time;
+	size_t max_size;
+	uint64_t seed;
+	const char *artifact_dir;
+	bool minimize;
+};
+
+/*
+ * Replace the default corpus directories of the fuzz tests, next to their
+ * source files, with the subdirectories of directory named after them.
+ */
+extern void cutest_fuzz_set_corpus_dir(const char directory[static 1]);
+/*
+ * Fuzz test, of the suite named suite_name, as described by options. Returns
+ * false if an input failed the test or the corpus could not be read.
+ */
+extern bool cutest_fuzz_run(struct cutest_test test[static 1],
+                            const char suite_name[static 1],
+                            const struct cutest_fuzz_options options[static 1]);
+
+/*
+ * Allocations of a thread, counted by the replacements of the allocator
+ * functions in the cutest_alloc library: their number and requested bytes are
+ * always counted, the blocks and usable bytes still allocated and their peak
+ * only when tracking. Nothing is counted while paused.
+ */
+struct cutest_alloc_counters {
+	size_t allocations;
+	size_t bytes;
+	ptrdiff_t blocks;
+	ptrdiff_t live_bytes;
+	ptrdiff_t peak_bytes;
+	unsigned paused;
+};
+
+/*
+ * Called by the cutest_alloc library, when the test program links it, with
+ * the function returning the counters of the calling thread and the flag that
+ * turns the tracking of the blocks on. Without it no allocation is counted.
+ */
+extern void cutest_alloc_interpose(struct cutest_alloc_counters *thread_counters(), bool tracking[static 1]);
+
+/*
+ * Allocations of the calling thread counted by the replacements of the
+ * allocator functions: their number and requested bytes, and with tracking on,
+ * the blocks and usable bytes still allocated and the peak of the latter.
+ */
+struct cutest_alloc_stats {
+	size_t allocations;
+	size_t bytes;
+	ptrdiff_t blocks;
+	ptrdiff_t live_bytes;
+	ptrdiff_t peak_bytes;
+};
+
+/*
+ * Turn the tracking of the allocated blocks on or off. Fails with ENOTSUP
+ * where the allocator functions are not replaced: in programs that do not link
+ * cutest_alloc, without glibc or under the sanitizers.
+ */
+extern bool cutest_alloc_set_tracking(bool tracking);
+/*
+ * Stop and restart counting the allocations of the calling thread, around the
+ * bookkeeping cutest does while a test runs. Pauses nest.
+ */
+extern void cutest_alloc_pause();
+extern void cutest_alloc_resume();
+/*
+ * The counters of the calling thread, with the peak reached since the previous
+ * sample.
+ */
+extern struct cutest_alloc_stats cutest_alloc_sample();
+/*
+ * The allocations made between two samples, with the peak of the bytes
+ * allocated above those at start.
+ */
+extern struct cutest_alloc_stats cutest_alloc_delta(struct cutest_alloc_stats start, struct cutest_alloc_stats end);
+
+/*
+ * Nanoseconds elapsed on a monotonic clock since an unspecified starting point.
+ */
+extern uint64_t cutest_clock_now();
+
+/*
+ * Nanoseconds of CPU time consumed by the process, or by the calling thread
+ * only when thread is true and the platform can tell them apart.
+ */
+extern uint64_t cutest_clock_cpu_now(bool thread);
+
+enum cutest_trace_phase {
+	CUTEST_TRACE_COMPLETE,
+	CUTEST_TRACE_INSTANT,
+	CUTEST_TRACE_ASYNC_BEGIN,
+	CUTEST_TRACE_ASYNC_END,
+};
+
+/*
+ * An event of the Chrome trace written with --cutest_trace, named
+ * "<suite_name>.<name>" when suite_name is not nullptr. Times are cutest_clock_now()
+ * values; id pairs asynchronous events and file, when not nullptr, adds the
+ * source location to the arguments. The strings must outlive the trace.
+ */
+struct cutest_trace_event {
+	enum cutest_trace_phase phase;
+	const char *category;
+	const char *suite_name;
+	const char *name;
+	uint64_t time;
+	uint64_t duration;
+	uint64_t id;
+	const char *file;
+	int line;
+};
+
+/*
+ * Start writing a trace to path. Events are recorded into a ring buffer of the
+ * calling thread, without locks or output, and written out by
+ * cutest_trace_flush(), which the runner calls between tests.
+ */
+extern bool cutest_trace_open(const char path[static 1]);
+extern bool cutest_trace_enabled();
+extern void cutest_trace_record(const struct cutest_trace_event event[static 1]);
+extern void cutest_trace_flush();
+/*
+ * Flush the events of the calling thread and release its ring buffer.
+ */
+extern void cutest_trace_thread_end();
+extern bool cutest_trace_close();
+
+enum cutest_perf_event {
+	CUTEST_PERF_INSTRUCTIONS,
+	CUTEST_PERF_CYCLES,
+	CUTEST_PERF_CACHE_MISSES,
+	CUTEST_PERF_BRANCH_MISSES,
+	CUTEST_PERF_TASK_CLOCK,
+	CUTEST_PERF_PAGE_FAULTS,
+	CUTEST_PERF_CONTEXT_SWITCHES,
+	CUTEST_PERF_EVENTS,
+};
+
+/*
+ * A perf_event_open() group counting user-space events of the calling thread.
+ * The events that could be opened are listed in event, in group order.
+ */
+struct cutest_perf_counters {
+	enum cutest_perf_event event[CUTEST_PERF_EVENTS];
+	int fd[CUTEST_PERF_EVENTS];
+	size_t size;
+	int leader;
+	bool hardware_unavailable;
+};
+
+extern const char *cutest_perf_event_name(enum cutest_perf_event event);
+extern bool cutest_perf_event_parse(const char name[static 1], size_t length, enum cutest_perf_event event[static 1]);
+/*
+ * Open a group with the events in the events bit mask. Hardware events that
+ * cannot be opened are replaced by the software events task-clock, page-faults
+ * and context-switches. Returns false if no event could be opened at all.
+ */
+extern bool cutest_perf_open(struct cutest_perf_counters counters[static 1], unsigned events);
+extern void cutest_perf_start(struct cutest_perf_counters counters[static 1]);
+/*
+ * Stop counting and store the count of every opened event at its index in
+ * count, leaving the others untouched.
+ */
+extern bool cutest_perf_stop(struct cutest_perf_counters counters[static 1], uint64_t count[static CUTEST_PERF_EVENTS]);
+extern void cutest_perf_close(struct cutest_perf_counters counters[static 1]);
+
+struct cutest_benchmark_result {
+	size_t iterations;
+	size_t repetitions;
+	double min_time;
+	double median_time;
+	double p99_time;
+	double bytes_per_second;
+	double items_per_second;
+};
+
+/*
+ * Calibrate the number of iterations of a benchmark until a repetition takes at
+ * least min_time nanoseconds and its per-iteration time is stable, then measure
+ * it over the given number of repetitions. Times in the result are nanoseconds
+ * per iteration. Returns false if the benchmark never entered its loop or one
+ * of its assertions failed.
+ */
+extern bool cutest_benchmark_measure(struct cutest_test test[static 1],
+                                     uint64_t min_time,
+                                     size_t repetitions,
+                                     struct cutest_benchmark_result result[static 1]);
+
+struct cutest_baseline_entry {
+	const char *suite_name;
+	const char *test_name;
+	double time;
+};
+
+/*
+ * Median wall time in milliseconds of each test, either measured by a run or
+ * loaded from a baseline file. Loaded baselines are sorted by name and own the
+ * storage of their names.
+ */
+struct cutest_baseline {
+	size_t size;
+	size_t capacity;
+	struct cutest_baseline_entry *entry;
+	char *data;
+};
+
+extern bool cutest_baseline_add(struct cutest_baseline baseline[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1],
+                                double time);
+extern bool cutest_baseline_load(struct cutest_baseline baseline[static 1], const char path[static 1]);
+extern bool cutest_baseline_save(const struct cutest_baseline baseline[static 1], const char path[static 1]);
+extern const struct cutest_baseline_entry *cutest_baseline_find(const struct cutest_baseline baseline[static 1],
+                                                                const char suite_name[static 1],
+                                                                const char test_name[static 1]);
+extern void cutest_baseline_destroy(struct cutest_baseline baseline[static 1]);
+
+/*
+ * The tests that passed in previous runs of the same build, one file per test
+ * under a directory named after a key. The key hashes the ELF build IDs of the
+ * loaded objects, or their content where they have none, the values of the
+ * environment variables named in the comma-separated environment list, and
+ * mode, which describes the options of the run that can change the outcome of
+ * a test.
+ */
+struct cutest_cache {
+	struct cutest_buffer path;
+	size_t directory_size;
+};
+
+extern bool cutest_cache_open(struct cutest_cache cache[static 1],
+                              const char directory[static 1],
+                              const char program[static 1],
+                              const char environment[static 1],
+                              const char mode[static 1]);
+extern bool cutest_cache_contains(struct cutest_cache cache[static 1],
+                                  const char suite_name[static 1],
+                                  const char test_name[static 1]);
+/*
+ * Record that a test passed, or forget it if it did not.
+ */
+extern bool cutest_cache_update(struct cutest_cache cache[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1],
+                                bool passed);
+extern void cutest_cache_destroy(struct cutest_cache cache[static 1]);
+
+struct cutest_filter_pattern;
+
+/*
+ * A Google Test filter: ':'-separated patterns with the '*' and '?' wildcards,
+ * followed by the patterns to exclude after a '-'. Patterns point into the
+ * text of the filter, which must outlive it.
+ */
+struct cutest_filter {
+	struct cutest_filter_pattern *pattern;
+	size_t size;
+	size_t positive_size;
+	size_t negative_size;
+};
+
+extern bool cutest_filter_compile(struct cutest_filter filter[static 1], const char text[static 1]);
+extern bool cutest_filter_match(const struct cutest_filter filter[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1]);
+extern void cutest_filter_destroy(struct cutest_filter filter[static 1]);
+
+enum cutest_report_format {
+	CUTEST_REPORT_NONE,
+	CUTEST_REPORT_XML,
+	CUTEST_REPORT_JSONL,
+};
+
+struct cutest_report_state;
+
+/*
+ * A machine-readable report streamed while the tests run. Every record is
+ * written with a single write and the file stays complete after each one, so
+ * a crash leaves the results of the tests that finished. A report can be
+ * written to from threads and from processes forked after it was opened.
+ */
+struct cutest_report {
+	enum cutest_report_format format;
+	const char *path;
+	FILE *file;
+	FILE *index;
+	struct cutest_report_state *state;
+};
+
+/*
+ * The result of a test, with times in milliseconds.
+ */
+struct cutest_report_record {
+	const char *suite_name;
+	const struct cutest_test *test;
+	bool result;
+	double wall_time;
+	double cpu_time;
+	const struct cutest_failures *failures;
+};
+
+/*
+ * Open the report described by "xml:<path>" (JUnit XML) or "jsonl:<path>"
+ * (JSON Lines), truncating the file. Sets errno to EINVAL for an unknown format.
+ * The output must outlive the report, an XML one is rewritten when closed.
+ */
+extern bool cutest_report_open(struct cutest_report report[static 1], const char output[static 1]);
+/*
+ * Append the result of a test. Write errors do not stop the run, they are
+ * returned by cutest_report_close().
+ */
+extern void cutest_report_test(struct cutest_report report[static 1], const struct cutest_report_record record[static 1]);
+/*
+ * Finish the report with the totals of the run, its time in milliseconds.
+ */
+extern bool cutest_report_close(struct cutest_report report[static 1], size_t tests, size_t failures, double time);
+
+/*
+ * Run the registered tests as selected by the command line, which is the main
+ * of the test programs linked with cutest_main and of cutest_runner, once it
+ * has loaded the test modules. Arguments that are not options are ignored.
+ */
+extern int cutest_main(int argc, char *argv[argc + 1]);
+
+#endif //CUTEST_INTERNAL_H
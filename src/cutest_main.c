@@ -1,129 +1,2171 @@
 #include <buracchi/cutest/cutest.h>
 
+#include "cutest_internal.h"
+
 #include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <time.h>
 
+#if __has_include(<sys/resource.h>)
+#define HAS_RUSAGE 1
+#include <sys/resource.h>
+#endif
+
+#if __has_include(<poll.h>) && __has_include(<pthread.h>) && __has_include(<signal.h>) && __has_include(<sys/mman.h>) \
+    && __has_include(<sys/wait.h>) && __has_include(<unistd.h>)
+#define HAS_FORK 1
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Resources used by a test: wall-clock and CPU time in milliseconds and, with
+ * --cutest_resource_usage, the growth of the peak resident set size in KiB,
+ * page faults and context switches.
+ */
+struct usage {
+	double wall_time;
+	double cpu_time;
+	long max_rss;
+	long minor_faults;
+	long major_faults;
+	long voluntary_context_switches;
+	long involuntary_context_switches;
+};
+
+/*
+ * Wall times of the runs of a test across the iterations of --cutest_repeat.
+ */
+struct repeat_entry {
+	const char *suite_name;
+	char *test_name;
+	size_t runs;
+	size_t failures;
+	double min_time;
+	double total_time;
+	double max_time;
+};
+
 struct result {
-	size_t suites_run;
 	size_t tests_ran;
 	size_t tests_passed;
 	size_t tests_failed;
+	bool environment_failed;
+	bool hooks_failed;
+	struct usage usage;
+	struct cutest_baseline timings;
+	// Names of the cases of parameterized tests in timings, which only
+	// exist while they run.
+	char **case_names;
+	size_t case_names_size;
+	size_t case_names_capacity;
+	// Every run of the first iteration adds its entry, and the entries are
+	// sorted by name before the next one.
+	struct repeat_entry *repeats;
+	size_t repeats_size;
+	size_t repeats_capacity;
 };
 
-static void list_tests(struct cutest cutest[static 1]);
-static void run_tests(struct cutest cutest[static 1], struct result result[static 1]);
-static void run_test_suite(struct cutest_test_suite test_suite[static 1], struct result result[static 1]);
-static void run_test(struct cutest_test test[static 1], const char test_suite_name[static 1]);
-static void filter_tests(struct cutest cutest[static 1], size_t n, const char filter[static n]);
+enum jobs_backend {
+	JOBS_BACKEND_PROCESSES,
+	JOBS_BACKEND_THREADS,
+};
 
-extern int main(int argc, char *argv[argc + 1]) {
+struct options {
+	bool list_tests;
+	const char *filter;
+	struct cutest_filter compiled_filter;
+	// Iterations to run, or 0 to run until one fails.
+	size_t repeat;
+	size_t iteration;
+	bool shuffle;
+	uint32_t random_seed;
+	bool shard_cases;
+	size_t jobs;
+	enum jobs_backend jobs_backend;
+	bool benchmark;
+	uint64_t benchmark_min_time;
+	size_t benchmark_repetitions;
+	bool resource_usage;
+	bool track_alloc;
+	unsigned perf_counters;
+	const char *baseline_out;
+	const char *baseline_in;
+	struct cutest_baseline baseline;
+	double max_slowdown;
+	size_t baseline_repetitions;
+	double baseline_min_time;
+	bool baseline_warn_only;
+	bool isolate;
+	uint64_t timeout;
+	size_t total_shards;
+	size_t shard_index;
+	const char *shard_status_file;
+	const char *shard_cost_file;
+	struct cutest_baseline shard_costs;
+	const char *output;
+	struct cutest_report report;
+	const char *trace;
+	const char *fuzz;
+	struct cutest_fuzz_options fuzz_options;
+	const char *cache_dir;
+	// Comma-separated names of the environment variables in the cache key.
+	const char *cache_env;
+	const char *no_cache;
+	struct cutest_filter compiled_no_cache;
+	struct cutest_cache cache;
+	size_t cached_tests;
+};
+
+enum job_state {
+	JOB_PENDING,
+	JOB_RUNNING,
+	JOB_DONE,
+};
+
+struct job {
+	struct cutest_test_suite *suite;
+	struct cutest_test *test;
+	struct cutest_test test_case;
+	struct usage usage;
+	double median_time;
+	uint64_t start_time;
+	uint64_t end_time;
+	enum job_state state;
+	bool result;
+};
+
+/*
+ * Enabled tests in registration order, handed out to the workers one at a time.
+ * With the processes backend the whole queue lives in shared memory.
+ */
+struct job_queue {
+	atomic_size_t next;
+	size_t capacity;
+	size_t size;
+	struct job *job;
+	struct options *options;
+	mtx_t thread_lock;
+#ifdef HAS_FORK
+	pthread_mutex_t process_lock;
+#endif
+};
+
+/*
+ * The registration order of the suites and of their tests, saved before the
+ * first shuffle so that every iteration shuffles it anew, and the order of an
+ * iteration only depends on its seed.
+ */
+struct registration_order {
+	size_t size;
+	struct cutest_test_suite *suite;
+	struct cutest_test **test;
+};
+
+/*
+ * Enumerates what runs of a registered test: the test itself, or the selected
+ * cases of a parameterized test, which are not stored anywhere. Cases are
+ * matched against the filter and dealt to the shards as they are enumerated,
+ * and each is a copy of the test that lives in the iterator until the next one.
+ */
+struct test_iterator {
+	struct cutest_test *test;
+	size_t index;
+	size_t matched;
+	struct cutest_buffer name;
+	struct cutest_test test_case;
+};
+
+static int run(struct cutest cutest[static 1], struct options options[static 1], int argc, char *argv[argc + 1]);
+static bool parse_options(int argc, char *argv[argc + 1], struct options options[static 1]);
+static const char *option_value(const char arg[static 1], const char option[static 1]);
+static bool parse_size(const char value[static 1], size_t size[static 1]);
+static bool parse_perf_counters(const char value[static 1], unsigned events[static 1]);
+static bool parse_percentage(const char value[static 1], double percentage[static 1]);
+static bool parse_sharding(struct options options[static 1]);
+static const char *sharding_getenv(const char name[static 1]);
+static struct cutest_test *next_test(struct test_iterator iterator[static 1],
+                                     const char test_suite_name[static 1],
+                                     const struct options options[static 1]);
+static void list_tests(struct cutest cutest[static 1], struct options options[static 1]);
+static void run_iterations(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]);
+static void run_tests(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]);
+static void run_test_suite(struct cutest_test_suite test_suite[static 1],
+                           struct options options[static 1],
+                           struct result result[static 1]);
+static struct usage run_test(struct cutest_test test[static 1],
+                             struct cutest_test_suite test_suite[static 1],
+                             struct options options[static 1],
+                             double median_time[static 1]);
+static double run_test_repeated(struct cutest_test test[static 1],
+                                const char test_suite_name[static 1],
+                                struct options options[static 1],
+                                struct cutest_alloc_stats alloc[static 1]);
+static void run_benchmark(struct cutest_test test[static 1],
+                          const char test_suite_name[static 1],
+                          struct options options[static 1],
+                          struct cutest_failures failures[static 1]);
+static int run_fuzz(struct cutest cutest[static 1], struct options options[static 1]);
+static void run_test_perf_counters(struct cutest_test test[static 1],
+                                   const char test_suite_name[static 1],
+                                   struct options options[static 1]);
+static void check_baseline(struct cutest_test test[static 1],
+                           const char test_suite_name[static 1],
+                           struct options options[static 1],
+                           double median_time,
+                           struct cutest_failures failures[static 1]);
+static void record_timing(struct cutest_test test[static 1],
+                          const char test_suite_name[static 1],
+                          struct options options[static 1],
+                          double median_time,
+                          struct result result[static 1]);
+static void record_repeat(const char test_suite_name[static 1],
+                          const char test_name[static 1],
+                          bool passed,
+                          double time,
+                          struct options options[static 1],
+                          struct result result[static 1]);
+static int repeat_entry_compare(const void *lhs, const void *rhs);
+static void print_repeats(const struct result result[static 1]);
+static void shuffle_tests(struct cutest cutest[static 1], struct registration_order order[static 1], uint32_t seed);
+static void registration_order_destroy(struct registration_order order[static 1]);
+static size_t random_next(uint64_t state[static 1], size_t range);
+static void result_destroy(struct result result[static 1]);
+static int time_compare(const void *lhs, const void *rhs);
+static void report_test(struct cutest_test test[static 1],
+                        const char test_suite_name[static 1],
+                        struct options options[static 1],
+                        bool result,
+                        struct usage usage,
+                        const struct cutest_failures failures[static 1]);
+[[gnu::format(printf, 5, 6)]]
+static void report_test_failure(struct cutest_test test[static 1],
+                                const char test_suite_name[static 1],
+                                struct options options[static 1],
+                                struct usage usage,
+                                const char *format,
+                                ...);
+static void trace_suite(struct cutest_test_suite test_suite[static 1], enum cutest_trace_phase phase, uint64_t time);
+static const struct cutest_fixture *suite_fixture(const struct cutest_test_suite test_suite[static 1]);
+static void fail_suite(struct cutest_test_suite test_suite[static 1]);
+static void select_tests(struct cutest cutest[static 1], bool benchmarks);
+static void filter_tests(struct cutest cutest[static 1], struct options options[static 1]);
+static void shard_tests(struct cutest cutest[static 1], struct options options[static 1]);
+static void shard_tests_balanced(struct cutest cutest[static 1], struct options options[static 1]);
+static int shard_entry_compare(const void *lhs, const void *rhs);
+static void select_cases(struct cutest cutest[static 1],
+                         struct cutest_test_suite suite[static 1],
+                         struct cutest_test test[static 1],
+                         struct options options[static 1]);
+static void disable_test(struct cutest cutest[static 1],
+                         struct cutest_test_suite suite[static 1],
+                         struct cutest_test test[static 1]);
+static void skip_cached_tests(struct cutest cutest[static 1], struct options options[static 1]);
+static bool is_cached(struct cutest_test_suite suite[static 1], struct cutest_test test[static 1], struct options options[static 1]);
+static void record_cache(const char test_suite_name[static 1],
+                         const char test_name[static 1],
+                         bool passed,
+                         struct options options[static 1]);
+static void run_tests_parallel(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]);
+static struct job_queue *job_queue_create(struct cutest cutest[static 1], struct options options[static 1]);
+static void job_queue_destroy(struct job_queue queue[static 1]);
+static void run_jobs(struct job_queue queue[static 1]);
+static void run_job(struct job job[static 1], struct options options[static 1], struct cutest_buffer output[static 1]);
+static int run_jobs_thread(void *queue);
+static bool run_workers_threads(struct job_queue queue[static 1], size_t workers);
+#ifdef HAS_FORK
+static bool run_workers_processes(struct job_queue queue[static 1], size_t workers);
+static void run_job_isolated(struct job job[static 1], struct options options[static 1], struct cutest_buffer output[static 1]);
+static bool read_output(int fd, uint64_t start_time, uint64_t timeout, struct cutest_buffer output[static 1]);
+static const char *signal_name(int signal);
+#endif
+static struct usage usage_sample(struct options options[static 1]);
+static struct usage usage_delta(struct usage start, struct usage end);
+static void usage_accumulate(struct usage total[static 1], struct usage usage);
+static void print_usage(const char name[static 1], const char *test_suite_name, const char *test_name, struct usage usage);
+static void print_alloc(const char test_suite_name[static 1], const char test_name[static 1], struct cutest_alloc_stats alloc);
+[[gnu::format(printf, 1, 2)]]
+static void print(const char *format, ...);
+
+extern int cutest_main(int argc, char *argv[argc + 1]) {
 	struct cutest *cutest = cutest_;
-	if (argc > 1 && strcmp(argv[1], "--cutest_list_tests") == 0) {
-		list_tests(cutest);
+	struct options options = {
+		.repeat = 1,
+		.jobs = 1,
+		.benchmark_min_time = 10000000,
+		.benchmark_repetitions = 10,
+		.max_slowdown = 0.25,
+		.baseline_repetitions = 5,
+		.baseline_min_time = 1,
+		.fuzz_options = {
+			.max_size = 4096,
+			.artifact_dir = "",
+		},
+		.cache_env = "",
+#ifdef HAS_FORK
+		.jobs_backend = JOBS_BACKEND_PROCESSES,
+#else
+		.jobs_backend = JOBS_BACKEND_THREADS,
+#endif
+	};
+	int status = run(cutest, &options, argc, argv);
+	cutest_cache_destroy(&options.cache);
+	cutest_filter_destroy(&options.compiled_no_cache);
+	cutest_filter_destroy(&options.compiled_filter);
+	cutest_baseline_destroy(&options.baseline);
+	cutest_baseline_destroy(&options.shard_costs);
+	cutest_destroy(cutest);
+	return status;
+}
+
+/*
+ * Everything cutest_main() does but releasing what the options hold, so that
+ * every way out of it goes through the same clean-up.
+ */
+static int run(struct cutest cutest[static 1], struct options options[static 1], int argc, char *argv[argc + 1]) {
+	if (!parse_options(argc, argv, options) || !parse_sharding(options)) {
+		return EXIT_FAILURE;
+	}
+	if (options->baseline_in != nullptr && !cutest_baseline_load(&options->baseline, options->baseline_in)) {
+		fprintf(stderr, "Could not read the baseline %s: %s\n", options->baseline_in, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (options->shard_cost_file != nullptr && !cutest_baseline_load(&options->shard_costs, options->shard_cost_file)) {
+		fprintf(stderr, "Could not read the shard cost file %s: %s\n", options->shard_cost_file, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (options->fuzz != nullptr) {
+		return run_fuzz(cutest, options);
+	}
+	select_tests(cutest, options->benchmark);
+	if (options->filter != nullptr) {
+		if (!options->list_tests) {
+			printf("Note: Test filtered = %s\n", options->filter);
+		}
+		filter_tests(cutest, options);
+	}
+	if (options->list_tests) {
+		list_tests(cutest, options);
 		return EXIT_SUCCESS;
 	}
-	if (argc > 1 && strncmp(argv[1], "--cutest_filter=", strlen("--cutest_filter=")) == 0) {
-		char const *filter = argv[1] + strlen("--cutest_filter=");
-		printf("Note: Test filtered = %s\n", filter);
-		filter_tests(cutest, strlen(filter) + 1, filter);
-		if (cutest == nullptr) {
+	if (options->shard_status_file != nullptr) {
+		FILE *file = fopen(options->shard_status_file, "w");
+		if (file == nullptr || fclose(file) != 0) {
+			fprintf(stderr, "Could not write the shard status file %s: %s\n", options->shard_status_file, strerror(errno));
+			return EXIT_FAILURE;
+		}
+	}
+	if (options->total_shards > 1) {
+		printf("Note: This is test shard %zu of %zu.\n", options->shard_index + 1, options->total_shards);
+		shard_tests(cutest, options);
+	}
+	// Benchmarks always run, what they measure is not an outcome to keep, and so
+	// do the tests checked against a baseline.
+	if (options->cache_dir != nullptr && (options->benchmark || options->baseline_in != nullptr)) {
+		options->cache_dir = nullptr;
+	}
+	if (options->cache_dir != nullptr) {
+		char mode[128];
+		snprintf(mode,
+		         sizeof mode,
+		         "repeat=%zu,isolate=%d,timeout=%" PRIu64 ",track_alloc=%d",
+		         options->repeat,
+		         options->isolate,
+		         options->timeout,
+		         options->track_alloc);
+		if (!cutest_cache_open(&options->cache, options->cache_dir, argv[0], options->cache_env, mode)) {
+			fprintf(stderr, "Could not open the cache %s: %s\n", options->cache_dir, strerror(errno));
+			return EXIT_FAILURE;
+		}
+		skip_cached_tests(cutest, options);
+	}
+	if (options->output != nullptr && !cutest_report_open(&options->report, options->output)) {
+		fprintf(stderr, "Could not open the output %s: %s\n", options->output, strerror(errno));
+		return EXIT_FAILURE;
+	}
+	if (options->trace != nullptr && !cutest_trace_open(options->trace)) {
+		fprintf(stderr, "Could not open the trace %s: %s\n", options->trace, strerror(errno));
+		if (options->output != nullptr) {
+			cutest_report_close(&options->report, 0, 0, 0);
+		}
+		return EXIT_FAILURE;
+	}
+	struct result result = {};
+	run_iterations(cutest, options, &result);
+	if (options->trace != nullptr && !cutest_trace_close()) {
+		fprintf(stderr, "Could not write the trace %s: %s\n", options->trace, strerror(errno));
+		result.tests_failed++;
+	}
+	if (options->output != nullptr
+	    && !cutest_report_close(&options->report, result.tests_ran, result.tests_failed, result.usage.wall_time)) {
+		fprintf(stderr, "Could not write the output %s: %s\n", options->output, strerror(errno));
+		result.tests_failed++;
+	}
+	if (options->baseline_out != nullptr && !cutest_baseline_save(&result.timings, options->baseline_out)) {
+		fprintf(stderr, "Could not write the baseline %s: %s\n", options->baseline_out, strerror(errno));
+		result.tests_failed++;
+	}
+	result_destroy(&result);
+	if (cutest_failure_unattributed()) {
+		fprintf(stderr, "Assertions failed outside of any test, see the failures above.\n");
+		return EXIT_FAILURE;
+	}
+	return (!result.tests_failed && !result.hooks_failed) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static bool parse_options(int argc, char *argv[argc + 1], struct options options[static 1]) {
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *value;
+		if (strcmp(arg, "--cutest_list_tests") == 0) {
+			options->list_tests = true;
+		}
+		else if ((value = option_value(arg, "--cutest_filter")) != nullptr) {
+			options->filter = value;
+		}
+		else if ((value = option_value(arg, "--cutest_repeat")) != nullptr) {
+			if (strcmp(value, "-1") == 0) {
+				options->repeat = 0;
+			}
+			else if (!parse_size(value, &options->repeat) || options->repeat == 0) {
+				fprintf(stderr, "Invalid number of repetitions: %s\n", arg);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--cutest_shuffle") == 0) {
+			options->shuffle = true;
+		}
+		else if ((value = option_value(arg, "--cutest_random_seed")) != nullptr) {
+			size_t seed;
+			if (!parse_size(value, &seed) || seed > UINT32_MAX) {
+				fprintf(stderr, "Invalid random seed: %s\n", arg);
+				return false;
+			}
+			options->random_seed = (uint32_t) seed;
+		}
+		else if (strcmp(arg, "--cutest_break_on_failure") == 0) {
+			cutest_failure_set_break(true);
+		}
+		else if ((value = option_value(arg, "--cutest_jobs")) != nullptr) {
+			if (!parse_size(value, &options->jobs) || options->jobs == 0) {
+				fprintf(stderr, "Invalid number of jobs: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_jobs_backend")) != nullptr) {
+			if (strcmp(value, "threads") == 0) {
+				options->jobs_backend = JOBS_BACKEND_THREADS;
+			}
+			else if (strcmp(value, "processes") == 0) {
+#ifdef HAS_FORK
+				options->jobs_backend = JOBS_BACKEND_PROCESSES;
+#else
+				fprintf(stderr, "The processes backend is not supported on this platform.\n");
+				return false;
+#endif
+			}
+			else {
+				fprintf(stderr, "Unknown jobs backend: %s\n", arg);
+				return false;
+			}
+		}
+		else if (strcmp(arg, "--cutest_benchmark") == 0) {
+			options->benchmark = true;
+		}
+		else if ((value = option_value(arg, "--cutest_benchmark_min_time")) != nullptr) {
+			size_t min_time;
+			if (!parse_size(value, &min_time) || min_time == 0) {
+				fprintf(stderr, "Invalid benchmark minimum time: %s\n", arg);
+				return false;
+			}
+			options->benchmark_min_time = (uint64_t) min_time * 1000000;
+		}
+		else if (strcmp(arg, "--cutest_resource_usage") == 0) {
+#ifdef HAS_RUSAGE
+			options->resource_usage = true;
+#else
+			fprintf(stderr, "Resource usage is not supported on this platform.\n");
+			return false;
+#endif
+		}
+		else if (strcmp(arg, "--cutest_track_alloc") == 0) {
+			if (!cutest_alloc_set_tracking(true)) {
+				fprintf(stderr,
+				        "Allocation tracking needs a test program linking cutest_alloc, with glibc and without the "
+				        "sanitizers.\n");
+				return false;
+			}
+			options->track_alloc = true;
+		}
+		else if (strcmp(arg, "--cutest_perf_counters") == 0) {
+			parse_perf_counters("instructions,cycles,cache-misses,branch-misses,task-clock", &options->perf_counters);
+		}
+		else if ((value = option_value(arg, "--cutest_perf_counters")) != nullptr) {
+			if (!parse_perf_counters(value, &options->perf_counters)) {
+				fprintf(stderr, "Invalid performance counters: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_baseline_out")) != nullptr) {
+			options->baseline_out = value;
+		}
+		else if ((value = option_value(arg, "--cutest_baseline_in")) != nullptr) {
+			options->baseline_in = value;
+		}
+		else if ((value = option_value(arg, "--cutest_max_slowdown")) != nullptr) {
+			if (!parse_percentage(value, &options->max_slowdown)) {
+				fprintf(stderr, "Invalid maximum slowdown: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_baseline_repetitions")) != nullptr) {
+			if (!parse_size(value, &options->baseline_repetitions) || options->baseline_repetitions == 0) {
+				fprintf(stderr, "Invalid number of baseline repetitions: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_baseline_min_time")) != nullptr) {
+			size_t min_time;
+			if (!parse_size(value, &min_time)) {
+				fprintf(stderr, "Invalid baseline minimum time: %s\n", arg);
+				return false;
+			}
+			options->baseline_min_time = (double) min_time;
+		}
+		else if (strcmp(arg, "--cutest_baseline_warn_only") == 0) {
+			options->baseline_warn_only = true;
+		}
+		else if (strcmp(arg, "--cutest_isolate") == 0) {
+			options->isolate = true;
+		}
+		else if ((value = option_value(arg, "--cutest_timeout")) != nullptr) {
+			size_t timeout;
+			if (!parse_size(value, &timeout) || timeout == 0) {
+				fprintf(stderr, "Invalid test timeout: %s\n", arg);
+				return false;
+			}
+			options->timeout = timeout;
+			options->isolate = true;
+		}
+		else if ((value = option_value(arg, "--cutest_shard_cost_file")) != nullptr) {
+			options->shard_cost_file = value;
+		}
+		else if ((value = option_value(arg, "--cutest_output")) != nullptr) {
+			options->output = value;
+		}
+		else if ((value = option_value(arg, "--cutest_trace")) != nullptr) {
+			options->trace = value;
+		}
+		else if ((value = option_value(arg, "--cutest_cache_dir")) != nullptr) {
+			options->cache_dir = value;
+		}
+		else if ((value = option_value(arg, "--cutest_cache_env")) != nullptr) {
+			options->cache_env = value;
+		}
+		else if (strcmp(arg, "--cutest_no_cache") == 0) {
+			options->no_cache = "*";
+		}
+		else if ((value = option_value(arg, "--cutest_no_cache")) != nullptr) {
+			options->no_cache = value;
+		}
+		else if (strcmp(arg, "--cutest_update_golden") == 0) {
+			cutest_golden_set_update(true);
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz")) != nullptr) {
+			options->fuzz = value;
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz_runs")) != nullptr) {
+			if (!parse_size(value, &options->fuzz_options.runs)) {
+				fprintf(stderr, "Invalid number of fuzzing runs: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz_time")) != nullptr) {
+			size_t time;
+			if (!parse_size(value, &time)) {
+				fprintf(stderr, "Invalid fuzzing time: %s\n", arg);
+				return false;
+			}
+			options->fuzz_options.time = (uint64_t) time * 1000000000;
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz_max_len")) != nullptr) {
+			if (!parse_size(value, &options->fuzz_options.max_size)) {
+				fprintf(stderr, "Invalid maximum fuzzing input length: %s\n", arg);
+				return false;
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz_seed")) != nullptr) {
+			size_t seed;
+			if (!parse_size(value, &seed) || seed == 0) {
+				fprintf(stderr, "Invalid fuzzing seed: %s\n", arg);
+				return false;
+			}
+			options->fuzz_options.seed = seed;
+		}
+		else if ((value = option_value(arg, "--cutest_fuzz_artifacts")) != nullptr) {
+			options->fuzz_options.artifact_dir = value;
+		}
+		else if (strcmp(arg, "--cutest_fuzz_minimize") == 0) {
+			options->fuzz_options.minimize = true;
+		}
+		else if ((value = option_value(arg, "--cutest_corpus_dir")) != nullptr) {
+			cutest_fuzz_set_corpus_dir(value);
+		}
+		else if (strcmp(arg, "--cutest_brief") == 0) {
+			if (cutest_listener_remove(&cutest_console_listener)
+			    && !cutest_listener_add(&cutest_brief_console_listener)) {
+				perror(strerror(errno));
+				exit(1);
+			}
+		}
+		else if ((value = option_value(arg, "--cutest_benchmark_repetitions")) != nullptr) {
+			if (!parse_size(value, &options->benchmark_repetitions) || options->benchmark_repetitions == 0) {
+				fprintf(stderr, "Invalid number of benchmark repetitions: %s\n", arg);
+				return false;
+			}
+		}
+	}
+	// Isolated tests run in processes forked by the workers, which act as
+	// their fork servers.
+	if (options->isolate) {
+#ifdef HAS_FORK
+		options->jobs_backend = JOBS_BACKEND_PROCESSES;
+#else
+		fprintf(stderr, "Test isolation is not supported on this platform.\n");
+		return false;
+#endif
+	}
+	return true;
+}
+
+static const char *option_value(const char arg[static 1], const char option[static 1]) {
+	size_t length = strlen(option);
+	return (strncmp(arg, option, length) == 0 && arg[length] == '=') ? &arg[length + 1] : nullptr;
+}
+
+static bool parse_size(const char value[static 1], size_t size[static 1]) {
+	char *end;
+	errno = 0;
+	unsigned long long result = strtoull(value, &end, 10);
+	if (errno || end == value || *end != '\0' || result > SIZE_MAX) {
+		return false;
+	}
+	*size = (size_t) result;
+	return true;
+}
+
+static bool parse_perf_counters(const char value[static 1], unsigned events[static 1]) {
+	*events = 0;
+	while (true) {
+		size_t length = strcspn(value, ",");
+		enum cutest_perf_event event;
+		if (!cutest_perf_event_parse(value, length, &event)) {
+			return false;
+		}
+		*events |= 1U << event;
+		if (value[length] == '\0') {
+			return true;
+		}
+		value += length + 1;
+	}
+}
+
+/*
+ * A percentage such as "25%" or "25" as a fraction.
+ */
+static bool parse_percentage(const char value[static 1], double percentage[static 1]) {
+	char *end;
+	errno = 0;
+	double result = strtod(value, &end);
+	if (errno != 0 || end == value || !(result >= 0) || (*end != '\0' && strcmp(end, "%") != 0)) {
+		return false;
+	}
+	*percentage = result / 100;
+	return true;
+}
+
+/*
+ * Sharding is configured through the environment as in Google Test, so tools
+ * driving gtest binaries can drive cutest ones. The CUTEST_ variables take
+ * precedence over the GTEST_ ones.
+ */
+static bool parse_sharding(struct options options[static 1]) {
+	const char *total_shards = sharding_getenv("TOTAL_SHARDS");
+	const char *shard_index = sharding_getenv("SHARD_INDEX");
+	options->shard_status_file = sharding_getenv("SHARD_STATUS_FILE");
+	if (total_shards == nullptr && shard_index == nullptr) {
+		return true;
+	}
+	if (total_shards == nullptr || shard_index == nullptr || !parse_size(total_shards, &options->total_shards)
+	    || !parse_size(shard_index, &options->shard_index) || options->shard_index >= options->total_shards) {
+		fprintf(stderr,
+		        "Invalid sharding environment: TOTAL_SHARDS=%s, SHARD_INDEX=%s\n",
+		        (total_shards != nullptr) ? total_shards : "(unset)",
+		        (shard_index != nullptr) ? shard_index : "(unset)");
+		return false;
+	}
+	return true;
+}
+
+static const char *sharding_getenv(const char name[static 1]) {
+	char variable[64];
+	snprintf(variable, sizeof variable, "CUTEST_%s", name);
+	const char *value = getenv(variable);
+	if (value == nullptr) {
+		snprintf(variable, sizeof variable, "GTEST_%s", name);
+		value = getenv(variable);
+	}
+	return value;
+}
+
+static struct cutest_test *next_test(struct test_iterator iterator[static 1],
+                                     const char test_suite_name[static 1],
+                                     const struct options options[static 1]) {
+	struct cutest_test *test = iterator->test;
+	if (test->parameters == nullptr) {
+		return (iterator->index++ == 0) ? test : nullptr;
+	}
+	while (iterator->index < test->parameters->size) {
+		size_t index = iterator->index++;
+		cutest_buffer_clear(&iterator->name);
+		if (!cutest_buffer_printf(&iterator->name, "%s/%zu", test->name, index)) {
 			perror(strerror(errno));
 			exit(1);
 		}
+		if (options->filter != nullptr
+		    && !cutest_filter_match(&options->compiled_filter, test_suite_name, iterator->name.data)) {
+			continue;
+		}
+		if (options->shard_cases && iterator->matched++ % options->total_shards != options->shard_index) {
+			continue;
+		}
+		iterator->test_case = *test;
+		iterator->test_case.name = iterator->name.data;
+		iterator->test_case.parameter = index;
+		return &iterator->test_case;
 	}
-	struct result result = {};
-	run_tests(cutest, &result);
-	cutest_destroy(cutest);
-	return !result.tests_failed ? EXIT_SUCCESS : EXIT_FAILURE;
+	cutest_buffer_destroy(&iterator->name);
+	return nullptr;
 }
 
-static void list_tests(struct cutest cutest[static 1]) {
+static void list_tests(struct cutest cutest[static 1], struct options options[static 1]) {
 	printf("Place holder message: Running main() from PATH\\test_main.c\n");
 	for (size_t i = 0; i < cutest->size; i++) {
+		if (!cutest->suite[i].enabled) {
+			continue;
+		}
 		printf("%s.\n", cutest->suite[i].name);
 		for (size_t j = 0; j < cutest->suite[i].size; j++) {
-			printf("  %s\n", cutest->suite[i].test[j].name);
+			if (!cutest->suite[i].test[j].enabled) {
+				continue;
+			}
+			struct test_iterator iterator = {.test = &cutest->suite[i].test[j]};
+			for (struct cutest_test *test; (test = next_test(&iterator, cutest->suite[i].name, options)) != nullptr;) {
+				printf("  %s\n", test->name);
+			}
 		}
 	}
 }
 
-static void run_tests(struct cutest cutest[static 1], struct result result[static 1]) {
-	printf("[==========] Running %zu tests from %zu test suites.\n", cutest->enabled_suites, cutest->enabled_tests);
-	printf("[----------] Global test environment set-up.\n");
-	clock_t total_start_time = clock();
-	for (size_t i = 0; i < cutest->size; i++) {
-		if (!cutest->suite[i].enabled) {
-			continue;
+/*
+ * Each iteration resets the results of the tests, which only ever go from
+ * passed to failed while they run. A seed of 0 is replaced by one taken from
+ * the clock, and each iteration shuffles with the seed after the one of the
+ * previous iteration, printing it so that its order can be reproduced.
+ */
+static void run_iterations(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]) {
+	struct registration_order order = {};
+	uint32_t seed = options->random_seed;
+	if (options->shuffle && seed == 0) {
+		seed = (uint32_t) (cutest_clock_now() % 99999) + 1;
+	}
+	for (size_t iteration = 0; options->repeat == 0 || iteration < options->repeat; iteration++) {
+		if (options->repeat != 1) {
+			printf("\nRepeating all tests (iteration %zu) . . .\n\n", iteration + 1);
+		}
+		if (options->shuffle) {
+			printf("Note: Randomizing tests' orders with a seed of %" PRIu32 " .\n", seed);
+			shuffle_tests(cutest, &order, seed);
+			seed = (seed == UINT32_MAX) ? 1 : seed + 1;
+		}
+		for (size_t i = 0; i < cutest->size; i++) {
+			for (size_t j = 0; j < cutest->suite[i].size; j++) {
+				cutest->suite[i].test[j].result = true;
+			}
+		}
+		options->iteration = iteration;
+		size_t tests_failed = result->tests_failed;
+		run_tests(cutest, options, result);
+		if (iteration == 0 && result->repeats_size > 0) {
+			qsort(result->repeats, result->repeats_size, sizeof *result->repeats, repeat_entry_compare);
+		}
+		if (options->repeat == 0 && (result->tests_failed > tests_failed || result->hooks_failed)) {
+			break;
+		}
+	}
+	if (options->repeat != 1) {
+		print_repeats(result);
+	}
+	registration_order_destroy(&order);
+}
+
+/*
+ * Runs one iteration, adding its results to the ones of the previous
+ * iterations.
+ */
+static void run_tests(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]) {
+	cutest_listeners_program_start(cutest);
+	uint64_t total_start_time = cutest_clock_now();
+	size_t tests_ran = result->tests_ran;
+	size_t tests_failed = result->tests_failed;
+	struct usage usage = result->usage;
+	result->environment_failed = !cutest_environments_set_up();
+	if (result->environment_failed) {
+		for (size_t i = 0; i < cutest->size; i++) {
+			fail_suite(&cutest->suite[i]);
+		}
+	}
+	// Benchmarks always run alone, concurrent work would distort their timing.
+	if ((options->jobs > 1 && !options->benchmark) || options->isolate) {
+		run_tests_parallel(cutest, options, result);
+	}
+	else {
+		for (size_t i = 0; i < cutest->size; i++) {
+			if (!cutest->suite[i].enabled) {
+				continue;
+			}
+			run_test_suite(&cutest->suite[i], options, result);
 		}
-		run_test_suite(&cutest->suite[i], result);
 	}
-	clock_t total_end_time = clock();
-	double elapsed_time = ((double) (total_end_time - total_start_time)) / CLOCKS_PER_SEC * 1000;
-	printf("\n[----------] Global test environment tear-down.\n");
-	printf("[==========] %zu test from %zu test suite ran. (%.2f ms total)\n",
-	       result->tests_ran,
-	       result->suites_run,
-	       elapsed_time);
-	printf("[  PASSED  ] %zu tests.\n", result->tests_passed);
-	if (result->tests_failed > 0) {
-		printf("[  FAILED  ] %zu test, listed below:\n", result->tests_failed);
+	result->hooks_failed |= !cutest_environments_tear_down();
+	double elapsed_time = (double) (cutest_clock_now() - total_start_time) / 1e6;
+	usage = usage_delta(usage, result->usage);
+	if (options->resource_usage) {
+		print_usage("TOTAL", nullptr, nullptr, usage);
 	}
+	cutest_listeners_program_end(cutest,
+	                             &(struct cutest_result) {
+	                                 .tests = result->tests_ran - tests_ran,
+	                                 .failed_tests = result->tests_failed - tests_failed,
+	                                 .wall_time = elapsed_time,
+	                                 .cpu_time = usage.cpu_time,
+	                                 .cached_tests = options->cached_tests,
+	                             });
 }
 
-static void run_test_suite(struct cutest_test_suite test_suite[static 1], struct result result[static 1]) {
+static void run_test_suite(struct cutest_test_suite test_suite[static 1],
+                           struct options options[static 1],
+                           struct result result[static 1]) {
 	size_t suite_tests_ran = 0;
-	printf("[----------] %zu tests from %s\n", test_suite->enabled_tests, test_suite->name);
-	clock_t suite_start_time = clock();
+	size_t suite_tests_failed = 0;
+	struct usage suite_usage = {};
+	cutest_listeners_suite_start(test_suite);
+	trace_suite(test_suite, CUTEST_TRACE_ASYNC_BEGIN, cutest_clock_now());
+	// Without an environment no test runs, nor do the suite hooks.
+	const struct cutest_fixture *fixture = !result->environment_failed ? suite_fixture(test_suite) : nullptr;
+	if (fixture != nullptr && !cutest_fixture_set_up_suite(fixture)) {
+		fail_suite(test_suite);
+	}
 	for (size_t i = 0; i < test_suite->size; i++) {
 		if (!test_suite->test[i].enabled) {
 			continue;
 		}
-		run_test(&test_suite->test[i], test_suite->name);
-		test_suite->test[i].result ? result->tests_passed++ : result->tests_failed++;
-		suite_tests_ran++;
+		struct test_iterator iterator = {.test = &test_suite->test[i]};
+		for (struct cutest_test *test; (test = next_test(&iterator, test_suite->name, options)) != nullptr;) {
+			double median_time;
+			struct usage usage = run_test(test, test_suite, options, &median_time);
+			usage_accumulate(&suite_usage, usage);
+			record_timing(test, test_suite->name, options, median_time, result);
+			record_repeat(test_suite->name, test->name, test->result, usage.wall_time, options, result);
+			record_cache(test_suite->name, test->name, test->result, options);
+			test->result ? result->tests_passed++ : result->tests_failed++;
+			suite_tests_failed += !test->result;
+			suite_tests_ran++;
+		}
 	}
-	clock_t suite_end_time = clock();
-	double elapsed_time = ((double) (suite_end_time - suite_start_time)) / CLOCKS_PER_SEC * 1000;
-	printf("[----------] %zu tests from %s (%.2f ms total)\n", suite_tests_ran, test_suite->name, elapsed_time);
+	if (fixture != nullptr && !cutest_fixture_tear_down_suite(fixture)) {
+		result->hooks_failed = true;
+	}
+	trace_suite(test_suite, CUTEST_TRACE_ASYNC_END, cutest_clock_now());
+	cutest_trace_flush();
+	cutest_listeners_suite_end(test_suite,
+	                           &(struct cutest_result) {
+	                               .tests = suite_tests_ran,
+	                               .failed_tests = suite_tests_failed,
+	                               .wall_time = suite_usage.wall_time,
+	                               .cpu_time = suite_usage.cpu_time,
+	                           });
+	usage_accumulate(&result->usage, suite_usage);
 	result->tests_ran += suite_tests_ran;
-	result->suites_run++;
 }
 
-static void run_test(struct cutest_test test[static 1], const char test_suite_name[static 1]) {
-	double elapsed_time;
-	printf("[ RUN      ] %s.%s\n", test_suite_name, test->name);
-	clock_t start_time = clock();
+static struct usage run_test(struct cutest_test test[static 1],
+                             struct cutest_test_suite test_suite[static 1],
+                             struct options options[static 1],
+                             double median_time[static 1]) {
+	const char *test_suite_name = test_suite->name;
+	cutest_listeners_test_start(test_suite, test);
+	uint64_t start_time = cutest_clock_now();
+	bool report = options->report.format != CUTEST_REPORT_NONE;
+	struct cutest_failures failures = {};
+	struct cutest_failures *previous_failures = cutest_failure_capture(report ? &failures : nullptr);
+	struct usage start_usage = usage_sample(options);
+	struct cutest_test *previous_test = cutest_test_set_current(test);
+	struct cutest_alloc_stats alloc = {};
+	*median_time = 0;
+	if (!test->result) {
+		if (!cutest_failures_add(&failures, test->file, test->line, "Not run, the set-up of its suite or environment failed.")) {
+			perror(strerror(errno));
+			exit(1);
+		}
+	}
+	else if (test->benchmark != nullptr) {
+		run_benchmark(test, test_suite_name, options, &failures);
+	}
+	else {
+		*median_time = run_test_repeated(test, test_suite_name, options, &alloc);
+	}
+	cutest_test_set_current(previous_test);
+	cutest_failure_capture(previous_failures);
+	struct usage usage = usage_delta(start_usage, usage_sample(options));
+	if (options->baseline_in != nullptr && test->benchmark == nullptr && test->result) {
+		check_baseline(test, test_suite_name, options, *median_time, &failures);
+	}
+	uint64_t end_time = cutest_clock_now();
+	cutest_trace_record(&(struct cutest_trace_event) {
+		.phase = CUTEST_TRACE_COMPLETE,
+		.category = "test",
+		.suite_name = test_suite_name,
+		.name = test->name,
+		.time = start_time,
+		.duration = end_time - start_time,
+	});
+	cutest_listeners_test_end(test_suite,
+	                          test,
+	                          &(struct cutest_result) {
+	                              .tests = 1,
+	                              .failed_tests = !test->result,
+	                              .wall_time = usage.wall_time,
+	                              .cpu_time = usage.cpu_time,
+	                          });
+	if (options->resource_usage) {
+		print_usage("USAGE", test_suite_name, test->name, usage);
+	}
+	if (options->track_alloc && test->benchmark == nullptr) {
+		print_alloc(test_suite_name, test->name, alloc);
+	}
+	if (report) {
+		report_test(test, test_suite_name, options, test->result, usage, &failures);
+	}
+	cutest_failures_destroy(&failures);
+	cutest_trace_flush();
+	return usage;
+}
+
+/*
+ * When recording or checking a baseline the test runs several times, stopping
+ * at the first failure, to smooth out the noise. Returns the median wall time
+ * of the repetitions in milliseconds, and the allocations of the first one in
+ * alloc.
+ */
+static double run_test_repeated(struct cutest_test test[static 1],
+                                const char test_suite_name[static 1],
+                                struct options options[static 1],
+                                struct cutest_alloc_stats alloc[static 1]) {
+	bool baseline = options->baseline_in != nullptr || options->baseline_out != nullptr;
+	size_t repetitions = baseline ? options->baseline_repetitions : 1;
+	// A single repetition, the common case, needs no allocation.
+	double single_time;
+	double *time = (repetitions == 1) ? &single_time : malloc(repetitions * sizeof *time);
+	if (time == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t i = 0;
+	while (i < repetitions && (i == 0 || test->result)) {
+		struct cutest_alloc_stats alloc_start = cutest_alloc_sample();
+		uint64_t start_time = cutest_clock_now();
+		if (i == 0 && options->perf_counters != 0) {
+			run_test_perf_counters(test, test_suite_name, options);
+		}
+		else {
+			test->execute();
+		}
+		time[i] = (double) (cutest_clock_now() - start_time) / 1e6;
+		if (i++ == 0) {
+			*alloc = cutest_alloc_delta(alloc_start, cutest_alloc_sample());
+		}
+	}
+	qsort(time, i, sizeof *time, time_compare);
+	double median_time = (i % 2) ? time[i / 2] : (time[i / 2 - 1] + time[i / 2]) / 2;
+	if (time != &single_time) {
+		free(time);
+	}
+	return median_time;
+}
+
+static void run_benchmark(struct cutest_test test[static 1],
+                          const char test_suite_name[static 1],
+                          struct options options[static 1],
+                          struct cutest_failures failures[static 1]) {
+	struct cutest_benchmark_result benchmark;
+	if (!cutest_benchmark_measure(test, options->benchmark_min_time, options->benchmark_repetitions, &benchmark)) {
+		if (test->result) {
+			print("Benchmark %s.%s did not complete a cutest_benchmark_loop().\n", test_suite_name, test->name);
+			test->result = false;
+			if (!cutest_failures_add(failures, test->file, test->line, "Benchmark did not complete a cutest_benchmark_loop().")) {
+				perror(strerror(errno));
+				exit(1);
+			}
+		}
+		return;
+	}
+	print("[    BENCH ] %s.%s %.2f ns/op (min %.2f, median %.2f, p99 %.2f ns/op)",
+	      test_suite_name,
+	      test->name,
+	      benchmark.median_time,
+	      benchmark.min_time,
+	      benchmark.median_time,
+	      benchmark.p99_time);
+	if (benchmark.bytes_per_second > 0) {
+		static const char *const unit[] = {"B/s", "KiB/s", "MiB/s", "GiB/s", "TiB/s"};
+		double rate = benchmark.bytes_per_second;
+		size_t i = 0;
+		for (; rate >= 1024 && i < sizeof unit / sizeof *unit - 1; i++) {
+			rate /= 1024;
+		}
+		print(" %.2f %s", rate, unit[i]);
+	}
+	if (benchmark.items_per_second > 0) {
+		static const char *const unit[] = {"", "k", "M", "G", "T"};
+		double rate = benchmark.items_per_second;
+		size_t i = 0;
+		for (; rate >= 1000 && i < sizeof unit / sizeof *unit - 1; i++) {
+			rate /= 1000;
+		}
+		print(" %.2f %sitems/s", rate, unit[i]);
+	}
+	print(" [%zu iterations x %zu repetitions]\n", benchmark.iterations, benchmark.repetitions);
+}
+
+/*
+ * Fuzz the test named by --cutest_fuzz, between the set-up and the tear-down of
+ * the global environments. The seed defaults to the clock, and is printed so
+ * that the run can be reproduced.
+ */
+static int run_fuzz(struct cutest cutest[static 1], struct options options[static 1]) {
+	const char *separator = strchr(options->fuzz, '.');
+	size_t suite_length = (separator != nullptr) ? (size_t) (separator - options->fuzz) : 0;
+	struct cutest_test_suite *suite = nullptr;
+	struct cutest_test *test = nullptr;
+	for (size_t i = 0; separator != nullptr && test == nullptr && i < cutest->size; i++) {
+		suite = &cutest->suite[i];
+		if (strncmp(suite->name, options->fuzz, suite_length) != 0 || suite->name[suite_length] != '\0') {
+			continue;
+		}
+		for (size_t j = 0; test == nullptr && j < suite->size; j++) {
+			test = (strcmp(suite->test[j].name, separator + 1) == 0) ? &suite->test[j] : nullptr;
+		}
+	}
+	if (test == nullptr || test->fuzz == nullptr) {
+		fprintf(stderr, "No fuzz test named %s.\n", options->fuzz);
+		return EXIT_FAILURE;
+	}
+	if (options->fuzz_options.seed == 0) {
+		options->fuzz_options.seed = cutest_clock_now() | 1;
+	}
+	bool result = cutest_environments_set_up() && cutest_fuzz_run(test, suite->name, &options->fuzz_options);
+	result = cutest_environments_tear_down() && result;
+	return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void run_test_perf_counters(struct cutest_test test[static 1],
+                                   const char test_suite_name[static 1],
+                                   struct options options[static 1]) {
+	static atomic_flag fallback_reported = ATOMIC_FLAG_INIT;
+	struct cutest_perf_counters counters;
+	uint64_t count[CUTEST_PERF_EVENTS];
+	if (!cutest_perf_open(&counters, options->perf_counters)) {
+		if (!atomic_flag_test_and_set(&fallback_reported)) {
+			print("Performance counters are not available on this system.\n");
+		}
+		test->execute();
+		return;
+	}
+	if (counters.hardware_unavailable && !atomic_flag_test_and_set(&fallback_reported)) {
+		print("Hardware performance counters are not available, falling back to software events.\n");
+	}
+	cutest_perf_start(&counters);
 	test->execute();
-	clock_t end_time = clock();
-	elapsed_time = ((double) (end_time - start_time)) / CLOCKS_PER_SEC * 1000;
-	printf(test->result ? "[       OK ]" : "[  FAILED  ]");
-	printf(" %s.%s (%.2f ms)\n", test_suite_name, test->name, elapsed_time);
+	if (!cutest_perf_stop(&counters, count)) {
+		cutest_perf_close(&counters);
+		return;
+	}
+	print("[     PERF ] %s.%s", test_suite_name, test->name);
+	for (size_t i = 0; i < counters.size; i++) {
+		enum cutest_perf_event event = counters.event[i];
+		if (event == CUTEST_PERF_TASK_CLOCK) {
+			print(" %s=%.3f ms", cutest_perf_event_name(event), (double) count[event] / 1e6);
+		}
+		else {
+			print(" %s=%" PRIu64, cutest_perf_event_name(event), count[event]);
+		}
+	}
+	print("\n");
+	cutest_perf_close(&counters);
+}
+
+/*
+ * Tests faster than the minimum time both in the baseline and in this run are
+ * dominated by noise and never reported.
+ */
+static void check_baseline(struct cutest_test test[static 1],
+                           const char test_suite_name[static 1],
+                           struct options options[static 1],
+                           double median_time,
+                           struct cutest_failures failures[static 1]) {
+	const struct cutest_baseline_entry *entry = cutest_baseline_find(&options->baseline, test_suite_name, test->name);
+	if (entry == nullptr || (entry->time < options->baseline_min_time && median_time < options->baseline_min_time)) {
+		return;
+	}
+	if (median_time <= entry->time * (1 + options->max_slowdown)) {
+		return;
+	}
+	print("[ SLOWDOWN ] %s.%s median %.3f ms, baseline %.3f ms (limit +%.0f%%)\n",
+	      test_suite_name,
+	      test->name,
+	      median_time,
+	      entry->time,
+	      options->max_slowdown * 100);
+	if (!options->baseline_warn_only) {
+		test->result = false;
+		if (!cutest_failures_add(failures,
+		                         test->file,
+		                         test->line,
+		                         "Median %.3f ms, baseline %.3f ms (limit +%.0f%%)",
+		                         median_time,
+		                         entry->time,
+		                         options->max_slowdown * 100)) {
+			perror(strerror(errno));
+			exit(1);
+		}
+	}
+}
+
+static void record_timing(struct cutest_test test[static 1],
+                          const char test_suite_name[static 1],
+                          struct options options[static 1],
+                          double median_time,
+                          struct result result[static 1]) {
+	if (options->baseline_out == nullptr || test->benchmark != nullptr || !test->result || options->iteration > 0) {
+		return;
+	}
+	const char *test_name = test->name;
+	if (test->parameters != nullptr) {
+		if (result->case_names_size == result->case_names_capacity) {
+			size_t capacity = result->case_names_capacity ? result->case_names_capacity * 2 : 64;
+			char **ptr = realloc(result->case_names, capacity * sizeof *ptr);
+			if (ptr == nullptr) {
+				perror(strerror(errno));
+				exit(1);
+			}
+			result->case_names = ptr;
+			result->case_names_capacity = capacity;
+		}
+		result->case_names[result->case_names_size] = strdup(test->name);
+		if (result->case_names[result->case_names_size] == nullptr) {
+			perror(strerror(errno));
+			exit(1);
+		}
+		test_name = result->case_names[result->case_names_size++];
+	}
+	if (!cutest_baseline_add(&result->timings, test_suite_name, test_name, median_time)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
+static void record_repeat(const char test_suite_name[static 1],
+                          const char test_name[static 1],
+                          bool passed,
+                          double time,
+                          struct options options[static 1],
+                          struct result result[static 1]) {
+	if (options->repeat == 1) {
+		return;
+	}
+	struct repeat_entry *entry;
+	if (options->iteration == 0) {
+		if (result->repeats_size == result->repeats_capacity) {
+			size_t capacity = result->repeats_capacity ? result->repeats_capacity * 2 : 64;
+			struct repeat_entry *ptr = realloc(result->repeats, capacity * sizeof *ptr);
+			if (ptr == nullptr) {
+				perror(strerror(errno));
+				exit(1);
+			}
+			result->repeats = ptr;
+			result->repeats_capacity = capacity;
+		}
+		entry = &result->repeats[result->repeats_size++];
+		*entry = (struct repeat_entry) {
+			.suite_name = test_suite_name,
+			.test_name = strdup(test_name),
+			.min_time = time,
+			.max_time = time,
+		};
+		if (entry->test_name == nullptr) {
+			perror(strerror(errno));
+			exit(1);
+		}
+	}
+	else {
+		struct repeat_entry key = {.suite_name = test_suite_name, .test_name = (char *) test_name};
+		entry = bsearch(&key, result->repeats, result->repeats_size, sizeof *result->repeats, repeat_entry_compare);
+		if (entry == nullptr) {
+			return;
+		}
+	}
+	entry->runs++;
+	entry->failures += !passed;
+	entry->total_time += time;
+	entry->min_time = (time < entry->min_time) ? time : entry->min_time;
+	entry->max_time = (time > entry->max_time) ? time : entry->max_time;
+}
+
+static int repeat_entry_compare(const void *lhs, const void *rhs) {
+	const struct repeat_entry *lhs_entry = lhs;
+	const struct repeat_entry *rhs_entry = rhs;
+	int comparison = strcmp(lhs_entry->suite_name, rhs_entry->suite_name);
+	return (comparison != 0) ? comparison : strcmp(lhs_entry->test_name, rhs_entry->test_name);
+}
+
+static void print_repeats(const struct result result[static 1]) {
+	for (size_t i = 0; i < result->repeats_size; i++) {
+		const struct repeat_entry *entry = &result->repeats[i];
+		print("[   REPEAT ] %s.%s %zu runs, %zu failed, min %.3f ms, mean %.3f ms, max %.3f ms\n",
+		      entry->suite_name,
+		      entry->test_name,
+		      entry->runs,
+		      entry->failures,
+		      entry->min_time,
+		      entry->total_time / (double) entry->runs,
+		      entry->max_time);
+	}
+}
+
+/*
+ * Shuffle the suites, then the tests of each suite, starting from their
+ * registration order.
+ */
+static void shuffle_tests(struct cutest cutest[static 1], struct registration_order order[static 1], uint32_t seed) {
+	if (order->suite == nullptr) {
+		order->size = cutest->size;
+		order->suite = malloc(cutest->size * sizeof *order->suite);
+		order->test = calloc(cutest->size, sizeof *order->test);
+		if ((order->suite == nullptr || order->test == nullptr) && cutest->size > 0) {
+			perror(strerror(errno));
+			exit(1);
+		}
+		memcpy(order->suite, cutest->suite, cutest->size * sizeof *cutest->suite);
+		for (size_t i = 0; i < cutest->size; i++) {
+			size_t size = cutest->suite[i].size * sizeof *cutest->suite[i].test;
+			order->test[i] = malloc(size);
+			if (order->test[i] == nullptr && size > 0) {
+				perror(strerror(errno));
+				exit(1);
+			}
+			memcpy(order->test[i], cutest->suite[i].test, size);
+		}
+	}
+	else {
+		memcpy(cutest->suite, order->suite, order->size * sizeof *cutest->suite);
+		for (size_t i = 0; i < order->size; i++) {
+			memcpy(cutest->suite[i].test, order->test[i], cutest->suite[i].size * sizeof *cutest->suite[i].test);
+		}
+	}
+	uint64_t state = seed;
+	for (size_t i = cutest->size; i > 1; i--) {
+		size_t j = random_next(&state, i);
+		struct cutest_test_suite suite = cutest->suite[i - 1];
+		cutest->suite[i - 1] = cutest->suite[j];
+		cutest->suite[j] = suite;
+	}
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test *test = cutest->suite[i].test;
+		for (size_t j = cutest->suite[i].size; j > 1; j--) {
+			size_t k = random_next(&state, j);
+			struct cutest_test swap = test[j - 1];
+			test[j - 1] = test[k];
+			test[k] = swap;
+		}
+	}
+}
+
+static void registration_order_destroy(struct registration_order order[static 1]) {
+	for (size_t i = 0; order->test != nullptr && i < order->size; i++) {
+		free(order->test[i]);
+	}
+	free(order->test);
+	free(order->suite);
 }
 
-static void filter_tests(struct cutest cutest[static 1], size_t n, const char filter[static n]) {
-	size_t suite_name_length;
-	char *dot_ptr = memchr(filter, '.', n);
-	suite_name_length = (dot_ptr == nullptr) ? n - 1 : (size_t) (dot_ptr - filter);
-	suite_name_length = (suite_name_length > n) ? n - 1 : suite_name_length;
+/*
+ * SplitMix64, which is all the shuffling needs and gives the same orders on
+ * every platform.
+ */
+static size_t random_next(uint64_t state[static 1], size_t range) {
+	uint64_t z = (*state += 0x9e3779b97f4a7c15);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+	return (size_t) ((z ^ (z >> 31)) % range);
+}
+
+static void result_destroy(struct result result[static 1]) {
+	for (size_t i = 0; i < result->repeats_size; i++) {
+		free(result->repeats[i].test_name);
+	}
+	free(result->repeats);
+	for (size_t i = 0; i < result->case_names_size; i++) {
+		free(result->case_names[i]);
+	}
+	free(result->case_names);
+	cutest_baseline_destroy(&result->timings);
+}
+
+static int time_compare(const void *lhs, const void *rhs) {
+	double lhs_time = *(const double *) lhs;
+	double rhs_time = *(const double *) rhs;
+	return (lhs_time > rhs_time) - (lhs_time < rhs_time);
+}
+
+static void report_test(struct cutest_test test[static 1],
+                        const char test_suite_name[static 1],
+                        struct options options[static 1],
+                        bool result,
+                        struct usage usage,
+                        const struct cutest_failures failures[static 1]) {
+	cutest_report_test(&options->report,
+	                   &(struct cutest_report_record) {
+	                       .suite_name = test_suite_name,
+	                       .test = test,
+	                       .result = result,
+	                       .wall_time = usage.wall_time,
+	                       .cpu_time = usage.cpu_time,
+	                       .failures = failures,
+	                   });
+}
+
+/*
+ * Report a test that did not get to report itself, such as one whose process
+ * died, as failed for the given reason.
+ */
+static void report_test_failure(struct cutest_test test[static 1],
+                                const char test_suite_name[static 1],
+                                struct options options[static 1],
+                                struct usage usage,
+                                const char *format,
+                                ...) {
+	if (options->report.format == CUTEST_REPORT_NONE) {
+		return;
+	}
+	struct cutest_failures failures = {};
+	va_list args;
+	va_start(args, format);
+	bool added = cutest_failures_vadd(&failures, nullptr, 0, format, args);
+	va_end(args);
+	if (!added) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	report_test(test, test_suite_name, options, false, usage, &failures);
+	cutest_failures_destroy(&failures);
+}
+
+/*
+ * Suites are asynchronous spans, as in parallel runs they overlap on the
+ * threads of the workers.
+ */
+static void trace_suite(struct cutest_test_suite test_suite[static 1], enum cutest_trace_phase phase, uint64_t time) {
+	cutest_trace_record(&(struct cutest_trace_event) {
+		.phase = phase,
+		.category = "suite",
+		.name = test_suite->name,
+		.time = time,
+		.id = (uint64_t) (uintptr_t) test_suite,
+	});
+}
+
+/*
+ * The fixture of a suite is the one of its TEST_F() tests.
+ */
+static const struct cutest_fixture *suite_fixture(const struct cutest_test_suite test_suite[static 1]) {
+	for (size_t i = 0; i < test_suite->size; i++) {
+		if (test_suite->test[i].fixture != nullptr) {
+			return test_suite->test[i].fixture;
+		}
+	}
+	return nullptr;
+}
+
+/*
+ * Fail the enabled tests of a suite whose set-up failed, so that they are
+ * reported without running.
+ */
+static void fail_suite(struct cutest_test_suite test_suite[static 1]) {
+	for (size_t i = 0; i < test_suite->size; i++) {
+		if (test_suite->test[i].enabled) {
+			test_suite->test[i].result = false;
+		}
+	}
+}
+
+/*
+ * Benchmarks only run with --cutest_benchmark, which in turn skips the tests.
+ */
+static void select_tests(struct cutest cutest[static 1], bool benchmarks) {
 	for (size_t i = 0; i < cutest->size; i++) {
 		struct cutest_test_suite *suite = &cutest->suite[i];
-		if (strncmp(suite->name, filter, suite_name_length) != 0 || strlen(suite->name) != suite_name_length) {
-			suite->enabled = false;
-			cutest->enabled_tests -= suite->size;
-			cutest->enabled_suites--;
+		for (size_t j = 0; j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if ((test->benchmark != nullptr) != benchmarks || test->cases == 0) {
+				disable_test(cutest, suite, test);
+			}
+		}
+	}
+}
+
+/*
+ * The filter is compiled once, then every test is matched against it in a
+ * single pass over the registered tests. The compiled filter is kept for the
+ * cases of the parameterized tests, which are matched whenever they are
+ * enumerated.
+ */
+static void filter_tests(struct cutest cutest[static 1], struct options options[static 1]) {
+	if (!cutest_filter_compile(&options->compiled_filter, options->filter)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		for (size_t j = 0; suite->enabled && j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if (!test->enabled) {
+				continue;
+			}
+			if (test->parameters != nullptr) {
+				select_cases(cutest, suite, test, options);
+			}
+			else if (!cutest_filter_match(&options->compiled_filter, suite->name, test->name)) {
+				disable_test(cutest, suite, test);
+			}
+		}
+	}
+}
+
+/*
+ * Keep the enabled tests of this shard only. Without a cost file the tests are
+ * dealt to the shards in registration order, so that every shard computes the
+ * same partition. The cases of a parameterized test are always dealt in order,
+ * starting from the first shard.
+ */
+static void shard_tests(struct cutest cutest[static 1], struct options options[static 1]) {
+	options->shard_cases = true;
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		for (size_t j = 0; suite->enabled && j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if (test->enabled && test->parameters != nullptr) {
+				select_cases(cutest, suite, test, options);
+			}
+		}
+	}
+	if (options->shard_cost_file != nullptr) {
+		shard_tests_balanced(cutest, options);
+		return;
+	}
+	size_t position = 0;
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		for (size_t j = 0; suite->enabled && j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if (test->enabled && test->parameters == nullptr
+			    && position++ % options->total_shards != options->shard_index) {
+				disable_test(cutest, suite, test);
+			}
+		}
+	}
+}
+
+struct shard_entry {
+	struct cutest_test_suite *suite;
+	struct cutest_test *test;
+	double cost;
+	size_t position;
+};
+
+/*
+ * Assign the tests, most expensive first, to the shard with the lowest total
+ * cost so far. Costs are the times in the cost file, a baseline written by
+ * --cutest_baseline_out; tests missing from it cost as much as the average
+ * test that is listed.
+ */
+static void shard_tests_balanced(struct cutest cutest[static 1], struct options options[static 1]) {
+	struct shard_entry *entry = malloc(cutest->enabled_tests * sizeof *entry);
+	double *shard_cost = calloc(options->total_shards, sizeof *shard_cost);
+	if ((entry == nullptr && cutest->enabled_tests != 0) || shard_cost == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t size = 0;
+	size_t known_tests = 0;
+	double known_cost = 0;
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		for (size_t j = 0; suite->enabled && j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if (!test->enabled || test->parameters != nullptr) {
+				continue;
+			}
+			const struct cutest_baseline_entry *cost = cutest_baseline_find(&options->shard_costs, suite->name, test->name);
+			entry[size] = (struct shard_entry) {
+				.suite = suite,
+				.test = test,
+				.cost = (cost != nullptr) ? cost->time : -1,
+				.position = size,
+			};
+			if (cost != nullptr) {
+				known_tests++;
+				known_cost += cost->time;
+			}
+			size++;
+		}
+	}
+	double default_cost = (known_tests != 0) ? known_cost / (double) known_tests : 1;
+	for (size_t i = 0; i < size; i++) {
+		entry[i].cost = (entry[i].cost < 0) ? default_cost : entry[i].cost;
+	}
+	qsort(entry, size, sizeof *entry, shard_entry_compare);
+	for (size_t i = 0; i < size; i++) {
+		size_t shard = 0;
+		for (size_t j = 1; j < options->total_shards; j++) {
+			shard = (shard_cost[j] < shard_cost[shard]) ? j : shard;
+		}
+		shard_cost[shard] += entry[i].cost;
+		if (shard != options->shard_index) {
+			disable_test(cutest, entry[i].suite, entry[i].test);
+		}
+	}
+	free(shard_cost);
+	free(entry);
+}
+
+static int shard_entry_compare(const void *lhs, const void *rhs) {
+	const struct shard_entry *lhs_entry = lhs;
+	const struct shard_entry *rhs_entry = rhs;
+	if (lhs_entry->cost != rhs_entry->cost) {
+		return (lhs_entry->cost < rhs_entry->cost) ? 1 : -1;
+	}
+	return (lhs_entry->position > rhs_entry->position) - (lhs_entry->position < rhs_entry->position);
+}
+
+/*
+ * Count the cases of a parameterized test that remain selected, disabling the
+ * test when none does.
+ */
+static void select_cases(struct cutest cutest[static 1],
+                         struct cutest_test_suite suite[static 1],
+                         struct cutest_test test[static 1],
+                         struct options options[static 1]) {
+	size_t cases = 0;
+	struct test_iterator iterator = {.test = test};
+	while (next_test(&iterator, suite->name, options) != nullptr) {
+		cases++;
+	}
+	if (cases == 0) {
+		disable_test(cutest, suite, test);
+		return;
+	}
+	suite->enabled_tests -= test->cases - cases;
+	cutest->enabled_tests -= test->cases - cases;
+	test->cases = cases;
+}
+
+static void disable_test(struct cutest cutest[static 1],
+                         struct cutest_test_suite suite[static 1],
+                         struct cutest_test test[static 1]) {
+	test->enabled = false;
+	suite->enabled_tests -= test->cases;
+	cutest->enabled_tests -= test->cases;
+	if (suite->enabled_tests == 0 && suite->enabled) {
+		suite->enabled = false;
+		cutest->enabled_suites--;
+	}
+}
+
+/*
+ * Skip the tests that passed in a previous run of the same build, except those
+ * selected by --cutest_no_cache. A parameterized test is skipped only when all
+ * of its selected cases are cached.
+ */
+static void skip_cached_tests(struct cutest cutest[static 1], struct options options[static 1]) {
+	if (options->no_cache != nullptr && !cutest_filter_compile(&options->compiled_no_cache, options->no_cache)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		for (size_t j = 0; suite->enabled && j < suite->size; j++) {
+			struct cutest_test *test = &suite->test[j];
+			if (!test->enabled || !is_cached(suite, test, options)) {
+				continue;
+			}
+			struct test_iterator iterator = {.test = test};
+			for (struct cutest_test *test_case; (test_case = next_test(&iterator, suite->name, options)) != nullptr;) {
+				printf("[  CACHED  ] %s.%s\n", suite->name, test_case->name);
+			}
+			options->cached_tests += test->cases;
+			disable_test(cutest, suite, test);
+		}
+	}
+	// cutest_discover_tests reports the run as skipped on this note.
+	if (cutest->enabled_tests == 0 && options->cached_tests > 0) {
+		printf("Note: Every selected test passed in a previous run.\n");
+	}
+}
+
+static bool is_cached(struct cutest_test_suite suite[static 1], struct cutest_test test[static 1], struct options options[static 1]) {
+	bool cached = true;
+	struct test_iterator iterator = {.test = test};
+	for (struct cutest_test *test_case; cached && (test_case = next_test(&iterator, suite->name, options)) != nullptr;) {
+		cached = (options->no_cache == nullptr
+		          || !cutest_filter_match(&options->compiled_no_cache, suite->name, test_case->name))
+		         && cutest_cache_contains(&options->cache, suite->name, test_case->name);
+	}
+	cutest_buffer_destroy(&iterator.name);
+	return cached;
+}
+
+/*
+ * A test stays cached only while it passes every iteration that runs it. When
+ * the cache cannot be written the run goes on without it.
+ */
+static void record_cache(const char test_suite_name[static 1],
+                         const char test_name[static 1],
+                         bool passed,
+                         struct options options[static 1]) {
+	if (options->cache_dir == nullptr || (passed && options->iteration > 0)) {
+		return;
+	}
+	if (!cutest_cache_update(&options->cache, test_suite_name, test_name, passed)) {
+		fprintf(stderr, "Could not write the cache %s: %s\n", options->cache_dir, strerror(errno));
+		cutest_cache_destroy(&options->cache);
+		options->cache_dir = nullptr;
+	}
+}
+
+static void run_tests_parallel(struct cutest cutest[static 1], struct options options[static 1], struct result result[static 1]) {
+	// The suites are set up at once before the workers start, which see their
+	// state as threads or as forked processes, and before the jobs copy the
+	// cases of the parameterized tests.
+	for (size_t i = 0; i < cutest->size && !result->environment_failed; i++) {
+		const struct cutest_fixture *fixture = suite_fixture(&cutest->suite[i]);
+		if (cutest->suite[i].enabled && fixture != nullptr && !cutest_fixture_set_up_suite(fixture)) {
+			fail_suite(&cutest->suite[i]);
+		}
+	}
+	struct job_queue *queue = job_queue_create(cutest, options);
+	if (queue == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t jobs = options->benchmark ? 1 : options->jobs;
+	size_t workers = (jobs < queue->size) ? jobs : queue->size;
+	bool started;
+#ifdef HAS_FORK
+	if (queue->options->jobs_backend == JOBS_BACKEND_PROCESSES) {
+		started = run_workers_processes(queue, workers);
+	}
+	else {
+		started = run_workers_threads(queue, workers);
+	}
+#else
+	started = run_workers_threads(queue, workers);
+#endif
+	if (!started) {
+		run_jobs(queue);
+	}
+	for (size_t i = 0; i < queue->size;) {
+		struct cutest_test_suite *suite = queue->job[i].suite;
+		size_t suite_tests_ran = 0;
+		size_t suite_tests_failed = 0;
+		struct usage suite_usage = {};
+		uint64_t suite_start_time = UINT64_MAX;
+		uint64_t suite_end_time = 0;
+		cutest_listeners_suite_start(suite);
+		for (; i < queue->size && queue->job[i].suite == suite; i++) {
+			struct job *job = &queue->job[i];
+			if (job->state != JOB_DONE) {
+				job->result = false;
+				printf("[  FAILED  ] %s.%s (worker terminated before the test completed)\n", suite->name, job->test->name);
+				report_test_failure(job->test,
+				                    suite->name,
+				                    options,
+				                    job->usage,
+				                    "Worker terminated before the test completed.");
+			}
+			job->test->result = job->result;
+			record_timing(job->test, suite->name, options, job->median_time, result);
+			record_repeat(suite->name, job->test->name, job->result, job->usage.wall_time, options, result);
+			record_cache(suite->name, job->test->name, job->result, options);
+			job->result ? result->tests_passed++ : result->tests_failed++;
+			suite_tests_failed += !job->result;
+			usage_accumulate(&suite_usage, job->usage);
+			suite_tests_ran++;
+			if (job->state != JOB_PENDING) {
+				suite_start_time = (job->start_time < suite_start_time) ? job->start_time : suite_start_time;
+				suite_end_time = (job->end_time > suite_end_time) ? job->end_time : suite_end_time;
+			}
+		}
+		if (suite_start_time <= suite_end_time) {
+			trace_suite(suite, CUTEST_TRACE_ASYNC_BEGIN, suite_start_time);
+			trace_suite(suite, CUTEST_TRACE_ASYNC_END, suite_end_time);
+			cutest_trace_flush();
+		}
+		cutest_listeners_suite_end(suite,
+		                           &(struct cutest_result) {
+		                               .tests = suite_tests_ran,
+		                               .failed_tests = suite_tests_failed,
+		                               .wall_time = suite_usage.wall_time,
+		                               .cpu_time = suite_usage.cpu_time,
+		                           });
+		usage_accumulate(&result->usage, suite_usage);
+		result->tests_ran += suite_tests_ran;
+	}
+	for (size_t i = 0; i < cutest->size && !result->environment_failed; i++) {
+		const struct cutest_fixture *fixture = suite_fixture(&cutest->suite[i]);
+		if (cutest->suite[i].enabled && fixture != nullptr && !cutest_fixture_tear_down_suite(fixture)) {
+			result->hooks_failed = true;
+		}
+	}
+	job_queue_destroy(queue);
+}
+
+static struct job_queue *job_queue_create(struct cutest cutest[static 1], struct options options[static 1]) {
+	size_t size = sizeof(struct job_queue) + cutest->enabled_tests * sizeof(struct job);
+	struct job_queue *queue;
+#ifdef HAS_FORK
+	if (options->jobs_backend == JOBS_BACKEND_PROCESSES) {
+		queue = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		if (queue == MAP_FAILED) {
+			return nullptr;
+		}
+	}
+	else {
+		queue = malloc(size);
+	}
+#else
+	queue = malloc(size);
+#endif
+	if (queue == nullptr) {
+		return nullptr;
+	}
+	*queue = (struct job_queue) {
+		.capacity = cutest->enabled_tests,
+		.size = 0,
+		.job = (struct job *) (queue + 1),
+		.options = options,
+	};
+	atomic_init(&queue->next, 0);
+	mtx_init(&queue->thread_lock, mtx_plain);
+#ifdef HAS_FORK
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&queue->process_lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+#endif
+	for (size_t i = 0; i < cutest->size; i++) {
+		struct cutest_test_suite *suite = &cutest->suite[i];
+		if (!suite->enabled) {
 			continue;
 		}
-		const char *required_test = (dot_ptr == nullptr) ? &filter[n - 1] : dot_ptr + 1;
 		for (size_t j = 0; j < suite->size; j++) {
-			struct cutest_test *test = &suite->test[j];
-			if (strcmp(test->name, required_test) != 0) {
-				test->enabled = false;
-				suite->enabled_tests--;
-				cutest->enabled_tests--;
+			if (!suite->test[j].enabled) {
+				continue;
+			}
+			struct test_iterator iterator = {.test = &suite->test[j]};
+			for (struct cutest_test *test; (test = next_test(&iterator, suite->name, options)) != nullptr;) {
+				struct job *job = &queue->job[queue->size++];
+				*job = (struct job) {
+					.suite = suite,
+					.test = test,
+					.state = JOB_PENDING,
+				};
+				if (test != &suite->test[j]) {
+					job->test_case = *test;
+					job->test_case.name = strdup(test->name);
+					job->test = &job->test_case;
+					if (job->test_case.name == nullptr) {
+						perror(strerror(errno));
+						exit(1);
+					}
+				}
+			}
+		}
+	}
+	return queue;
+}
+
+static void job_queue_destroy(struct job_queue queue[static 1]) {
+	for (size_t i = 0; i < queue->size; i++) {
+		if (queue->job[i].test == &queue->job[i].test_case) {
+			free((char *) queue->job[i].test_case.name);
+		}
+	}
+	mtx_destroy(&queue->thread_lock);
+#ifdef HAS_FORK
+	pthread_mutex_destroy(&queue->process_lock);
+	if (queue->options->jobs_backend == JOBS_BACKEND_PROCESSES) {
+		munmap(queue, sizeof(struct job_queue) + queue->capacity * sizeof(struct job));
+		return;
+	}
+#endif
+	free(queue);
+}
+
+/*
+ * Worker loop shared by both backends: every test reports into a private
+ * buffer which is written out whole, so lines from concurrent tests never mix.
+ */
+static void run_jobs(struct job_queue queue[static 1]) {
+	struct cutest_buffer output = {};
+	struct cutest_buffer *previous_output = cutest_output_capture(&output);
+	for (size_t i; (i = atomic_fetch_add(&queue->next, 1)) < queue->size;) {
+		struct job *job = &queue->job[i];
+		job->start_time = cutest_clock_now();
+		job->state = JOB_RUNNING;
+		run_job(job, queue->options, &output);
+		job->end_time = cutest_clock_now();
+		job->state = JOB_DONE;
+#ifdef HAS_FORK
+		if (queue->options->jobs_backend == JOBS_BACKEND_PROCESSES) {
+			pthread_mutex_lock(&queue->process_lock);
+		}
+		else {
+			mtx_lock(&queue->thread_lock);
+		}
+#else
+		mtx_lock(&queue->thread_lock);
+#endif
+		fwrite(output.data, 1, output.size, stdout);
+		fflush(stdout);
+#ifdef HAS_FORK
+		if (queue->options->jobs_backend == JOBS_BACKEND_PROCESSES) {
+			pthread_mutex_unlock(&queue->process_lock);
+		}
+		else {
+			mtx_unlock(&queue->thread_lock);
+		}
+#else
+		mtx_unlock(&queue->thread_lock);
+#endif
+		cutest_buffer_clear(&output);
+	}
+	cutest_output_capture(previous_output);
+	cutest_buffer_destroy(&output);
+	cutest_trace_thread_end();
+}
+
+static void run_job(struct job job[static 1], struct options options[static 1], struct cutest_buffer output[static 1]) {
+#ifdef HAS_FORK
+	if (options->isolate) {
+		run_job_isolated(job, options, output);
+		return;
+	}
+#else
+	(void) output;
+#endif
+	job->usage = run_test(job->test, job->suite, options, &job->median_time);
+	job->result = job->test->result;
+}
+
+static int run_jobs_thread(void *queue) {
+	run_jobs(queue);
+	return 0;
+}
+
+static bool run_workers_threads(struct job_queue queue[static 1], size_t workers) {
+	thrd_t *thread = malloc(workers * sizeof *thread);
+	if (thread == nullptr) {
+		return false;
+	}
+	size_t started = 0;
+	while (started < workers && thrd_create(&thread[started], run_jobs_thread, queue) == thrd_success) {
+		started++;
+	}
+	for (size_t i = 0; i < started; i++) {
+		thrd_join(thread[i], nullptr);
+	}
+	free(thread);
+	return started > 0;
+}
+
+#ifdef HAS_FORK
+static bool run_workers_processes(struct job_queue queue[static 1], size_t workers) {
+	size_t started = 0;
+	fflush(stdout);
+	fflush(stderr);
+	// Else every worker would write its own copy of what the ring holds.
+	cutest_trace_flush();
+	for (size_t i = 0; i < workers; i++) {
+		pid_t pid = fork();
+		if (pid == -1) {
+			break;
+		}
+		if (pid == 0) {
+			run_jobs(queue);
+			fflush(stdout);
+			fflush(stderr);
+			_exit(EXIT_SUCCESS);
+		}
+		started++;
+	}
+	for (size_t i = 0; i < started; i++) {
+		while (wait(nullptr) == -1 && errno == EINTR);
+	}
+	return started > 0;
+}
+
+/*
+ * Run the test of a job in a child forked from the calling process, which
+ * registered every test before forking, so each test starts from the same clean
+ * state. The child writes everything to a pipe, whose end of file signals that
+ * the child has terminated.
+ */
+static void run_job_isolated(struct job job[static 1], struct options options[static 1], struct cutest_buffer output[static 1]) {
+	int pipe_fd[2];
+	if (pipe(pipe_fd) == -1) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	fflush(stdout);
+	fflush(stderr);
+	cutest_trace_flush();
+	uint64_t start_time = cutest_clock_now();
+	pid_t pid = fork();
+	if (pid == -1) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	if (pid == 0) {
+		close(pipe_fd[0]);
+		dup2(pipe_fd[1], STDOUT_FILENO);
+		dup2(pipe_fd[1], STDERR_FILENO);
+		close(pipe_fd[1]);
+		setvbuf(stdout, nullptr, _IONBF, 0);
+		cutest_output_capture(nullptr);
+		job->usage = run_test(job->test, job->suite, options, &job->median_time);
+		job->result = job->test->result;
+		job->state = JOB_DONE;
+		_exit(EXIT_SUCCESS);
+	}
+	close(pipe_fd[1]);
+	bool completed = read_output(pipe_fd[0], start_time, options->timeout, output);
+	close(pipe_fd[0]);
+	if (!completed) {
+		kill(pid, SIGKILL);
+	}
+	int status;
+	while (waitpid(pid, &status, 0) == -1 && errno == EINTR);
+	if (job->state == JOB_DONE && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
+		return;
+	}
+	job->result = false;
+	job->usage = (struct usage) {.wall_time = (double) (cutest_clock_now() - start_time) / 1e6};
+	char reason[128];
+	if (!completed) {
+		snprintf(reason, sizeof reason, "timed out after %" PRIu64 " ms", options->timeout);
+	}
+	else if (WIFSIGNALED(status)) {
+		const char *name = signal_name(WTERMSIG(status));
+		if (name != nullptr) {
+			snprintf(reason, sizeof reason, "terminated by %s: %s", name, strsignal(WTERMSIG(status)));
+		}
+		else {
+			snprintf(reason, sizeof reason, "terminated by signal %d", WTERMSIG(status));
+		}
+	}
+	else {
+		snprintf(reason,
+		         sizeof reason,
+		         "exited with status %d before the test completed",
+		         WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+	}
+	if (completed) {
+		print("[  FAILED  ] %s.%s (%s, %.2f ms)\n", job->suite->name, job->test->name, reason, job->usage.wall_time);
+	}
+	else {
+		print("[  FAILED  ] %s.%s (%s)\n", job->suite->name, job->test->name, reason);
+	}
+	report_test_failure(job->test, job->suite->name, options, job->usage, "Test %s.", reason);
+}
+
+/*
+ * Collect the output of an isolated test until its end of file. Returns false
+ * if the timeout in milliseconds, when not zero, expired first.
+ */
+static bool read_output(int fd, uint64_t start_time, uint64_t timeout, struct cutest_buffer output[static 1]) {
+	char chunk[4096];
+	while (true) {
+		int poll_timeout = -1;
+		if (timeout != 0) {
+			uint64_t elapsed_time = (cutest_clock_now() - start_time) / 1000000;
+			if (elapsed_time >= timeout) {
+				return false;
+			}
+			poll_timeout = (timeout - elapsed_time < INT_MAX) ? (int) (timeout - elapsed_time) : INT_MAX;
+		}
+		struct pollfd pollfd = {.fd = fd, .events = POLLIN};
+		int ready = poll(&pollfd, 1, poll_timeout);
+		if (ready == 0) {
+			return false;
+		}
+		if (ready == -1) {
+			if (errno == EINTR) {
+				continue;
 			}
+			return true;
+		}
+		ssize_t size = read(fd, chunk, sizeof chunk);
+		if (size == 0 || (size == -1 && errno != EINTR)) {
+			return true;
+		}
+		if (size > 0 && !cutest_buffer_append(output, chunk, (size_t) size)) {
+			perror(strerror(errno));
+			exit(1);
+		}
+	}
+}
+
+static const char *signal_name(int signal) {
+	static const struct {
+		int signal;
+		const char *name;
+	} signals[] = {
+		{SIGABRT, "SIGABRT"}, {SIGALRM, "SIGALRM"}, {SIGBUS, "SIGBUS"},   {SIGFPE, "SIGFPE"},
+		{SIGHUP, "SIGHUP"},   {SIGILL, "SIGILL"},   {SIGINT, "SIGINT"},   {SIGKILL, "SIGKILL"},
+		{SIGPIPE, "SIGPIPE"}, {SIGQUIT, "SIGQUIT"}, {SIGSEGV, "SIGSEGV"}, {SIGSYS, "SIGSYS"},
+		{SIGTERM, "SIGTERM"}, {SIGTRAP, "SIGTRAP"}, {SIGUSR1, "SIGUSR1"}, {SIGUSR2, "SIGUSR2"},
+	};
+	for (size_t i = 0; i < sizeof signals / sizeof *signals; i++) {
+		if (signals[i].signal == signal) {
+			return signals[i].name;
+		}
+	}
+	return nullptr;
+}
+#endif
+
+/*
+ * Tests running on the threads backend share the process, so their usage is
+ * sampled for the calling thread alone.
+ */
+static struct usage usage_sample(struct options options[static 1]) {
+	bool thread_scope = options->jobs > 1 && options->jobs_backend == JOBS_BACKEND_THREADS;
+	struct usage usage = {
+		.wall_time = (double) cutest_clock_now() / 1e6,
+		.cpu_time = (double) cutest_clock_cpu_now(thread_scope) / 1e6,
+	};
+#ifdef HAS_RUSAGE
+	if (options->resource_usage) {
+		struct rusage rusage;
+#ifdef RUSAGE_THREAD
+		int who = thread_scope ? RUSAGE_THREAD : RUSAGE_SELF;
+#else
+		int who = RUSAGE_SELF;
+#endif
+		if (getrusage(who, &rusage) == 0) {
+			usage.max_rss = rusage.ru_maxrss;
+			usage.minor_faults = rusage.ru_minflt;
+			usage.major_faults = rusage.ru_majflt;
+			usage.voluntary_context_switches = rusage.ru_nvcsw;
+			usage.involuntary_context_switches = rusage.ru_nivcsw;
 		}
 	}
+#endif
+	return usage;
+}
+
+static struct usage usage_delta(struct usage start, struct usage end) {
+	return (struct usage) {
+		.wall_time = end.wall_time - start.wall_time,
+		.cpu_time = end.cpu_time - start.cpu_time,
+		.max_rss = end.max_rss - start.max_rss,
+		.minor_faults = end.minor_faults - start.minor_faults,
+		.major_faults = end.major_faults - start.major_faults,
+		.voluntary_context_switches = end.voluntary_context_switches - start.voluntary_context_switches,
+		.involuntary_context_switches = end.involuntary_context_switches - start.involuntary_context_switches,
+	};
+}
+
+static void usage_accumulate(struct usage total[static 1], struct usage usage) {
+	total->wall_time += usage.wall_time;
+	total->cpu_time += usage.cpu_time;
+	total->max_rss += usage.max_rss;
+	total->minor_faults += usage.minor_faults;
+	total->major_faults += usage.major_faults;
+	total->voluntary_context_switches += usage.voluntary_context_switches;
+	total->involuntary_context_switches += usage.involuntary_context_switches;
+}
+
+static void print_usage(const char name[static 1], const char *test_suite_name, const char *test_name, struct usage usage) {
+	print("[%9s ]", name);
+	if (test_suite_name != nullptr && test_name != nullptr) {
+		print(" %s.%s", test_suite_name, test_name);
+	}
+	print(" peak RSS +%ld KiB, %ld minor / %ld major page faults, %ld voluntary / %ld involuntary context switches\n",
+	      usage.max_rss,
+	      usage.minor_faults,
+	      usage.major_faults,
+	      usage.voluntary_context_switches,
+	      usage.involuntary_context_switches);
+}
+
+/*
+ * Blocks allocated by the test and not freed by its end are reported as leaks,
+ * which does not fail it.
+ */
+static void print_alloc(const char test_suite_name[static 1], const char test_name[static 1], struct cutest_alloc_stats alloc) {
+	print("[    ALLOC ] %s.%s %zu allocations, %zu bytes, peak %td bytes allocated\n",
+	      test_suite_name,
+	      test_name,
+	      alloc.allocations,
+	      alloc.bytes,
+	      alloc.peak_bytes);
+	if (alloc.blocks > 0) {
+		print("[     LEAK ] %s.%s %td blocks (%td bytes) still allocated at the end of the test\n",
+		      test_suite_name,
+		      test_name,
+		      alloc.blocks,
+		      alloc.live_bytes);
+	}
+}
+
+static void print(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	cutest_output_vprintf(stdout, format, args);
+	va_end(args);
 }
@@ -0,0 +1,44 @@
+#include "cutest_internal.h"
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static bool module_load(const char path[static 1]);
+
+/*
+ * The arguments that are not options name the test modules, shared objects
+ * built with cutest_add_test_module(). Their tests register themselves with
+ * the runner as they are loaded, so the tests of every module run together as
+ * the ones of a single test program.
+ */
+extern int main(int argc, char *argv[argc + 1]) {
+	for (int i = 1; i < argc; i++) {
+		if (argv[i][0] != '-' && !module_load(argv[i])) {
+			return EXIT_FAILURE;
+		}
+	}
+	return cutest_main(argc, argv);
+}
+
+/*
+ * Modules stay loaded until the program ends, since the registry refers to
+ * their tests. A path without a slash names a file of the working directory
+ * rather than a library to look up.
+ */
+static bool module_load(const char path[static 1]) {
+	struct cutest_buffer buffer = {};
+	if (!cutest_buffer_printf(&buffer, "%s%s", (strchr(path, '/') == nullptr) ? "./" : "", path)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	void *module = dlopen(buffer.data, RTLD_NOW | RTLD_LOCAL);
+	cutest_buffer_destroy(&buffer);
+	if (module == nullptr) {
+		fprintf(stderr, "Could not load the test module %s: %s\n", path, dlerror());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,244 @@
+#include "cutest_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * A pattern of the filter. Names point into the filter text and are not
+ * null-terminated; suite_name_length equals length for patterns without a dot.
+ */
+struct cutest_filter_pattern {
+	const char *text;
+	size_t length;
+	size_t suite_name_length;
+	bool negative;
+	bool wildcard;
+};
+
+static bool patterns_match(size_t size,
+                           const struct cutest_filter_pattern pattern[static size],
+                           const char suite_name[static 1],
+                           const char test_name[static 1]);
+static bool exact_match(size_t size,
+                        const struct cutest_filter_pattern pattern[static size],
+                        const char suite_name[static 1],
+                        const char test_name[static 1]);
+static bool wildcard_match(const struct cutest_filter_pattern pattern[static 1],
+                           const char suite_name[static 1],
+                           const char test_name[static 1]);
+static bool glob_match(const char *pattern,
+                       size_t pattern_length,
+                       const char suite_name[static 1],
+                       size_t suite_name_length,
+                       const char test_name[static 1],
+                       size_t name_length);
+static int pattern_compare(const void *lhs, const void *rhs);
+static int name_compare(const char *lhs, size_t lhs_length, const char *rhs, size_t rhs_length);
+
+extern bool cutest_filter_compile(struct cutest_filter filter[static 1], const char text[static 1]) {
+	*filter = (struct cutest_filter) {};
+	size_t capacity = 1;
+	for (const char *c = text; *c != '\0'; c++) {
+		capacity += (*c == ':' || *c == '-');
+	}
+	filter->pattern = malloc(capacity * sizeof *filter->pattern);
+	if (filter->pattern == nullptr) {
+		return false;
+	}
+	bool negative = false;
+	for (const char *pattern = text; *pattern != '\0';) {
+		if (*pattern == '-' && !negative) {
+			negative = true;
+			pattern++;
+			continue;
+		}
+		size_t length = strcspn(pattern, negative ? ":" : ":-");
+		if (length != 0) {
+			const char *dot = memchr(pattern, '.', length);
+			filter->pattern[filter->size++] = (struct cutest_filter_pattern) {
+				.text = pattern,
+				.length = length,
+				.suite_name_length = (dot != nullptr) ? (size_t) (dot - pattern) : length,
+				.negative = negative,
+				.wildcard = strcspn(pattern, "*?") < length,
+			};
+		}
+		pattern += length + (pattern[length] == ':');
+	}
+	// Group the patterns by kind, with the exact ones sorted for binary search.
+	qsort(filter->pattern, filter->size, sizeof *filter->pattern, pattern_compare);
+	size_t i = 0;
+	for (; i < filter->size && !filter->pattern[i].negative; i++);
+	filter->positive_size = i;
+	filter->negative_size = filter->size - i;
+	return true;
+}
+
+/*
+ * Like Google Test, a test is selected if its full name matches one of the
+ * positive patterns, or there are none, and none of the negative ones. A
+ * pattern without wildcards or a dot also matches the suite name, selecting
+ * all its tests.
+ */
+extern bool cutest_filter_match(const struct cutest_filter filter[static 1],
+                                const char suite_name[static 1],
+                                const char test_name[static 1]) {
+	const struct cutest_filter_pattern *negative = filter->pattern + filter->positive_size;
+	return (filter->positive_size == 0 || patterns_match(filter->positive_size, filter->pattern, suite_name, test_name))
+	    && (filter->negative_size == 0 || !patterns_match(filter->negative_size, negative, suite_name, test_name));
+}
+
+extern void cutest_filter_destroy(struct cutest_filter filter[static 1]) {
+	free(filter->pattern);
+	*filter = (struct cutest_filter) {};
+}
+
+static bool patterns_match(size_t size,
+                           const struct cutest_filter_pattern pattern[static size],
+                           const char suite_name[static 1],
+                           const char test_name[static 1]) {
+	size_t exact_size = 0;
+	for (; exact_size < size && !pattern[exact_size].wildcard; exact_size++);
+	if (exact_size != 0 && exact_match(exact_size, pattern, suite_name, test_name)) {
+		return true;
+	}
+	for (size_t i = exact_size; i < size; i++) {
+		if (wildcard_match(&pattern[i], suite_name, test_name)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool exact_match(size_t size,
+                        const struct cutest_filter_pattern pattern[static size],
+                        const char suite_name[static 1],
+                        const char test_name[static 1]) {
+	size_t suite_name_length = strlen(suite_name);
+	size_t test_name_length = strlen(test_name);
+	size_t low = 0;
+	size_t high = size;
+	// Find the first pattern for the suite, then look for the suite alone and
+	// for the test among the patterns of the suite.
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (name_compare(pattern[middle].text, pattern[middle].suite_name_length, suite_name, suite_name_length) < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	if (low == size || name_compare(pattern[low].text, pattern[low].suite_name_length, suite_name, suite_name_length) != 0) {
+		return false;
+	}
+	if (pattern[low].suite_name_length == pattern[low].length) {
+		return true;
+	}
+	high = size;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		const struct cutest_filter_pattern *candidate = &pattern[middle];
+		int comparison = name_compare(candidate->text, candidate->suite_name_length, suite_name, suite_name_length);
+		if (comparison == 0) {
+			comparison = name_compare(candidate->text + candidate->suite_name_length + 1,
+			                          candidate->length - candidate->suite_name_length - 1,
+			                          test_name,
+			                          test_name_length);
+		}
+		if (comparison == 0) {
+			return true;
+		}
+		if (comparison < 0) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return false;
+}
+
+static bool wildcard_match(const struct cutest_filter_pattern pattern[static 1],
+                           const char suite_name[static 1],
+                           const char test_name[static 1]) {
+	size_t suite_name_length = strlen(suite_name);
+	size_t name_length = suite_name_length + 1 + strlen(test_name);
+	return glob_match(pattern->text, pattern->length, suite_name, suite_name_length, test_name, name_length);
+}
+
+/*
+ * Match a pattern with '*' and '?' wildcards against "<suite>.<test>" without
+ * building the string. Backtracks to the last '*' only, so it runs in
+ * O(pattern * name) at worst.
+ */
+static bool glob_match(const char *pattern,
+                       size_t pattern_length,
+                       const char suite_name[static 1],
+                       size_t suite_name_length,
+                       const char test_name[static 1],
+                       size_t name_length) {
+	size_t p = 0;
+	size_t n = 0;
+	size_t star = SIZE_MAX;
+	size_t star_n = 0;
+	while (n < name_length) {
+		char c = (n < suite_name_length) ? suite_name[n] : (n == suite_name_length) ? '.' : test_name[n - suite_name_length - 1];
+		if (p < pattern_length && (pattern[p] == '?' || pattern[p] == c)) {
+			p++;
+			n++;
+		}
+		else if (p < pattern_length && pattern[p] == '*') {
+			star = p++;
+			star_n = n;
+		}
+		else if (star != SIZE_MAX) {
+			p = star + 1;
+			n = ++star_n;
+		}
+		else {
+			return false;
+		}
+	}
+	for (; p < pattern_length && pattern[p] == '*'; p++);
+	return p == pattern_length;
+}
+
+/*
+ * Positive patterns first, exact ones first within each kind, and exact ones
+ * sorted by suite name, with the suite alone before its tests, then test name.
+ */
+static int pattern_compare(const void *lhs, const void *rhs) {
+	const struct cutest_filter_pattern *lhs_pattern = lhs;
+	const struct cutest_filter_pattern *rhs_pattern = rhs;
+	if (lhs_pattern->negative != rhs_pattern->negative) {
+		return lhs_pattern->negative ? 1 : -1;
+	}
+	if (lhs_pattern->wildcard != rhs_pattern->wildcard) {
+		return lhs_pattern->wildcard ? 1 : -1;
+	}
+	if (lhs_pattern->wildcard) {
+		return (lhs_pattern->text > rhs_pattern->text) - (lhs_pattern->text < rhs_pattern->text);
+	}
+	int comparison = name_compare(lhs_pattern->text,
+	                              lhs_pattern->suite_name_length,
+	                              rhs_pattern->text,
+	                              rhs_pattern->suite_name_length);
+	if (comparison != 0) {
+		return comparison;
+	}
+	bool lhs_suite = lhs_pattern->suite_name_length == lhs_pattern->length;
+	bool rhs_suite = rhs_pattern->suite_name_length == rhs_pattern->length;
+	if (lhs_suite || rhs_suite) {
+		return rhs_suite - lhs_suite;
+	}
+	return name_compare(lhs_pattern->text + lhs_pattern->suite_name_length + 1,
+	                    lhs_pattern->length - lhs_pattern->suite_name_length - 1,
+	                    rhs_pattern->text + rhs_pattern->suite_name_length + 1,
+	                    rhs_pattern->length - rhs_pattern->suite_name_length - 1);
+}
+
+static int name_compare(const char *lhs, size_t lhs_length, const char *rhs, size_t rhs_length) {
+	int comparison = strncmp(lhs, rhs, (lhs_length < rhs_length) ? lhs_length : rhs_length);
+	return (comparison != 0) ? comparison : (lhs_length > rhs_length) - (lhs_length < rhs_length);
+}
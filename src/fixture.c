@@ -0,0 +1,100 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <stdlib.h>
+
+/*
+ * Registered environments in registration order.
+ */
+static struct {
+	const struct cutest_environment **environment;
+	size_t size;
+	size_t capacity;
+} environments = {};
+
+static bool run_hook(const char name[static 1], void hook(void *context), void *context);
+static void run_suite_hook(void *hook);
+
+extern bool cutest_environment_add(const struct cutest_environment environment[static 1]) {
+	if (environments.capacity == environments.size) {
+		size_t capacity = environments.capacity ? environments.capacity * 2 : 4;
+		const struct cutest_environment **ptr = realloc(environments.environment, capacity * sizeof *ptr);
+		if (ptr == nullptr) {
+			return false;
+		}
+		environments.environment = ptr;
+		environments.capacity = capacity;
+	}
+	environments.environment[environments.size++] = environment;
+	return true;
+}
+
+extern bool cutest_environments_set_up() {
+	bool result = true;
+	for (size_t i = 0; i < environments.size; i++) {
+		const struct cutest_environment *environment = environments.environment[i];
+		if (environment->set_up != nullptr) {
+			result = run_hook("environment_set_up", environment->set_up, environment->context) && result;
+		}
+	}
+	return result;
+}
+
+extern bool cutest_environments_tear_down() {
+	bool result = true;
+	for (size_t i = environments.size; i > 0; i--) {
+		const struct cutest_environment *environment = environments.environment[i - 1];
+		if (environment->tear_down != nullptr) {
+			result = run_hook("environment_tear_down", environment->tear_down, environment->context) && result;
+		}
+	}
+	return result;
+}
+
+extern bool cutest_fixture_set_up_suite(const struct cutest_fixture fixture[static 1]) {
+	return fixture->set_up_suite == nullptr || run_hook("set_up_suite", run_suite_hook, (void *) &fixture->set_up_suite);
+}
+
+extern bool cutest_fixture_tear_down_suite(const struct cutest_fixture fixture[static 1]) {
+	return fixture->tear_down_suite == nullptr
+	    || run_hook("tear_down_suite", run_suite_hook, (void *) &fixture->tear_down_suite);
+}
+
+/*
+ * The body is skipped when the set-up failed, the tear-down always runs.
+ */
+extern void cutest_fixture_test_run_(const struct cutest_fixture fixture[static 1], void *data, void body(void *data)) {
+	struct cutest_test *test = cutest_test_current();
+	if (fixture->set_up != nullptr) {
+		fixture->set_up(data);
+	}
+	if (test == nullptr || test->result) {
+		body(data);
+	}
+	if (fixture->tear_down != nullptr) {
+		fixture->tear_down(data);
+	}
+}
+
+/*
+ * Hooks run outside of any test: their failed assertions are attributed to a
+ * placeholder test named after the hook.
+ */
+static bool run_hook(const char name[static 1], void hook(void *context), void *context) {
+	struct cutest_test placeholder = {
+		.name = name,
+		.result = true,
+	};
+	struct cutest_test *previous = cutest_test_set_current(&placeholder);
+	hook(context);
+	cutest_test_set_current(previous);
+	return placeholder.result;
+}
+
+/*
+ * Call the suite hook pointed to by hook, which takes no context.
+ */
+static void run_suite_hook(void *hook) {
+	(*(void (**)()) hook)();
+}
@@ -0,0 +1,818 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __has_include(<dirent.h>) && __has_include(<fcntl.h>) && __has_include(<sys/stat.h>) && __has_include(<unistd.h>)
+#define HAS_POSIX_FILES
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Mutations stacked on an input before it runs, at most.
+ */
+constexpr size_t MAX_MUTATIONS = 4;
+
+/*
+ * Counters of the code compiled with -fsanitize-coverage=trace-pc, which only
+ * tells the address of the block, hashed into a fixed table.
+ */
+constexpr size_t PC_COUNTERS = 1 << 16;
+
+/*
+ * Hit counts of the edges of the code compiled with
+ * -fsanitize-coverage=trace-pc-guard, indexed by the guards, which are
+ * numbered from 1 across all the instrumented modules, and of the blocks of
+ * the code compiled with -fsanitize-coverage=trace-pc. A feature is an edge
+ * hit a number of times in one of the buckets 1, 2, 3, 4-7, 8-15, 16-31,
+ * 32-127 and 128-255, recorded as a bit in seen.
+ */
+static struct {
+	uint8_t *counter;
+	uint8_t *seen;
+	size_t size;
+	uint8_t pc_counter[PC_COUNTERS];
+	uint8_t pc_seen[PC_COUNTERS];
+	size_t features;
+} coverage = {};
+
+/*
+ * The inputs that reached new features, in the order they were found.
+ */
+struct corpus {
+	struct corpus_entry {
+		uint8_t *data;
+		size_t size;
+	} *entry;
+	size_t size;
+	size_t capacity;
+};
+
+struct fuzzer {
+	struct cutest_test *test;
+	const struct cutest_fuzz_options *options;
+	struct cutest_buffer corpus_dir;
+	struct corpus corpus;
+	uint64_t random;
+	size_t runs;
+	uint64_t start_time;
+};
+
+typedef size_t mutator(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size);
+
+static const char *corpus_dir_override = nullptr;
+
+/*
+ * The input being run and the path to save it at if it crashes the process, for
+ * the signal handlers, with room for the hash of the input at its end.
+ */
+static struct {
+	const uint8_t *data;
+	size_t size;
+	struct cutest_buffer path;
+} current_input = {};
+
+[[gnu::weak]] extern void __sanitizer_set_death_callback(void (*callback)());
+
+extern void __sanitizer_cov_trace_pc_guard_init(uint32_t *start, uint32_t *stop);
+extern void __sanitizer_cov_trace_pc_guard(uint32_t *guard);
+extern void __sanitizer_cov_trace_pc();
+
+static void corpus_path(struct cutest_buffer buffer[static 1], const struct cutest_test test[static 1]);
+static bool run_input(struct cutest_test test[static 1], const uint8_t data[], size_t size);
+static size_t collect_features();
+static size_t collect_counters(uint8_t counter[], uint8_t seen[], size_t size);
+static bool corpus_add(struct corpus corpus[static 1], const uint8_t data[], size_t size);
+static void corpus_destroy(struct corpus corpus[static 1]);
+static bool load_corpus(struct fuzzer fuzzer[static 1]);
+static bool save_input(const char directory[static 1], const uint8_t data[], size_t size);
+static void save_crash_input(const uint8_t data[], size_t size);
+static void save_current_input();
+static void crash_handler(int signal_number);
+static uint64_t hash(const uint8_t data[], size_t size);
+static uint64_t next_random(uint64_t state[static 1]);
+static size_t random_below(struct fuzzer fuzzer[static 1], size_t bound);
+static size_t mutate(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size);
+static mutator mutate_flip_bit;
+static mutator mutate_random_byte;
+static mutator mutate_interesting_byte;
+static mutator mutate_add_byte;
+static mutator mutate_insert_byte;
+static mutator mutate_erase_bytes;
+static mutator mutate_copy_bytes;
+static mutator mutate_splice;
+static void status(struct fuzzer fuzzer[static 1], const char event[static 1]);
+
+#ifdef HAS_POSIX_FILES
+struct file_list {
+	char **name;
+	size_t size;
+	size_t capacity;
+};
+
+static bool list_files(const char directory[static 1], struct file_list files[static 1]);
+static void file_list_destroy(struct file_list files[static 1]);
+static bool read_file(const char path[static 1], struct cutest_buffer buffer[static 1]);
+static int name_compare(const void *lhs, const void *rhs);
+#endif
+
+/*
+ * Signals on which the input being run is saved before the process dies.
+ */
+static const int crash_signals[] = {
+	SIGSEGV,
+	SIGILL,
+	SIGFPE,
+	SIGABRT,
+#ifdef SIGBUS
+	SIGBUS,
+#endif
+};
+
+static mutator *const mutators[] = {
+	mutate_flip_bit,
+	mutate_random_byte,
+	mutate_interesting_byte,
+	mutate_add_byte,
+	mutate_insert_byte,
+	mutate_erase_bytes,
+	mutate_copy_bytes,
+	mutate_splice,
+};
+
+extern void __sanitizer_cov_trace_pc_guard_init(uint32_t *start, uint32_t *stop) {
+	if (start == stop || *start != 0) {
+		return;
+	}
+	size_t size = coverage.size + (size_t) (stop - start);
+	uint8_t *counter = realloc(coverage.counter, size + 1);
+	uint8_t *seen = realloc(coverage.seen, size + 1);
+	if (counter == nullptr || seen == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	memset(counter + coverage.size, 0, size + 1 - coverage.size);
+	memset(seen + coverage.size, 0, size + 1 - coverage.size);
+	for (uint32_t *guard = start; guard < stop; guard++) {
+		*guard = (uint32_t) ++coverage.size;
+	}
+	coverage.counter = counter;
+	coverage.seen = seen;
+}
+
+/*
+ * Called on every edge of the instrumented code: the counters wrap around,
+ * and guards that were not initialized hit the unused counter 0.
+ */
+extern void __sanitizer_cov_trace_pc_guard(uint32_t *guard) {
+	coverage.counter[*guard]++;
+}
+
+extern void __sanitizer_cov_trace_pc() {
+	uint64_t pc = (uint64_t) (uintptr_t) __builtin_return_address(0);
+	coverage.pc_counter[(pc * 0x9e3779b97f4a7c15) >> 48]++;
+}
+
+extern void cutest_fuzz_set_corpus_dir(const char directory[static 1]) {
+	corpus_dir_override = directory;
+}
+
+/*
+ * A failure on an input of the corpus is followed by one naming the input.
+ */
+extern void cutest_fuzz_replay_() {
+	struct cutest_test *test = cutest_test_current();
+	if (test == nullptr || test->fuzz == nullptr) {
+		fprintf(stderr, "Fuzz tests must be run by the runner, or from a thread attached to their test.\n");
+		abort();
+	}
+	if (!run_input(test, nullptr, 0)) {
+		cutest_test_fail_("cutest_fuzz_replay_", test->file, test->line, "Failed on the empty input.");
+		cutest_test_fail_end_();
+	}
+#ifdef HAS_POSIX_FILES
+	struct cutest_buffer directory = {};
+	corpus_path(&directory, test);
+	struct file_list files = {};
+	if (!list_files(directory.data, &files) && errno != ENOENT) {
+		cutest_test_fail_("cutest_fuzz_replay_",
+		                  test->file,
+		                  test->line,
+		                  "Could not read the corpus %s: %s",
+		                  directory.data,
+		                  strerror(errno));
+		cutest_test_fail_end_();
+	}
+	struct cutest_buffer path = {};
+	struct cutest_buffer input = {};
+	for (size_t i = 0; i < files.size; i++) {
+		cutest_buffer_clear(&path);
+		cutest_buffer_clear(&input);
+		if (!cutest_buffer_printf(&path, "%s/%s", directory.data, files.name[i])) {
+			perror(strerror(errno));
+			exit(1);
+		}
+		if (!read_file(path.data, &input)) {
+			cutest_test_fail_("cutest_fuzz_replay_",
+			                  test->file,
+			                  test->line,
+			                  "Could not read the corpus input %s: %s",
+			                  path.data,
+			                  strerror(errno));
+			cutest_test_fail_end_();
+		}
+		else if (!run_input(test, (const uint8_t *) input.data, input.size)) {
+			cutest_test_fail_("cutest_fuzz_replay_", test->file, test->line, "Failed on the corpus input %s.", path.data);
+			cutest_test_fail_end_();
+		}
+	}
+	cutest_buffer_destroy(&input);
+	cutest_buffer_destroy(&path);
+	file_list_destroy(&files);
+	cutest_buffer_destroy(&directory);
+#endif
+}
+
+extern bool cutest_fuzz_run(struct cutest_test test[static 1],
+                            const char suite_name[static 1],
+                            const struct cutest_fuzz_options options[static 1]) {
+	struct fuzzer fuzzer = {
+		.test = test,
+		.options = options,
+		.random = options->seed ? options->seed : 1,
+		.start_time = cutest_clock_now(),
+	};
+	corpus_path(&fuzzer.corpus_dir, test);
+	if (!cutest_buffer_printf(&current_input.path,
+	                          "%s%scrash-%s.%s-0123456789abcdef",
+	                          options->artifact_dir,
+	                          (options->artifact_dir[0] != '\0') ? "/" : "",
+	                          suite_name,
+	                          test->name)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	printf("Fuzzing %s.%s with seed %" PRIu64 ", corpus %s\n", suite_name, test->name, options->seed, fuzzer.corpus_dir.data);
+	void (*previous_handler[sizeof crash_signals / sizeof *crash_signals])(int);
+	// The sanitizers report crashes themselves, then call the death callback.
+	bool sanitized = __sanitizer_set_death_callback != nullptr;
+	if (sanitized) {
+		__sanitizer_set_death_callback(save_current_input);
+	}
+	for (size_t i = 0; !sanitized && i < sizeof crash_signals / sizeof *crash_signals; i++) {
+		previous_handler[i] = signal(crash_signals[i], crash_handler);
+	}
+	bool result = load_corpus(&fuzzer);
+	if (coverage.features == 0) {
+		printf("Note: The test reached no code compiled with -fsanitize-coverage=trace-pc-guard or trace-pc, "
+		       "inputs are mutated without feedback.\n");
+	}
+	uint8_t *data = malloc(options->max_size ? options->max_size : 1);
+	if (data == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	while (result && !options->minimize
+	       && (options->runs == 0 || fuzzer.runs < options->runs)
+	       && (options->time == 0 || cutest_clock_now() - fuzzer.start_time < options->time)) {
+		struct corpus_entry *entry = &fuzzer.corpus.entry[random_below(&fuzzer, fuzzer.corpus.size)];
+		size_t size = (entry->size < options->max_size) ? entry->size : options->max_size;
+		memcpy(data, entry->data, size);
+		size = mutate(&fuzzer, data, size, options->max_size);
+		fuzzer.runs++;
+		if (!run_input(test, data, size)) {
+			save_crash_input(data, size);
+			result = false;
+		}
+		else if (collect_features() > 0) {
+			if (!corpus_add(&fuzzer.corpus, data, size)) {
+				perror(strerror(errno));
+				exit(1);
+			}
+			if (!save_input(fuzzer.corpus_dir.data, data, size)) {
+				fprintf(stderr, "Could not save an input to the corpus %s: %s\n", fuzzer.corpus_dir.data, strerror(errno));
+			}
+			status(&fuzzer, "NEW");
+		}
+		else if ((fuzzer.runs & (fuzzer.runs - 1)) == 0 && fuzzer.runs >= 1024) {
+			status(&fuzzer, "PULSE");
+		}
+	}
+	status(&fuzzer, result ? "DONE" : "FAILED");
+	for (size_t i = 0; !sanitized && i < sizeof crash_signals / sizeof *crash_signals; i++) {
+		signal(crash_signals[i], previous_handler[i]);
+	}
+	if (sanitized) {
+		__sanitizer_set_death_callback(nullptr);
+	}
+	free(data);
+	corpus_destroy(&fuzzer.corpus);
+	cutest_buffer_destroy(&fuzzer.corpus_dir);
+	cutest_buffer_destroy(&current_input.path);
+	return result;
+}
+
+static void corpus_path(struct cutest_buffer buffer[static 1], const struct cutest_test test[static 1]) {
+	if (corpus_dir_override == nullptr) {
+		cutest_source_path(buffer, test->corpus, test->file);
+		return;
+	}
+	const char *name = strrchr(test->corpus, '/');
+	if (!cutest_buffer_printf(buffer, "%s/%s", corpus_dir_override, (name != nullptr) ? name + 1 : test->corpus)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
+/*
+ * Run the target of test on a copy of the input of exactly its size, so that
+ * the address sanitizer catches reads past its end. Returns false if an
+ * assertion failed.
+ */
+static bool run_input(struct cutest_test test[static 1], const uint8_t data[], size_t size) {
+	uint8_t *copy = malloc(size ? size : 1);
+	if (copy == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	if (size > 0) {
+		memcpy(copy, data, size);
+	}
+	current_input.data = copy;
+	current_input.size = size;
+	bool result = test->result;
+	test->result = true;
+	struct cutest_test *previous = cutest_test_set_current(test);
+	test->fuzz(copy, size);
+	cutest_test_set_current(previous);
+	bool passed = test->result;
+	test->result = result && passed;
+	current_input.data = nullptr;
+	current_input.size = 0;
+	free(copy);
+	return passed;
+}
+
+/*
+ * Record the features reached by the last input that were never reached
+ * before, clearing the counters. Returns their number.
+ */
+static size_t collect_features() {
+	size_t features = collect_counters(coverage.pc_counter, coverage.pc_seen, PC_COUNTERS);
+	if (coverage.size > 0) {
+		features += collect_counters(coverage.counter + 1, coverage.seen + 1, coverage.size);
+	}
+	coverage.features += features;
+	return features;
+}
+
+/*
+ * Most counters stay at zero, the scan skips them eight at a time.
+ */
+static size_t collect_counters(uint8_t counter[], uint8_t seen[], size_t size) {
+	size_t features = 0;
+	for (size_t i = 0; i < size; i++) {
+		uint64_t word;
+		if (i % sizeof word == 0 && i + sizeof word <= size && (memcpy(&word, counter + i, sizeof word), word == 0)) {
+			i += sizeof word - 1;
+			continue;
+		}
+		uint8_t count = counter[i];
+		if (count == 0) {
+			continue;
+		}
+		counter[i] = 0;
+		unsigned bucket = (count >= 128) ? 7
+		                : (count >= 32)  ? 6
+		                : (count >= 16)  ? 5
+		                : (count >= 8)   ? 4
+		                : (count >= 4)   ? 3
+		                                 : count - 1u;
+		uint8_t feature = (uint8_t) (1u << bucket);
+		features += (seen[i] & feature) == 0;
+		seen[i] |= feature;
+	}
+	return features;
+}
+
+static bool corpus_add(struct corpus corpus[static 1], const uint8_t data[], size_t size) {
+	if (corpus->size == corpus->capacity) {
+		size_t capacity = corpus->capacity ? corpus->capacity * 2 : 64;
+		struct corpus_entry *entry = realloc(corpus->entry, capacity * sizeof *entry);
+		if (entry == nullptr) {
+			return false;
+		}
+		corpus->entry = entry;
+		corpus->capacity = capacity;
+	}
+	uint8_t *copy = malloc(size ? size : 1);
+	if (copy == nullptr) {
+		return false;
+	}
+	if (size > 0) {
+		memcpy(copy, data, size);
+	}
+	corpus->entry[corpus->size++] = (struct corpus_entry) {.data = copy, .size = size};
+	return true;
+}
+
+static void corpus_destroy(struct corpus corpus[static 1]) {
+	for (size_t i = 0; i < corpus->size; i++) {
+		free(corpus->entry[i].data);
+	}
+	free(corpus->entry);
+	*corpus = (struct corpus) {};
+}
+
+/*
+ * Run the empty input and those of the corpus directory, smallest first,
+ * keeping the ones that reach new features. When minimizing, the files of the
+ * others are removed.
+ */
+static bool load_corpus(struct fuzzer fuzzer[static 1]) {
+	if (!run_input(fuzzer->test, nullptr, 0)) {
+		save_crash_input(nullptr, 0);
+		return false;
+	}
+	collect_features();
+	if (!corpus_add(&fuzzer->corpus, nullptr, 0)) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	fuzzer->runs++;
+#ifdef HAS_POSIX_FILES
+	struct file_list files = {};
+	if (!list_files(fuzzer->corpus_dir.data, &files) && errno != ENOENT) {
+		fprintf(stderr, "Could not read the corpus %s: %s\n", fuzzer->corpus_dir.data, strerror(errno));
+		file_list_destroy(&files);
+		return false;
+	}
+	struct cutest_buffer path = {};
+	struct loaded_input {
+		struct cutest_buffer data;
+		const char *name;
+	} *inputs = calloc(files.size ? files.size : 1, sizeof *inputs);
+	if (inputs == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t size = 0;
+	for (size_t i = 0; i < files.size; i++) {
+		cutest_buffer_clear(&path);
+		if (!cutest_buffer_printf(&path, "%s/%s", fuzzer->corpus_dir.data, files.name[i])
+		    || !read_file(path.data, &inputs[size].data)) {
+			fprintf(stderr, "Could not read the corpus input %s: %s\n", path.data, strerror(errno));
+			cutest_buffer_destroy(&inputs[size].data);
+			continue;
+		}
+		inputs[size].name = files.name[i];
+		// Insertion sort by size, stable so that equal sizes keep the order of the names.
+		for (size_t j = size++; j > 0 && inputs[j - 1].data.size > inputs[j].data.size; j--) {
+			struct loaded_input input = inputs[j - 1];
+			inputs[j - 1] = inputs[j];
+			inputs[j] = input;
+		}
+	}
+	bool result = true;
+	size_t ran = 0;
+	size_t removed = 0;
+	for (size_t i = 0; result && i < size; i++) {
+		const uint8_t *data = (const uint8_t *) inputs[i].data.data;
+		fuzzer->runs++;
+		ran++;
+		if (!run_input(fuzzer->test, data, inputs[i].data.size)) {
+			save_crash_input(data, inputs[i].data.size);
+			result = false;
+		}
+		else if (collect_features() > 0) {
+			if (!corpus_add(&fuzzer->corpus, data, inputs[i].data.size)) {
+				perror(strerror(errno));
+				exit(1);
+			}
+		}
+		else if (fuzzer->options->minimize) {
+			cutest_buffer_clear(&path);
+			if (!cutest_buffer_printf(&path, "%s/%s", fuzzer->corpus_dir.data, inputs[i].name)) {
+				perror(strerror(errno));
+				exit(1);
+			}
+			removed += unlink(path.data) == 0;
+		}
+	}
+	// Inputs that could not be read, or that follow a crash, are left out.
+	if (fuzzer->options->minimize) {
+		printf("Minimized the corpus from %zu to %zu inputs, removing %zu files.\n", ran, ran - removed, removed);
+	}
+	status(fuzzer, "INITED");
+	for (size_t i = 0; i < files.size; i++) {
+		cutest_buffer_destroy(&inputs[i].data);
+	}
+	free(inputs);
+	cutest_buffer_destroy(&path);
+	file_list_destroy(&files);
+	return result;
+#else
+	status(fuzzer, "INITED");
+	return true;
+#endif
+}
+
+/*
+ * Write data to a file of directory named after its hash, creating the
+ * directory if needed.
+ */
+static bool save_input(const char directory[static 1], const uint8_t data[], size_t size) {
+#ifdef HAS_POSIX_FILES
+	struct cutest_buffer path = {};
+	if (!cutest_buffer_printf(&path, "%s/", directory)) {
+		return false;
+	}
+	// Create the missing parents too, a component at a time.
+	for (char *separator = strchr(path.data + 1, '/'); separator != nullptr; separator = strchr(separator + 1, '/')) {
+		*separator = '\0';
+		bool created = mkdir(path.data, 0755) == 0 || errno == EEXIST;
+		*separator = '/';
+		if (!created) {
+			cutest_buffer_destroy(&path);
+			return false;
+		}
+	}
+	if (!cutest_buffer_printf(&path, "%016" PRIx64, hash(data, size))) {
+		cutest_buffer_destroy(&path);
+		return false;
+	}
+	FILE *file = fopen(path.data, "wb");
+	cutest_buffer_destroy(&path);
+	if (file == nullptr) {
+		return false;
+	}
+	bool result = fwrite(data, 1, size, file) == size;
+	return (fclose(file) == 0) && result;
+#else
+	(void) directory;
+	(void) data;
+	(void) size;
+	return true;
+#endif
+}
+
+/*
+ * Save a failing input, replacing the placeholder at the end of the crash path
+ * with its hash. This only makes async-signal-safe calls, as it also runs from
+ * the signal handlers and the sanitizer death callback.
+ */
+static void save_crash_input(const uint8_t data[], size_t size) {
+	if (current_input.path.data == nullptr) {
+		return;
+	}
+	static const char digits[] = "0123456789abcdef";
+	uint64_t id = hash(data, size);
+	char *end = current_input.path.data + current_input.path.size;
+	for (size_t i = 1; i <= 16; i++, id >>= 4) {
+		end[-(ptrdiff_t) i] = digits[id & 0xf];
+	}
+#ifdef HAS_POSIX_FILES
+	int fd = open(current_input.path.data, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	bool saved = fd != -1;
+	for (size_t written = 0; saved && written < size;) {
+		ssize_t n = write(fd, data + written, size - written);
+		saved = n > 0 || (n == -1 && errno == EINTR);
+		written += (n > 0) ? (size_t) n : 0;
+	}
+	if (fd != -1) {
+		close(fd);
+	}
+	static const char message[] = "Failing input saved to ";
+	if (saved) {
+		(void) !write(STDERR_FILENO, message, sizeof message - 1);
+		(void) !write(STDERR_FILENO, current_input.path.data, current_input.path.size);
+		(void) !write(STDERR_FILENO, "\n", 1);
+	}
+#else
+	FILE *file = fopen(current_input.path.data, "wb");
+	if (file != nullptr) {
+		fwrite(data, 1, size, file);
+		fclose(file);
+		fprintf(stderr, "Failing input saved to %s\n", current_input.path.data);
+	}
+#endif
+}
+
+/*
+ * Save the input being run, if any, once: the sanitizers call the death
+ * callback after the signal handlers on some errors.
+ */
+static void save_current_input() {
+	if (current_input.data != nullptr) {
+		save_crash_input(current_input.data, current_input.size);
+		current_input.data = nullptr;
+	}
+}
+
+static void crash_handler(int signal_number) {
+	save_current_input();
+	signal(signal_number, SIG_DFL);
+	raise(signal_number);
+}
+
+/*
+ * FNV-1a.
+ */
+static uint64_t hash(const uint8_t data[], size_t size) {
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 0x100000001b3;
+	}
+	return hash;
+}
+
+/*
+ * xorshift64*.
+ */
+static uint64_t next_random(uint64_t state[static 1]) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 0x2545f4914f6cdd1d;
+}
+
+static size_t random_below(struct fuzzer fuzzer[static 1], size_t bound) {
+	return (bound > 0) ? (size_t) (next_random(&fuzzer->random) % bound) : 0;
+}
+
+static size_t mutate(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size) {
+	size_t mutations = 1 + random_below(fuzzer, MAX_MUTATIONS);
+	for (size_t i = 0; i < mutations; i++) {
+		mutator *mutation = (size == 0) ? mutate_insert_byte : mutators[random_below(fuzzer, sizeof mutators / sizeof *mutators)];
+		size = mutation(fuzzer, data, size, max_size);
+	}
+	return size;
+}
+
+static size_t mutate_flip_bit(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t) {
+	data[random_below(fuzzer, size)] ^= (uint8_t) (1u << random_below(fuzzer, 8));
+	return size;
+}
+
+static size_t mutate_random_byte(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t) {
+	data[random_below(fuzzer, size)] = (uint8_t) next_random(&fuzzer->random);
+	return size;
+}
+
+static size_t mutate_interesting_byte(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t) {
+	static const uint8_t interesting[] = {0x00, 0x01, 0x7f, 0x80, 0xff, '0', '9', 'a', 'z', ' ', '\n', '"', '{', '}'};
+	data[random_below(fuzzer, size)] = interesting[random_below(fuzzer, sizeof interesting)];
+	return size;
+}
+
+static size_t mutate_add_byte(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t) {
+	size_t i = random_below(fuzzer, size);
+	data[i] = (uint8_t) (data[i] + 1 + random_below(fuzzer, 16) * ((random_below(fuzzer, 2) == 0) ? 1 : 255));
+	return size;
+}
+
+static size_t mutate_insert_byte(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size) {
+	if (size >= max_size) {
+		return size;
+	}
+	size_t i = random_below(fuzzer, size + 1);
+	memmove(data + i + 1, data + i, size - i);
+	data[i] = (uint8_t) next_random(&fuzzer->random);
+	return size + 1;
+}
+
+static size_t mutate_erase_bytes(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t) {
+	if (size <= 1) {
+		return size;
+	}
+	size_t i = random_below(fuzzer, size);
+	size_t n = 1 + random_below(fuzzer, (size - i < 16) ? size - i : 16);
+	memmove(data + i, data + i + n, size - i - n);
+	return size - n;
+}
+
+/*
+ * Copy a range of the input over another one, or insert it.
+ */
+static size_t mutate_copy_bytes(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size) {
+	size_t from = random_below(fuzzer, size);
+	size_t n = 1 + random_below(fuzzer, size - from);
+	size_t to = random_below(fuzzer, size);
+	if (random_below(fuzzer, 2) == 0 || size + n > max_size) {
+		n = (n < size - to) ? n : size - to;
+		memmove(data + to, data + from, n);
+		return size;
+	}
+	uint8_t chunk[64];
+	n = (n < sizeof chunk) ? n : sizeof chunk;
+	memcpy(chunk, data + from, n);
+	memmove(data + to + n, data + to, size - to);
+	memcpy(data + to, chunk, n);
+	return size + n;
+}
+
+/*
+ * Replace the end of the input with the end of another input of the corpus.
+ */
+static size_t mutate_splice(struct fuzzer fuzzer[static 1], uint8_t data[], size_t size, size_t max_size) {
+	const struct corpus_entry *other = &fuzzer->corpus.entry[random_below(fuzzer, fuzzer->corpus.size)];
+	if (other->size == 0) {
+		return size;
+	}
+	size_t at = random_below(fuzzer, size + 1);
+	size_t from = random_below(fuzzer, other->size);
+	size_t n = other->size - from;
+	n = (at + n <= max_size) ? n : max_size - at;
+	memcpy(data + at, other->data + from, n);
+	return at + n;
+}
+
+static void status(struct fuzzer fuzzer[static 1], const char event[static 1]) {
+	uint64_t elapsed = cutest_clock_now() - fuzzer->start_time;
+	printf("#%zu\t%s\tcorpus: %zu\tfeatures: %zu\texec/s: %" PRIu64 "\n",
+	       fuzzer->runs,
+	       event,
+	       fuzzer->corpus.size,
+	       coverage.features,
+	       (elapsed > 0) ? (uint64_t) fuzzer->runs * 1000000000 / elapsed : 0);
+	fflush(stdout);
+}
+
+#ifdef HAS_POSIX_FILES
+/*
+ * The names of the regular files of directory, sorted.
+ */
+static bool list_files(const char directory[static 1], struct file_list files[static 1]) {
+	DIR *dir = opendir(directory);
+	if (dir == nullptr) {
+		return false;
+	}
+	struct cutest_buffer path = {};
+	struct dirent *entry;
+	bool result = true;
+	while (result && (entry = readdir(dir)) != nullptr) {
+		struct stat st;
+		cutest_buffer_clear(&path);
+		if (entry->d_name[0] == '.' || !cutest_buffer_printf(&path, "%s/%s", directory, entry->d_name)
+		    || stat(path.data, &st) == -1 || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+		if (files->size == files->capacity) {
+			size_t capacity = files->capacity ? files->capacity * 2 : 64;
+			char **name = realloc(files->name, capacity * sizeof *name);
+			result = name != nullptr;
+			files->name = result ? name : files->name;
+			files->capacity = result ? capacity : files->capacity;
+		}
+		if (result) {
+			files->name[files->size] = strdup(entry->d_name);
+			result = files->name[files->size] != nullptr;
+			files->size += result;
+		}
+	}
+	closedir(dir);
+	cutest_buffer_destroy(&path);
+	if (files->size > 0) {
+		qsort(files->name, files->size, sizeof *files->name, name_compare);
+	}
+	return result;
+}
+
+static void file_list_destroy(struct file_list files[static 1]) {
+	for (size_t i = 0; i < files->size; i++) {
+		free(files->name[i]);
+	}
+	free(files->name);
+	*files = (struct file_list) {};
+}
+
+static bool read_file(const char path[static 1], struct cutest_buffer buffer[static 1]) {
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	char chunk[BUFSIZ];
+	size_t n;
+	bool result = true;
+	while (result && (n = fread(chunk, 1, sizeof chunk, file)) > 0) {
+		result = cutest_buffer_append(buffer, chunk, n);
+	}
+	result = result && !ferror(file);
+	fclose(file);
+	return result;
+}
+
+static int name_compare(const void *lhs, const void *rhs) {
+	return strcmp(*(char *const *) lhs, *(char *const *) rhs);
+}
+#endif
@@ -0,0 +1,319 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if __has_include(<fcntl.h>) && __has_include(<sys/mman.h>) && __has_include(<sys/stat.h>) \
+    && __has_include(<unistd.h>)
+#define HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Bytes of a line shown on each side of the first difference of two texts.
+ */
+constexpr size_t LINE_CONTEXT = 60;
+
+/*
+ * The contents of a golden file, mapped in memory where possible and read
+ * into data otherwise.
+ */
+struct golden {
+	const unsigned char *data;
+	size_t size;
+	void *mapping;
+	struct cutest_buffer buffer;
+};
+
+static atomic_bool update = false;
+
+static bool golden_open(struct golden golden[static 1], const char path[static 1]);
+static void golden_close(struct golden golden[static 1]);
+static bool golden_write(const char path[static 1], const void *data, size_t size);
+static bool is_text(const unsigned char data[], size_t begin, size_t end);
+static void append_line_diff(struct cutest_buffer buffer[static 1],
+                             const unsigned char actual[],
+                             size_t actual_size,
+                             const unsigned char expected[],
+                             size_t expected_size,
+                             size_t first);
+static void append_line(struct cutest_buffer buffer[static 1],
+                        const char label[static 1],
+                        const unsigned char data[],
+                        size_t size,
+                        size_t first);
+[[gnu::format(printf, 2, 3)]]
+static void append(struct cutest_buffer buffer[static 1], const char *format, ...);
+
+extern void cutest_golden_set_update(bool value) {
+	update = value;
+}
+
+/*
+ * Relative paths are resolved against the directory of the source file of the
+ * assertion when its name is absolute, so that the golden files can live next
+ * to the tests whatever the working directory of the run.
+ */
+extern bool cutest_golden_match_(const void *data,
+                                 size_t size,
+                                 const char path[static 1],
+                                 const struct cutest_comparison_ comparison[static 1]) {
+	struct cutest_buffer resolved = {};
+	cutest_source_path(&resolved, path, comparison->file);
+	struct golden golden = {};
+	bool opened = golden_open(&golden, resolved.data);
+	int error = errno;
+	size_t first = (size < golden.size) ? size : golden.size;
+	size_t count = opened ? cutest_memory_mismatch(data, golden.data, first, &first) : 0;
+	if (opened && count == 0 && size == golden.size) {
+		golden_close(&golden);
+		cutest_buffer_destroy(&resolved);
+		return true;
+	}
+	bool result = update;
+	struct cutest_buffer message = {};
+	if (update && golden_write(resolved.data, data, size)) {
+		cutest_output_printf(stderr, "%s:%d: Updated the golden file %s.\n", comparison->file, comparison->line, resolved.data);
+	}
+	else if (update) {
+		result = false;
+		append(&message, "Could not update the golden file %s: %s", resolved.data, strerror(errno));
+	}
+	else if (!opened) {
+		append(&message,
+		       "Could not open the golden file %s: %s\n"
+		       "  Run with --cutest_update_golden to create it.",
+		       resolved.data,
+		       strerror(error));
+	}
+	else {
+		count += (size > golden.size) ? size - golden.size : golden.size - size;
+		append(&message,
+		       "Expected %s (%zu bytes) to match the golden file %s (%zu bytes):\n"
+		       "  %zu bytes differ, the first at offset %zu:\n",
+		       comparison->lhs,
+		       size,
+		       resolved.data,
+		       golden.size,
+		       count,
+		       first);
+		size_t line_begin = first;
+		for (; line_begin > 0 && ((const unsigned char *) data)[line_begin - 1] != '\n'; line_begin--);
+		size_t end = first + LINE_CONTEXT;
+		if (is_text(data, line_begin, (end < size) ? end : size)
+		    && is_text(golden.data, line_begin, (end < golden.size) ? end : golden.size)) {
+			append_line_diff(&message, data, size, golden.data, golden.size, first);
+		}
+		else {
+			cutest_memory_hexdump(&message, data, size, golden.data, golden.size, first);
+		}
+		append(&message, "\n  Run with --cutest_update_golden to accept the new contents.");
+	}
+	if (!result) {
+		cutest_test_fail_(comparison->test_function_name, comparison->file, comparison->line, "%s", message.data);
+	}
+	cutest_buffer_destroy(&message);
+	golden_close(&golden);
+	cutest_buffer_destroy(&resolved);
+	return result;
+}
+
+extern void cutest_source_path(struct cutest_buffer buffer[static 1], const char path[static 1], const char file[static 1]) {
+	const char *separator = strrchr(file, '/');
+	bool relative = path[0] != '/' && file[0] == '/' && separator != nullptr;
+	bool result = relative ? cutest_buffer_printf(buffer, "%.*s/%s", (int) (separator - file), file, path)
+	                       : cutest_buffer_printf(buffer, "%s", path);
+	if (!result) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
+
+#ifdef HAS_MMAP
+static bool golden_open(struct golden golden[static 1], const char path[static 1]) {
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		close(fd);
+		return false;
+	}
+	golden->size = (size_t) st.st_size;
+	golden->data = (const unsigned char *) "";
+	if (golden->size > 0) {
+		void *mapping = mmap(nullptr, golden->size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED) {
+			int error = errno;
+			close(fd);
+			*golden = (struct golden) {};
+			errno = error;
+			return false;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(mapping, golden->size, MADV_SEQUENTIAL);
+#endif
+		golden->mapping = mapping;
+		golden->data = mapping;
+	}
+	close(fd);
+	return true;
+}
+
+static void golden_close(struct golden golden[static 1]) {
+	if (golden->mapping != nullptr) {
+		munmap(golden->mapping, golden->size);
+	}
+	*golden = (struct golden) {};
+}
+
+/*
+ * Write a temporary file next to path and rename it over path, so that an
+ * interrupted update never leaves a truncated golden file.
+ */
+static bool golden_write(const char path[static 1], const void *data, size_t size) {
+	struct cutest_buffer temporary = {};
+	if (!cutest_buffer_printf(&temporary, "%s.XXXXXX", path)) {
+		return false;
+	}
+	int fd = mkstemp(temporary.data);
+	if (fd == -1) {
+		cutest_buffer_destroy(&temporary);
+		return false;
+	}
+	bool result = fchmod(fd, 0644) == 0;
+	for (size_t written = 0; result && written < size;) {
+		ssize_t n = write(fd, (const char *) data + written, size - written);
+		if (n == -1 && errno != EINTR) {
+			result = false;
+		}
+		written += (n > 0) ? (size_t) n : 0;
+	}
+	result = result && fsync(fd) == 0;
+	result = (close(fd) == 0) && result;
+	result = result && rename(temporary.data, path) == 0;
+	if (!result) {
+		int error = errno;
+		unlink(temporary.data);
+		errno = error;
+	}
+	cutest_buffer_destroy(&temporary);
+	return result;
+}
+#else
+static bool golden_open(struct golden golden[static 1], const char path[static 1]) {
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		return false;
+	}
+	char chunk[BUFSIZ];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof chunk, file)) > 0) {
+		if (!cutest_buffer_append(&golden->buffer, chunk, n)) {
+			fclose(file);
+			golden_close(golden);
+			return false;
+		}
+	}
+	bool result = !ferror(file);
+	fclose(file);
+	golden->data = (golden->buffer.data != nullptr) ? (const unsigned char *) golden->buffer.data : (const unsigned char *) "";
+	golden->size = golden->buffer.size;
+	return result;
+}
+
+static void golden_close(struct golden golden[static 1]) {
+	cutest_buffer_destroy(&golden->buffer);
+	*golden = (struct golden) {};
+}
+
+/*
+ * Without POSIX the file cannot be replaced atomically and is rewritten in
+ * place.
+ */
+static bool golden_write(const char path[static 1], const void *data, size_t size) {
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool result = fwrite(data, 1, size, file) == size;
+	return (fclose(file) == 0) && result;
+}
+#endif
+
+/*
+ * Whether the bytes of data from begin to end are printable text.
+ */
+static bool is_text(const unsigned char data[], size_t begin, size_t end) {
+	for (size_t i = begin; i < end; i++) {
+		if ((data[i] < 0x20 && data[i] != '\t' && data[i] != '\r' && data[i] != '\n') || data[i] == 0x7f) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void append_line_diff(struct cutest_buffer buffer[static 1],
+                             const unsigned char actual[],
+                             size_t actual_size,
+                             const unsigned char expected[],
+                             size_t expected_size,
+                             size_t first) {
+	size_t line = 1;
+	size_t line_begin = 0;
+	for (const unsigned char *c = actual; (c = memchr(c, '\n', first - (size_t) (c - actual))) != nullptr; c++) {
+		line++;
+		line_begin = (size_t) (c - actual) + 1;
+	}
+	append(buffer, "    line %zu, column %zu:\n", line, first - line_begin + 1);
+	append_line(buffer, "actual:  ", actual, actual_size, first);
+	append(buffer, "\n");
+	append_line(buffer, "expected:", expected, expected_size, first);
+}
+
+/*
+ * The part of the line of data holding the offset first, within LINE_CONTEXT
+ * bytes from it, or the end of the last line if data ends before first.
+ */
+static void append_line(struct cutest_buffer buffer[static 1],
+                        const char label[static 1],
+                        const unsigned char data[],
+                        size_t size,
+                        size_t first) {
+	size_t position = (first < size) ? first : size;
+	size_t begin = position;
+	for (; begin > 0 && data[begin - 1] != '\n' && position - begin < LINE_CONTEXT; begin--);
+	size_t end = position;
+	for (; end < size && data[end] != '\n' && end - position < LINE_CONTEXT; end++);
+	bool truncated_begin = begin > 0 && data[begin - 1] != '\n';
+	bool truncated_end = end < size && data[end] != '\n';
+	append(buffer,
+	       "    %s %s%.*s%s%s",
+	       label,
+	       truncated_begin ? "..." : "",
+	       (int) (end - begin),
+	       (const char *) data + begin,
+	       truncated_end ? "..." : "",
+	       (first >= size) ? "<end of file>" : "");
+}
+
+static void append(struct cutest_buffer buffer[static 1], const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	bool result = cutest_buffer_vprintf(buffer, format, args);
+	va_end(args);
+	if (!result) {
+		perror(strerror(errno));
+		exit(1);
+	}
+}
@@ -0,0 +1,144 @@
+#include "cutest_internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Registered listeners in registration order. Until the first change the
+ * registry points to a static array holding the console listener, so a run with
+ * the default listeners allocates nothing.
+ */
+static struct {
+	const struct cutest_listener **listener;
+	size_t size;
+	size_t capacity;
+	bool static_storage;
+} listeners = {
+	.listener = (const struct cutest_listener *[]) {&cutest_console_listener},
+	.size = 1,
+	.capacity = 1,
+	.static_storage = true,
+};
+
+static bool reserve(size_t required);
+
+extern bool cutest_listener_add(const struct cutest_listener listener[static 1]) {
+	if (!reserve(listeners.size + 1)) {
+		return false;
+	}
+	listeners.listener[listeners.size++] = listener;
+	return true;
+}
+
+extern bool cutest_listener_remove(const struct cutest_listener listener[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		if (listeners.listener[i] != listener) {
+			continue;
+		}
+		memmove(&listeners.listener[i], &listeners.listener[i + 1], (listeners.size - i - 1) * sizeof *listeners.listener);
+		listeners.size--;
+		return true;
+	}
+	return false;
+}
+
+extern void cutest_listeners_program_start(const struct cutest cutest[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_program_start != nullptr) {
+			listener->on_program_start(listener->context, cutest);
+		}
+	}
+}
+
+extern void cutest_listeners_suite_start(const struct cutest_test_suite suite[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_suite_start != nullptr) {
+			listener->on_suite_start(listener->context, suite);
+		}
+	}
+}
+
+extern void cutest_listeners_test_start(const struct cutest_test_suite suite[static 1],
+                                        const struct cutest_test test[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_test_start != nullptr) {
+			listener->on_test_start(listener->context, suite, test);
+		}
+	}
+}
+
+extern void cutest_listeners_assertion_failure(const struct cutest_test test[static 1],
+                                               const char file[static 1],
+                                               int line,
+                                               const char message[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_assertion_failure != nullptr) {
+			listener->on_assertion_failure(listener->context, test, file, line, message);
+		}
+	}
+}
+
+extern void cutest_listeners_test_end(const struct cutest_test_suite suite[static 1],
+                                      const struct cutest_test test[static 1],
+                                      const struct cutest_result result[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_test_end != nullptr) {
+			listener->on_test_end(listener->context, suite, test, result);
+		}
+	}
+}
+
+extern void cutest_listeners_suite_end(const struct cutest_test_suite suite[static 1],
+                                       const struct cutest_result result[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_suite_end != nullptr) {
+			listener->on_suite_end(listener->context, suite, result);
+		}
+	}
+}
+
+extern void cutest_listeners_program_end(const struct cutest cutest[static 1], const struct cutest_result result[static 1]) {
+	for (size_t i = 0; i < listeners.size; i++) {
+		const struct cutest_listener *listener = listeners.listener[i];
+		if (listener->on_program_end != nullptr) {
+			listener->on_program_end(listener->context, cutest, result);
+		}
+	}
+}
+
+/*
+ * Make room for required listeners, moving them out of the static array the
+ * first time it is outgrown.
+ */
+static bool reserve(size_t required) {
+	if (required <= listeners.capacity) {
+		return true;
+	}
+	size_t capacity = listeners.capacity;
+	while (capacity < required) {
+		capacity *= 2;
+	}
+	const struct cutest_listener **ptr;
+	if (listeners.static_storage) {
+		ptr = malloc(capacity * sizeof *ptr);
+		if (ptr != nullptr) {
+			memcpy(ptr, listeners.listener, listeners.size * sizeof *ptr);
+		}
+	}
+	else {
+		ptr = realloc(listeners.listener, capacity * sizeof *ptr);
+	}
+	if (ptr == nullptr) {
+		return false;
+	}
+	listeners.listener = ptr;
+	listeners.capacity = capacity;
+	listeners.static_storage = false;
+	return true;
+}
@@ -0,0 +1,5 @@
+#include "cutest_internal.h"
+
+extern int main(int argc, char *argv[argc + 1]) {
+	return cutest_main(argc, argv);
+}
@@ -0,0 +1,97 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Parameterized tests and instantiations in registration order. Each one is
+ * paired with the already registered ones of the other kind for the same
+ * suite, so the order of their constructors does not matter.
+ */
+static struct {
+	const struct cutest_test_descriptor **test;
+	size_t size;
+	size_t capacity;
+} parameterized_tests = {};
+
+static struct {
+	const struct cutest_parameters **parameters;
+	size_t size;
+	size_t capacity;
+} instantiations = {};
+
+static void *reserve(void *array, size_t size, size_t capacity[static 1], size_t element_size);
+static void register_instance(const struct cutest_test_descriptor descriptor[static 1],
+                              const struct cutest_parameters parameters[static 1]);
+
+extern void cutest_test_p_register_(const struct cutest_test_descriptor descriptor[static 1]) {
+	parameterized_tests.test = reserve(parameterized_tests.test,
+	                                   parameterized_tests.size,
+	                                   &parameterized_tests.capacity,
+	                                   sizeof *parameterized_tests.test);
+	parameterized_tests.test[parameterized_tests.size++] = descriptor;
+	for (size_t i = 0; i < instantiations.size; i++) {
+		if (strcmp(instantiations.parameters[i]->suite_name, descriptor->suite_name) == 0) {
+			register_instance(descriptor, instantiations.parameters[i]);
+		}
+	}
+}
+
+extern void cutest_parameters_register_(const struct cutest_parameters parameters[static 1]) {
+	instantiations.parameters = reserve(instantiations.parameters,
+	                                    instantiations.size,
+	                                    &instantiations.capacity,
+	                                    sizeof *instantiations.parameters);
+	instantiations.parameters[instantiations.size++] = parameters;
+	for (size_t i = 0; i < parameterized_tests.size; i++) {
+		if (strcmp(parameterized_tests.test[i]->suite_name, parameters->suite_name) == 0) {
+			register_instance(parameterized_tests.test[i], parameters);
+		}
+	}
+}
+
+/*
+ * Values are read in place, generated ones are computed into storage, which
+ * holds size bytes, the size of the parameter type.
+ */
+extern const void *cutest_parameter_get_(void *storage, size_t size) {
+	struct cutest_test *test = cutest_test_current();
+	// There is no value to return, and no test to report the failure against.
+	if (test == nullptr || test->parameters == nullptr) {
+		fprintf(stderr, "Parameterized tests must be run by the runner, or from a thread attached to their test.\n");
+		abort();
+	}
+	const struct cutest_parameters *parameters = test->parameters;
+	if (parameters->values == nullptr) {
+		parameters->generate(test->parameter, storage);
+		return storage;
+	}
+	// The instantiation checked that the values have the type of storage.
+	return (const char *) parameters->values + test->parameter * size;
+}
+
+static void *reserve(void *array, size_t size, size_t capacity[static 1], size_t element_size) {
+	if (size < *capacity) {
+		return array;
+	}
+	size_t new_capacity = *capacity ? *capacity * 2 : 4;
+	void *ptr = realloc(array, new_capacity * element_size);
+	if (ptr == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	*capacity = new_capacity;
+	return ptr;
+}
+
+static void register_instance(const struct cutest_test_descriptor descriptor[static 1],
+                              const struct cutest_parameters parameters[static 1]) {
+	struct cutest_test_descriptor instance = *descriptor;
+	instance.suite_name = parameters->name;
+	instance.parameters = parameters;
+	cutest_test_register_(&instance);
+}
@@ -0,0 +1,248 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <string.h>
+
+#if __has_include(<linux/perf_event.h>) && __has_include(<sys/ioctl.h>) && __has_include(<sys/syscall.h>) \
+    && __has_include(<unistd.h>)
+#define HAS_PERF_EVENT 1
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+struct perf_event {
+	const char *name;
+	uint32_t type;
+	uint64_t config;
+};
+
+static const struct perf_event perf_event[CUTEST_PERF_EVENTS] = {
+#ifdef HAS_PERF_EVENT
+	[CUTEST_PERF_INSTRUCTIONS] = {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+	[CUTEST_PERF_CYCLES] = {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+	[CUTEST_PERF_CACHE_MISSES] = {"cache-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+	[CUTEST_PERF_BRANCH_MISSES] = {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+	[CUTEST_PERF_TASK_CLOCK] = {"task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+	[CUTEST_PERF_PAGE_FAULTS] = {"page-faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+	[CUTEST_PERF_CONTEXT_SWITCHES] = {"context-switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+#else
+	[CUTEST_PERF_INSTRUCTIONS] = {"instructions"},
+	[CUTEST_PERF_CYCLES] = {"cycles"},
+	[CUTEST_PERF_CACHE_MISSES] = {"cache-misses"},
+	[CUTEST_PERF_BRANCH_MISSES] = {"branch-misses"},
+	[CUTEST_PERF_TASK_CLOCK] = {"task-clock"},
+	[CUTEST_PERF_PAGE_FAULTS] = {"page-faults"},
+	[CUTEST_PERF_CONTEXT_SWITCHES] = {"context-switches"},
+#endif
+};
+
+/*
+ * Software events counted in place of the requested ones when the hardware
+ * counters cannot be opened, as is common in containers and virtual machines.
+ */
+static constexpr unsigned software_fallback = (1U << CUTEST_PERF_TASK_CLOCK)
+                                            | (1U << CUTEST_PERF_PAGE_FAULTS)
+                                            | (1U << CUTEST_PERF_CONTEXT_SWITCHES);
+
+#ifdef HAS_PERF_EVENT
+static int perf_event_open(enum cutest_perf_event event, int group_fd);
+static bool perf_event_is_hardware(enum cutest_perf_event event);
+#endif
+[[gnu::format(printf, 1, 2)]]
+static void note(const char *format, ...);
+
+extern const char *cutest_perf_event_name(enum cutest_perf_event event) {
+	return perf_event[event].name;
+}
+
+extern bool cutest_perf_event_parse(const char name[static 1], size_t length, enum cutest_perf_event event[static 1]) {
+	for (size_t i = 0; i < CUTEST_PERF_EVENTS; i++) {
+		if (strlen(perf_event[i].name) == length && strncmp(perf_event[i].name, name, length) == 0) {
+			*event = (enum cutest_perf_event) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+extern bool cutest_perf_open(struct cutest_perf_counters counters[static 1], unsigned events) {
+	*counters = (struct cutest_perf_counters) {.leader = -1};
+#ifdef HAS_PERF_EVENT
+	for (size_t i = 0; i < CUTEST_PERF_EVENTS; i++) {
+		if (!(events & (1U << i))) {
+			continue;
+		}
+		int fd = perf_event_open((enum cutest_perf_event) i, counters->leader);
+		if (fd == -1) {
+			counters->hardware_unavailable |= perf_event_is_hardware((enum cutest_perf_event) i);
+			continue;
+		}
+		if (counters->leader == -1) {
+			counters->leader = fd;
+		}
+		counters->event[counters->size] = (enum cutest_perf_event) i;
+		counters->fd[counters->size] = fd;
+		counters->size++;
+	}
+	if (counters->hardware_unavailable) {
+		for (size_t i = 0; i < CUTEST_PERF_EVENTS; i++) {
+			if (!(software_fallback & ~events & (1U << i))) {
+				continue;
+			}
+			int fd = perf_event_open((enum cutest_perf_event) i, counters->leader);
+			if (fd == -1) {
+				continue;
+			}
+			if (counters->leader == -1) {
+				counters->leader = fd;
+			}
+			counters->event[counters->size] = (enum cutest_perf_event) i;
+			counters->fd[counters->size] = fd;
+			counters->size++;
+		}
+	}
+#else
+	(void) events;
+	counters->hardware_unavailable = true;
+#endif
+	return counters->size != 0;
+}
+
+extern void cutest_perf_start(struct cutest_perf_counters counters[static 1]) {
+#ifdef HAS_PERF_EVENT
+	if (counters->leader != -1) {
+		ioctl(counters->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(counters->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#else
+	(void) counters;
+#endif
+}
+
+extern bool cutest_perf_stop(struct cutest_perf_counters counters[static 1], uint64_t count[static CUTEST_PERF_EVENTS]) {
+#ifdef HAS_PERF_EVENT
+	if (counters->leader == -1) {
+		return false;
+	}
+	ioctl(counters->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	// With PERF_FORMAT_GROUP the leader reads as the number of events, the
+	// times the group was enabled and running, then one value per event.
+	uint64_t data[3 + CUTEST_PERF_EVENTS];
+	ssize_t size = read(counters->leader, data, sizeof data);
+	if (size < (ssize_t) (3 * sizeof *data) || data[0] != counters->size || data[2] == 0) {
+		return false;
+	}
+	// Scale the counts when the kernel multiplexed the group with others.
+	double scale = (double) data[1] / (double) data[2];
+	for (size_t i = 0; i < counters->size; i++) {
+		count[counters->event[i]] = (uint64_t) ((double) data[3 + i] * scale);
+	}
+	return true;
+#else
+	(void) counters;
+	(void) count;
+	return false;
+#endif
+}
+
+extern void cutest_perf_close(struct cutest_perf_counters counters[static 1]) {
+#ifdef HAS_PERF_EVENT
+	for (size_t i = 0; i < counters->size; i++) {
+		close(counters->fd[i]);
+	}
+#endif
+	*counters = (struct cutest_perf_counters) {.leader = -1};
+}
+
+extern struct cutest_perf_scope_ cutest_perf_scope_begin_() {
+	struct cutest_perf_scope_ scope = {.running = true};
+	struct cutest_perf_counters counters;
+	if (cutest_perf_open(&counters, 1U << CUTEST_PERF_INSTRUCTIONS)) {
+		if (counters.event[0] == CUTEST_PERF_INSTRUCTIONS) {
+			scope.fd = counters.fd[0];
+			scope.available = true;
+			cutest_perf_start(&counters);
+			return scope;
+		}
+		cutest_perf_close(&counters);
+	}
+	return scope;
+}
+
+extern bool cutest_perf_scope_end_(struct cutest_perf_scope_ scope[static 1],
+                                   uint64_t budget,
+                                   const char budget_expression[static 1],
+                                   const char test_function_name[static 8],
+                                   const char file[static 1],
+                                   int line) {
+	scope->running = false;
+	if (!scope->available) {
+		note("%s:%d: Instruction counter unavailable, skipping the instruction budget of %s.", file, line, budget_expression);
+		return true;
+	}
+	struct cutest_perf_counters counters = {
+		.event = {CUTEST_PERF_INSTRUCTIONS},
+		.fd = {scope->fd},
+		.size = 1,
+		.leader = scope->fd,
+	};
+	uint64_t count[CUTEST_PERF_EVENTS] = {};
+	bool measured = cutest_perf_stop(&counters, count);
+	cutest_perf_close(&counters);
+	if (!measured) {
+		note("%s:%d: Instruction counter could not be read, skipping the instruction budget of %s.",
+		     file,
+		     line,
+		     budget_expression);
+		return true;
+	}
+	if (count[CUTEST_PERF_INSTRUCTIONS] > budget) {
+		cutest_test_fail_(test_function_name,
+		                  file,
+		                  line,
+		                  "Expected the block to retire at most %s instructions.\n"
+		                  "  Actual: %" PRIu64 " instructions, budget %" PRIu64 ".",
+		                  budget_expression,
+		                  count[CUTEST_PERF_INSTRUCTIONS],
+		                  budget);
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Unlike cutest_test_note_(), which carries the message of a failed assertion,
+ * this only informs about the measurement.
+ */
+static void note(const char *format, ...) {
+	va_list args;
+	va_start(args, format);
+	cutest_output_vprintf(stderr, format, args);
+	va_end(args);
+	cutest_output_printf(stderr, "\n");
+}
+
+#ifdef HAS_PERF_EVENT
+static int perf_event_open(enum cutest_perf_event event, int group_fd) {
+	struct perf_event_attr attr = {
+		.type = perf_event[event].type,
+		.size = sizeof attr,
+		.config = perf_event[event].config,
+		.disabled = group_fd == -1,
+		.exclude_kernel = 1,
+		.exclude_hv = 1,
+		.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING,
+	};
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+static bool perf_event_is_hardware(enum cutest_perf_event event) {
+	return perf_event[event].type == PERF_TYPE_HARDWARE;
+}
+#endif
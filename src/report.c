@@ -0,0 +1,493 @@
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#if __has_include(<pthread.h>) && __has_include(<sys/mman.h>)
+#define HAS_SHARED_STATE 1
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
+/*
+ * State of a report shared by all its writers, in shared memory when the
+ * platform can fork so that worker processes and isolated tests append to the
+ * same file. The XML element of the suite of the last record is left open, and
+ * the trailer closing the document is overwritten by the next record. Records
+ * of interleaved suites open a new element each time, until the report is
+ * closed and rewritten from its index, see rewrite_xml().
+ */
+struct cutest_report_state {
+#ifdef HAS_SHARED_STATE
+	pthread_mutex_t lock;
+#else
+	mtx_t lock;
+#endif
+	const char *suite_name;
+	size_t trailer_length;
+	int error;
+};
+
+static const char xml_header[] = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<testsuites name=\"AllTests\">\n";
+static const char xml_trailer[] = "</testsuites>\n";
+static const char xml_suite_trailer[] = "  </testsuite>\n</testsuites>\n";
+
+/*
+ * Where a testcase element is in the report, followed in the index by the
+ * escaped name of its suite.
+ */
+struct index_entry {
+	long offset;
+	size_t size;
+	size_t suite_name_size;
+	bool failed;
+	double time;
+};
+
+/*
+ * An index entry read back, with its suite name in a shared buffer.
+ */
+struct record {
+	struct index_entry entry;
+	size_t suite_name;
+	bool written;
+};
+
+static struct cutest_report_state *state_create();
+static void state_destroy(struct cutest_report_state state[static 1]);
+static void state_lock(struct cutest_report_state state[static 1]);
+static void state_unlock(struct cutest_report_state state[static 1]);
+static bool format_xml(struct cutest_buffer buffer[static 1], const struct cutest_report_record record[static 1]);
+static bool format_jsonl(struct cutest_buffer buffer[static 1], const struct cutest_report_record record[static 1]);
+static bool xml_escape(struct cutest_buffer buffer[static 1], const char text[static 1]);
+static bool xml_cdata(struct cutest_buffer buffer[static 1], const char text[static 1]);
+static bool rewrite_xml(struct cutest_report report[static 1], size_t tests, size_t failures, double time);
+static bool read_records(FILE *index, size_t size[static 1], struct record *record[static 1], struct cutest_buffer names[static 1]);
+static bool read_data(FILE *file, size_t size, struct cutest_buffer buffer[static 1]);
+
+extern bool cutest_report_open(struct cutest_report report[static 1], const char output[static 1]) {
+	*report = (struct cutest_report) {};
+	const char *path;
+	if (strncmp(output, "xml:", 4) == 0) {
+		report->format = CUTEST_REPORT_XML;
+		path = output + 4;
+	}
+	else if (strncmp(output, "jsonl:", 6) == 0) {
+		report->format = CUTEST_REPORT_JSONL;
+		path = output + 6;
+	}
+	else {
+		errno = EINVAL;
+		return false;
+	}
+	report->state = state_create();
+	if (report->state == nullptr) {
+		return false;
+	}
+	report->path = path;
+	report->file = fopen(path, "w+b");
+	if (report->file == nullptr) {
+		state_destroy(report->state);
+		*report = (struct cutest_report) {};
+		return false;
+	}
+	if (report->format == CUTEST_REPORT_XML && (report->index = tmpfile()) == nullptr) {
+		int error = errno;
+		fclose(report->file);
+		state_destroy(report->state);
+		*report = (struct cutest_report) {};
+		errno = error;
+		return false;
+	}
+	// Records are flushed whole, each in a single write as long as it fits.
+	setvbuf(report->file, nullptr, _IOFBF, 65536);
+	if (report->format == CUTEST_REPORT_XML) {
+		fputs(xml_header, report->file);
+		fputs(xml_trailer, report->file);
+		report->state->trailer_length = sizeof xml_trailer - 1;
+	}
+	if (fflush(report->file) != 0) {
+		int error = errno;
+		fclose(report->file);
+		if (report->index != nullptr) {
+			fclose(report->index);
+		}
+		state_destroy(report->state);
+		*report = (struct cutest_report) {};
+		errno = error;
+		return false;
+	}
+	return true;
+}
+
+extern void cutest_report_test(struct cutest_report report[static 1], const struct cutest_report_record record[static 1]) {
+	struct cutest_report_state *state = report->state;
+	struct cutest_buffer record_data = {};
+	bool formatted = (report->format == CUTEST_REPORT_XML) ? format_xml(&record_data, record)
+	                                                       : format_jsonl(&record_data, record);
+	state_lock(state);
+	if (!formatted) {
+		state->error = ENOMEM;
+		state_unlock(state);
+		cutest_buffer_destroy(&record_data);
+		return;
+	}
+	if (report->format == CUTEST_REPORT_XML) {
+		bool same_suite = state->suite_name != nullptr && strcmp(state->suite_name, record->suite_name) == 0;
+		struct cutest_buffer name = {};
+		if (!xml_escape(&name, record->suite_name)) {
+			state->error = ENOMEM;
+		}
+		fseek(report->file, -(long) state->trailer_length, SEEK_END);
+		if (!same_suite) {
+			if (state->suite_name != nullptr) {
+				fputs("  </testsuite>\n", report->file);
+			}
+			fputs("  <testsuite name=\"", report->file);
+			fwrite(name.data, 1, name.size, report->file);
+			fputs("\">\n", report->file);
+		}
+		struct index_entry entry = {
+			.offset = ftell(report->file),
+			.size = record_data.size,
+			.suite_name_size = name.size,
+			.failed = !record->result,
+			.time = record->wall_time,
+		};
+		fwrite(record_data.data, 1, record_data.size, report->file);
+		fputs(xml_suite_trailer, report->file);
+		fseek(report->index, 0, SEEK_END);
+		fwrite(&entry, sizeof entry, 1, report->index);
+		fwrite(name.data, 1, name.size, report->index);
+		if (fflush(report->index) != 0 && state->error == 0) {
+			state->error = errno;
+		}
+		cutest_buffer_destroy(&name);
+		state->suite_name = record->suite_name;
+		state->trailer_length = sizeof xml_suite_trailer - 1;
+	}
+	else {
+		fseek(report->file, 0, SEEK_END);
+		fwrite(record_data.data, 1, record_data.size, report->file);
+	}
+	if (fflush(report->file) != 0 && state->error == 0) {
+		state->error = errno;
+	}
+	state_unlock(state);
+	cutest_buffer_destroy(&record_data);
+}
+
+extern bool cutest_report_close(struct cutest_report report[static 1], size_t tests, size_t failures, double time) {
+	if (report->format == CUTEST_REPORT_JSONL) {
+		fseek(report->file, 0, SEEK_END);
+		fprintf(report->file,
+		        "{\"type\":\"summary\",\"tests\":%zu,\"failures\":%zu,\"time_ms\":%.3f}\n",
+		        tests,
+		        failures,
+		        time);
+	}
+	int error = report->state->error;
+	if (report->format == CUTEST_REPORT_XML) {
+		if (error == 0 && !rewrite_xml(report, tests, failures, time)) {
+			error = errno;
+		}
+		fclose(report->index);
+	}
+	if (report->file != nullptr && fclose(report->file) != 0 && error == 0) {
+		error = errno;
+	}
+	state_destroy(report->state);
+	*report = (struct cutest_report) {};
+	errno = error;
+	return error == 0;
+}
+
+static struct cutest_report_state *state_create() {
+	struct cutest_report_state *state;
+#ifdef HAS_SHARED_STATE
+	state = mmap(nullptr, sizeof *state, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (state == MAP_FAILED) {
+		return nullptr;
+	}
+	*state = (struct cutest_report_state) {};
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutex_init(&state->lock, &attr);
+	pthread_mutexattr_destroy(&attr);
+#else
+	state = malloc(sizeof *state);
+	if (state == nullptr) {
+		return nullptr;
+	}
+	*state = (struct cutest_report_state) {};
+	mtx_init(&state->lock, mtx_plain);
+#endif
+	return state;
+}
+
+static void state_destroy(struct cutest_report_state state[static 1]) {
+#ifdef HAS_SHARED_STATE
+	pthread_mutex_destroy(&state->lock);
+	munmap(state, sizeof *state);
+#else
+	mtx_destroy(&state->lock);
+	free(state);
+#endif
+}
+
+static void state_lock(struct cutest_report_state state[static 1]) {
+#ifdef HAS_SHARED_STATE
+	pthread_mutex_lock(&state->lock);
+#else
+	mtx_lock(&state->lock);
+#endif
+}
+
+static void state_unlock(struct cutest_report_state state[static 1]) {
+#ifdef HAS_SHARED_STATE
+	pthread_mutex_unlock(&state->lock);
+#else
+	mtx_unlock(&state->lock);
+#endif
+}
+
+/*
+ * A JUnit testcase element laid out as the ones of Google Test, with each
+ * failure both in the message attribute and in the element text.
+ */
+static bool format_xml(struct cutest_buffer buffer[static 1], const struct cutest_report_record record[static 1]) {
+	bool result = cutest_buffer_printf(buffer, "    <testcase name=\"") && xml_escape(buffer, record->test->name);
+	if (record->test->file != nullptr) {
+		result = result && cutest_buffer_printf(buffer, "\" file=\"") && xml_escape(buffer, record->test->file)
+		      && cutest_buffer_printf(buffer, "\" line=\"%d", record->test->line);
+	}
+	result = result
+	      && cutest_buffer_printf(buffer,
+	                              "\" status=\"run\" result=\"completed\" time=\"%.3f\" classname=\"",
+	                              record->wall_time / 1e3)
+	      && xml_escape(buffer, record->suite_name);
+	if (record->result) {
+		return result && cutest_buffer_printf(buffer, "\" />\n");
+	}
+	result = result && cutest_buffer_printf(buffer, "\">\n");
+	const struct cutest_failures *failures = record->failures;
+	for (size_t i = 0; failures != nullptr && i < failures->size; i++) {
+		const struct cutest_failure *failure = &failures->failure[i];
+		struct cutest_buffer text = {};
+		if (failure->file != nullptr) {
+			result = result && cutest_buffer_printf(&text, "%s:%d\n", failure->file, failure->line);
+		}
+		result = result && cutest_buffer_printf(&text, "%s", &failures->message.data[failure->message])
+		      && cutest_buffer_printf(buffer, "      <failure message=\"") && xml_escape(buffer, text.data)
+		      && cutest_buffer_printf(buffer, "\" type=\"\">") && xml_cdata(buffer, text.data)
+		      && cutest_buffer_printf(buffer, "</failure>\n");
+		cutest_buffer_destroy(&text);
+	}
+	// A test can fail without a failed assertion, e.g. from a slowdown.
+	if (failures == nullptr || failures->size == 0) {
+		result = result && cutest_buffer_printf(buffer, "      <failure message=\"Test failed\" type=\"\" />\n");
+	}
+	return result && cutest_buffer_printf(buffer, "    </testcase>\n");
+}
+
+static bool format_jsonl(struct cutest_buffer buffer[static 1], const struct cutest_report_record record[static 1]) {
+	bool result = cutest_buffer_printf(buffer, "{\"type\":\"test\",\"suite\":\"") && cutest_buffer_append_json(buffer, record->suite_name)
+	           && cutest_buffer_printf(buffer, "\",\"name\":\"") && cutest_buffer_append_json(buffer, record->test->name)
+	           && cutest_buffer_printf(buffer, "\"");
+	if (record->test->file != nullptr) {
+		result = result && cutest_buffer_printf(buffer, ",\"file\":\"") && cutest_buffer_append_json(buffer, record->test->file)
+		      && cutest_buffer_printf(buffer, "\",\"line\":%d", record->test->line);
+	}
+	result = result
+	      && cutest_buffer_printf(buffer,
+	                              ",\"result\":\"%s\",\"time_ms\":%.3f,\"cpu_ms\":%.3f,\"failures\":[",
+	                              record->result ? "passed" : "failed",
+	                              record->wall_time,
+	                              record->cpu_time);
+	const struct cutest_failures *failures = record->failures;
+	for (size_t i = 0; failures != nullptr && i < failures->size; i++) {
+		const struct cutest_failure *failure = &failures->failure[i];
+		result = result && cutest_buffer_printf(buffer, "%s{", (i > 0) ? "," : "");
+		if (failure->file != nullptr) {
+			result = result && cutest_buffer_printf(buffer, "\"file\":\"") && cutest_buffer_append_json(buffer, failure->file)
+			      && cutest_buffer_printf(buffer, "\",\"line\":%d,", failure->line);
+		}
+		result = result && cutest_buffer_printf(buffer, "\"message\":\"")
+		      && cutest_buffer_append_json(buffer, &failures->message.data[failure->message]) && cutest_buffer_printf(buffer, "\"}");
+	}
+	return result && cutest_buffer_printf(buffer, "]}\n");
+}
+
+/*
+ * Rewrite the report with the testcase elements of each suite under a single
+ * testsuite element, in the order the suites were first reported, and with the
+ * counts Google Test writes on the testsuites and testsuite elements. The
+ * file is closed, and reopened truncated since the document can shrink.
+ */
+static bool rewrite_xml(struct cutest_report report[static 1], size_t tests, size_t failures, double time) {
+	struct cutest_buffer content = {};
+	struct cutest_buffer names = {};
+	struct cutest_buffer document = {};
+	struct record *record = nullptr;
+	size_t size = 0;
+	bool result = fflush(report->file) == 0 && fseek(report->file, 0, SEEK_SET) == 0
+	           && read_data(report->file, SIZE_MAX, &content) && read_records(report->index, &size, &record, &names)
+	           && cutest_buffer_printf(&document,
+	                                   "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	                                   "<testsuites tests=\"%zu\" failures=\"%zu\" time=\"%.3f\" name=\"AllTests\">\n",
+	                                   tests,
+	                                   failures,
+	                                   time / 1e3);
+	for (size_t i = 0; result && i < size; i++) {
+		if (record[i].written) {
+			continue;
+		}
+		const char *suite_name = &names.data[record[i].suite_name];
+		size_t suite_tests = 0;
+		size_t suite_failures = 0;
+		double suite_time = 0;
+		for (size_t j = i; j < size; j++) {
+			if (!record[j].written && strcmp(&names.data[record[j].suite_name], suite_name) == 0) {
+				suite_tests++;
+				suite_failures += record[j].entry.failed;
+				suite_time += record[j].entry.time;
+			}
+		}
+		result = cutest_buffer_printf(&document,
+		                              "  <testsuite name=\"%s\" tests=\"%zu\" failures=\"%zu\" time=\"%.3f\">\n",
+		                              suite_name,
+		                              suite_tests,
+		                              suite_failures,
+		                              suite_time / 1e3);
+		for (size_t j = i; result && j < size; j++) {
+			const struct index_entry *entry = &record[j].entry;
+			if (record[j].written || strcmp(&names.data[record[j].suite_name], suite_name) != 0) {
+				continue;
+			}
+			record[j].written = true;
+			if (entry->offset < 0 || (size_t) entry->offset + entry->size > content.size) {
+				errno = EIO;
+				result = false;
+				break;
+			}
+			result = cutest_buffer_append(&document, &content.data[entry->offset], entry->size);
+		}
+		result = result && cutest_buffer_printf(&document, "  </testsuite>\n");
+	}
+	result = result && cutest_buffer_printf(&document, "%s", xml_trailer);
+	int error = errno;
+	free(record);
+	cutest_buffer_destroy(&names);
+	cutest_buffer_destroy(&content);
+	if (!result) {
+		cutest_buffer_destroy(&document);
+		errno = error;
+		return false;
+	}
+	bool closed = fclose(report->file) == 0;
+	report->file = nullptr;
+	FILE *file = closed ? fopen(report->path, "wb") : nullptr;
+	result = file != nullptr && fwrite(document.data, 1, document.size, file) == document.size;
+	error = errno;
+	if (file != nullptr && fclose(file) != 0 && result) {
+		error = errno;
+		result = false;
+	}
+	cutest_buffer_destroy(&document);
+	errno = error;
+	return result;
+}
+
+/*
+ * Read the index of a report, with each suite name terminated in names.
+ */
+static bool read_records(FILE *index, size_t size[static 1], struct record *record[static 1], struct cutest_buffer names[static 1]) {
+	size_t capacity = 0;
+	struct index_entry entry;
+	rewind(index);
+	while (fread(&entry, sizeof entry, 1, index) == 1) {
+		if (*size == capacity) {
+			capacity = capacity ? capacity * 2 : 64;
+			struct record *larger = realloc(*record, capacity * sizeof **record);
+			if (larger == nullptr) {
+				return false;
+			}
+			*record = larger;
+		}
+		(*record)[*size] = (struct record) {.entry = entry, .suite_name = names->size};
+		size_t names_size = names->size;
+		if (!read_data(index, entry.suite_name_size, names) || names->size - names_size != entry.suite_name_size) {
+			errno = EIO;
+			return false;
+		}
+		if (!cutest_buffer_append(names, "", 1)) {
+			return false;
+		}
+		++*size;
+	}
+	return !ferror(index);
+}
+
+/*
+ * Append up to size bytes read from file, less at its end.
+ */
+static bool read_data(FILE *file, size_t size, struct cutest_buffer buffer[static 1]) {
+	char data[BUFSIZ];
+	size_t read;
+	while (size > 0 && (read = fread(data, 1, (size < sizeof data) ? size : sizeof data, file)) > 0) {
+		if (!cutest_buffer_append(buffer, data, read)) {
+			return false;
+		}
+		size -= read;
+	}
+	return !ferror(file);
+}
+
+/*
+ * Characters not allowed in XML 1.0 documents are dropped.
+ */
+static bool xml_escape(struct cutest_buffer buffer[static 1], const char text[static 1]) {
+	static const char *const entity[UCHAR_MAX + 1] = {
+		['&'] = "&amp;",   ['<'] = "&lt;",     ['>'] = "&gt;",     ['"'] = "&quot;",
+		['\''] = "&apos;", ['\n'] = "&#x0A;", ['\t'] = "&#x09;", ['\r'] = "&#x0D;",
+	};
+	for (const unsigned char *c = (const unsigned char *) text; *c != '\0'; c++) {
+		if (entity[*c] != nullptr) {
+			if (!cutest_buffer_append(buffer, entity[*c], strlen(entity[*c]))) {
+				return false;
+			}
+		}
+		else if (*c >= 0x20 && !cutest_buffer_append(buffer, c, 1)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * A CDATA section cannot contain "]]>", which is split across two sections.
+ */
+static bool xml_cdata(struct cutest_buffer buffer[static 1], const char text[static 1]) {
+	if (!cutest_buffer_printf(buffer, "<![CDATA[")) {
+		return false;
+	}
+	for (const char *c = text; *c != '\0'; c++) {
+		if (strncmp(c, "]]>", 3) == 0) {
+			if (!cutest_buffer_printf(buffer, "]]>]]&gt;<![CDATA[")) {
+				return false;
+			}
+			c += 2;
+		}
+		else if (((unsigned char) *c >= 0x20 || *c == '\n' || *c == '\t' || *c == '\r')
+		         && !cutest_buffer_append(buffer, c, 1)) {
+			return false;
+		}
+	}
+	return cutest_buffer_printf(buffer, "]]>");
+}
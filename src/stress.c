@@ -0,0 +1,232 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+
+#if __has_include(<sched.h>)
+#include <sched.h>
+#ifdef CPU_SET
+#define HAS_AFFINITY
+#endif
+#endif
+
+/*
+ * Latencies are counted in a log-linear histogram: values below SUB_BUCKETS
+ * nanoseconds exactly, the others in SUB_BUCKETS buckets per power of two, so
+ * that the percentiles are within 12.5% of the measured ones.
+ */
+enum {
+	SUB_BUCKETS = 8,
+	SUB_BUCKET_BITS = 3,
+	HISTOGRAM_SIZE = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) * SUB_BUCKETS,
+};
+
+/*
+ * State shared by the threads of a run: the ready threads wait behind the
+ * start barrier until every thread is ready.
+ */
+struct stress {
+	void (*body)(void *context, size_t thread, size_t iteration);
+	void *context;
+	size_t iterations;
+	struct cutest_thread_context thread_context;
+	atomic_size_t ready;
+	atomic_bool start;
+};
+
+struct worker {
+	struct stress *stress;
+	size_t index;
+	uint64_t end_time;
+	uint64_t max;
+	uint64_t histogram[HISTOGRAM_SIZE];
+};
+
+static int worker_run(void *arg);
+static void pin(size_t index);
+static size_t bucket(uint64_t value);
+static uint64_t bucket_value(size_t bucket);
+static uint64_t percentile(const uint64_t histogram[static HISTOGRAM_SIZE], size_t count, double p);
+static void print_worker(const struct worker worker[static 1], uint64_t p50, uint64_t p90, uint64_t p99);
+
+/*
+ * The calling thread only starts the threads and waits for them, so that they
+ * can all be pinned to a CPU of their own when there are enough.
+ */
+extern struct cutest_stress_result cutest_stress_(size_t threads,
+                                                  size_t iterations,
+                                                  void body(void *context, size_t thread, size_t iteration),
+                                                  void *context,
+                                                  const char test_function_name[static 8],
+                                                  const char file[static 1],
+                                                  int line) {
+	struct stress stress = {
+		.body = body,
+		.context = context,
+		.iterations = iterations,
+		.thread_context = cutest_thread_context(),
+	};
+	struct worker *worker = calloc(threads, sizeof *worker);
+	thrd_t *thread = malloc(threads * sizeof *thread);
+	if ((worker == nullptr || thread == nullptr) && threads > 0) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t started = 0;
+	for (; started < threads; started++) {
+		worker[started] = (struct worker) {.stress = &stress, .index = started};
+		if (thrd_create(&thread[started], worker_run, &worker[started]) != thrd_success) {
+			break;
+		}
+	}
+	while (atomic_load_explicit(&stress.ready, memory_order_acquire) < started) {
+		thrd_yield();
+	}
+	uint64_t start_time = cutest_clock_now();
+	atomic_store_explicit(&stress.start, true, memory_order_release);
+	for (size_t i = 0; i < started; i++) {
+		thrd_join(thread[i], nullptr);
+	}
+	free(thread);
+	if (started < threads) {
+		free(worker);
+		cutest_test_fail_(test_function_name, file, line, "Could not start the %zu threads of the stress test.", threads);
+		cutest_test_fail_end_();
+		return (struct cutest_stress_result) {};
+	}
+	uint64_t end_time = start_time;
+	for (size_t i = 0; i < threads; i++) {
+		end_time = (worker[i].end_time > end_time) ? worker[i].end_time : end_time;
+	}
+	struct cutest_stress_result result = {
+		.seconds = (double) (end_time - start_time) / 1e9,
+	};
+	result.throughput = (result.seconds > 0) ? (double) (threads * iterations) / result.seconds : 0;
+	cutest_output_printf(stdout,
+	                     "[   STRESS ] %s:%d %zu threads x %zu iterations in %.3f s, %.0f iterations/s\n",
+	                     file,
+	                     line,
+	                     threads,
+	                     iterations,
+	                     result.seconds,
+	                     result.throughput);
+	for (size_t i = 0; i < threads; i++) {
+		uint64_t p50 = percentile(worker[i].histogram, iterations, 0.50);
+		uint64_t p90 = percentile(worker[i].histogram, iterations, 0.90);
+		uint64_t p99 = percentile(worker[i].histogram, iterations, 0.99);
+		print_worker(&worker[i], p50, p90, p99);
+		result.p50 = (p50 > result.p50) ? p50 : result.p50;
+		result.p90 = (p90 > result.p90) ? p90 : result.p90;
+		result.p99 = (p99 > result.p99) ? p99 : result.p99;
+		result.max = (worker[i].max > result.max) ? worker[i].max : result.max;
+	}
+	free(worker);
+	return result;
+}
+
+static int worker_run(void *arg) {
+	struct worker *worker = arg;
+	struct stress *stress = worker->stress;
+	pin(worker->index);
+	cutest_thread_attach(stress->thread_context);
+	atomic_fetch_add_explicit(&stress->ready, 1, memory_order_release);
+	while (!atomic_load_explicit(&stress->start, memory_order_acquire)) {
+		thrd_yield();
+	}
+	uint64_t time = cutest_clock_now();
+	for (size_t i = 0; i < stress->iterations; i++) {
+		stress->body(stress->context, worker->index, i);
+		uint64_t now = cutest_clock_now();
+		uint64_t latency = now - time;
+		worker->histogram[bucket(latency)]++;
+		worker->max = (latency > worker->max) ? latency : worker->max;
+		time = now;
+	}
+	worker->end_time = time;
+	cutest_test_fail_end_();
+	cutest_thread_attach((struct cutest_thread_context) {});
+	return 0;
+}
+
+/*
+ * Pin the calling thread to the CPU of index among the ones it may run on,
+ * going round them when there are more threads than CPUs. Pinning is best
+ * effort, and the thread runs anywhere when it fails.
+ */
+#ifdef HAS_AFFINITY
+static void pin(size_t index) {
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof allowed, &allowed) == -1 || CPU_COUNT(&allowed) == 0) {
+		return;
+	}
+	size_t n = index % (size_t) CPU_COUNT(&allowed);
+	for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed) && n-- == 0) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(cpu, &set);
+			sched_setaffinity(0, sizeof set, &set);
+			return;
+		}
+	}
+}
+#else
+static void pin(size_t index) {
+	(void) index;
+}
+#endif
+
+static size_t bucket(uint64_t value) {
+	if (value < SUB_BUCKETS) {
+		return (size_t) value;
+	}
+	size_t exponent = 63 - (size_t) __builtin_clzll(value);
+	size_t sub_bucket = (size_t) (value >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+	return SUB_BUCKETS + (exponent - SUB_BUCKET_BITS) * SUB_BUCKETS + sub_bucket;
+}
+
+/*
+ * The lowest value counted in bucket.
+ */
+static uint64_t bucket_value(size_t bucket) {
+	if (bucket < SUB_BUCKETS) {
+		return bucket;
+	}
+	size_t exponent = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+	return (uint64_t) (SUB_BUCKETS + (bucket - SUB_BUCKETS) % SUB_BUCKETS) << exponent;
+}
+
+static uint64_t percentile(const uint64_t histogram[static HISTOGRAM_SIZE], size_t count, double p) {
+	if (count == 0) {
+		return 0;
+	}
+	uint64_t rank = (uint64_t) ceil(p * (double) count);
+	uint64_t seen = 0;
+	for (size_t i = 0; i < HISTOGRAM_SIZE; i++) {
+		seen += histogram[i];
+		if (seen >= rank) {
+			return bucket_value(i);
+		}
+	}
+	return 0;
+}
+
+static void print_worker(const struct worker worker[static 1], uint64_t p50, uint64_t p90, uint64_t p99) {
+	cutest_output_printf(stdout,
+	                     "[   STRESS ]   thread %zu: p50 %" PRIu64 " ns, p90 %" PRIu64 " ns, p99 %" PRIu64 " ns, max %" PRIu64
+	                     " ns\n",
+	                     worker->index,
+	                     p50,
+	                     p90,
+	                     p99,
+	                     worker->max);
+}
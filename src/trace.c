@@ -0,0 +1,227 @@
+#include <buracchi/cutest/cutest.h>
+
+#include "cutest_internal.h"
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#if __has_include(<unistd.h>)
+#define HAS_GETPID 1
+#include <unistd.h>
+#endif
+
+enum {
+	RING_CAPACITY = 8192,
+};
+
+/*
+ * Events recorded by a thread since its last flush. When the ring is full the
+ * oldest events are overwritten, so that recording never blocks or writes.
+ */
+struct ring {
+	struct cutest_trace_event *event;
+	size_t head;
+	size_t size;
+	size_t dropped;
+};
+
+/*
+ * The trace file is opened for appending, and each flush writes its events
+ * with a single unbuffered write, so that worker processes forked after the
+ * trace was opened can share it.
+ */
+static struct {
+	FILE *file;
+	uint64_t origin;
+	mtx_t lock;
+	int error;
+} trace = {};
+
+static atomic_int next_thread_id = 1;
+static thread_local struct ring ring = {};
+static thread_local int thread_id = 0;
+
+static const char *const phase[] = {
+	[CUTEST_TRACE_COMPLETE] = "X",
+	[CUTEST_TRACE_INSTANT] = "i",
+	[CUTEST_TRACE_ASYNC_BEGIN] = "b",
+	[CUTEST_TRACE_ASYNC_END] = "e",
+};
+
+static bool format_event(struct cutest_buffer buffer[static 1], const struct cutest_trace_event event[static 1], int pid);
+static int process_id();
+
+extern bool cutest_trace_open(const char path[static 1]) {
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr) {
+		return false;
+	}
+	bool written = fputs("[\n", file) >= 0;
+	if (fclose(file) != 0 || !written) {
+		return false;
+	}
+	trace.file = fopen(path, "ab");
+	if (trace.file == nullptr) {
+		return false;
+	}
+	setvbuf(trace.file, nullptr, _IONBF, 0);
+	mtx_init(&trace.lock, mtx_plain);
+	trace.origin = cutest_clock_now();
+	trace.error = 0;
+	return true;
+}
+
+extern bool cutest_trace_enabled() {
+	return trace.file != nullptr;
+}
+
+extern void cutest_trace_record(const struct cutest_trace_event event[static 1]) {
+	if (trace.file == nullptr) {
+		return;
+	}
+	if (ring.event == nullptr) {
+		cutest_alloc_pause();
+		ring.event = malloc(RING_CAPACITY * sizeof *ring.event);
+		cutest_alloc_resume();
+		if (ring.event == nullptr) {
+			ring.dropped++;
+			return;
+		}
+	}
+	if (ring.size == RING_CAPACITY) {
+		ring.head = (ring.head + 1) % RING_CAPACITY;
+		ring.size--;
+		ring.dropped++;
+	}
+	ring.event[(ring.head + ring.size++) % RING_CAPACITY] = *event;
+}
+
+extern void cutest_trace_flush() {
+	if (trace.file == nullptr || (ring.size == 0 && ring.dropped == 0)) {
+		return;
+	}
+	if (thread_id == 0) {
+		thread_id = atomic_fetch_add(&next_thread_id, 1);
+	}
+	int pid = process_id();
+	struct cutest_buffer buffer = {};
+	bool result = true;
+	for (size_t i = 0; result && i < ring.size; i++) {
+		result = format_event(&buffer, &ring.event[(ring.head + i) % RING_CAPACITY], pid);
+	}
+	if (result && ring.dropped != 0) {
+		result = cutest_buffer_printf(&buffer,
+		                              "{\"name\":\"events dropped\",\"cat\":\"cutest\",\"ph\":\"i\",\"s\":\"t\","
+		                              "\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"args\":{\"count\":%zu}},\n",
+		                              (double) (cutest_clock_now() - trace.origin) / 1e3,
+		                              pid,
+		                              thread_id,
+		                              ring.dropped);
+	}
+	ring.head = 0;
+	ring.size = 0;
+	ring.dropped = 0;
+	mtx_lock(&trace.lock);
+	if (!result) {
+		trace.error = ENOMEM;
+	}
+	else if (fwrite(buffer.data, 1, buffer.size, trace.file) != buffer.size && trace.error == 0) {
+		trace.error = errno;
+	}
+	mtx_unlock(&trace.lock);
+	cutest_buffer_destroy(&buffer);
+}
+
+extern void cutest_trace_thread_end() {
+	cutest_trace_flush();
+	free(ring.event);
+	ring = (struct ring) {};
+}
+
+/*
+ * The array ends with a metadata event naming the process of the runner, which
+ * has no separator after it.
+ */
+extern bool cutest_trace_close() {
+	cutest_trace_thread_end();
+	fprintf(trace.file,
+	        "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"cutest\"}}\n]\n",
+	        process_id());
+	int error = trace.error;
+	if (ferror(trace.file) && error == 0) {
+		error = EIO;
+	}
+	if (fclose(trace.file) != 0 && error == 0) {
+		error = errno;
+	}
+	mtx_destroy(&trace.lock);
+	trace.file = nullptr;
+	errno = error;
+	return error == 0;
+}
+
+extern struct cutest_trace_scope_ cutest_trace_scope_begin_(const char name[static 1]) {
+	return (struct cutest_trace_scope_) {
+		.name = name,
+		.start_time = (trace.file != nullptr) ? cutest_clock_now() : 0,
+		.running = true,
+	};
+}
+
+extern void cutest_trace_scope_end_(struct cutest_trace_scope_ scope[static 1]) {
+	scope->running = false;
+	if (trace.file == nullptr) {
+		return;
+	}
+	uint64_t end_time = cutest_clock_now();
+	cutest_trace_record(&(struct cutest_trace_event) {
+		.phase = CUTEST_TRACE_COMPLETE,
+		.category = "scope",
+		.name = scope->name,
+		.time = scope->start_time,
+		.duration = end_time - scope->start_time,
+	});
+}
+
+static bool format_event(struct cutest_buffer buffer[static 1], const struct cutest_trace_event event[static 1], int pid) {
+	bool result = cutest_buffer_printf(buffer, "{\"name\":\"");
+	if (event->suite_name != nullptr) {
+		result = result && cutest_buffer_append_json(buffer, event->suite_name) && cutest_buffer_append(buffer, ".", 1);
+	}
+	result = result && cutest_buffer_append_json(buffer, event->name)
+	      && cutest_buffer_printf(buffer,
+	                              "\",\"cat\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+	                              event->category,
+	                              phase[event->phase],
+	                              (double) (event->time - trace.origin) / 1e3,
+	                              pid,
+	                              thread_id);
+	if (event->phase == CUTEST_TRACE_COMPLETE) {
+		result = result && cutest_buffer_printf(buffer, ",\"dur\":%.3f", (double) event->duration / 1e3);
+	}
+	else if (event->phase == CUTEST_TRACE_INSTANT) {
+		result = result && cutest_buffer_printf(buffer, ",\"s\":\"t\"");
+	}
+	else {
+		result = result && cutest_buffer_printf(buffer, ",\"id\":\"0x%" PRIx64 "\"", event->id);
+	}
+	if (event->file != nullptr) {
+		result = result && cutest_buffer_printf(buffer, ",\"args\":{\"file\":\"")
+		      && cutest_buffer_append_json(buffer, event->file)
+		      && cutest_buffer_printf(buffer, "\",\"line\":%d}", event->line);
+	}
+	return result && cutest_buffer_printf(buffer, "},\n");
+}
+
+static int process_id() {
+#ifdef HAS_GETPID
+	return (int) getpid();
+#else
+	return 1;
+#endif
+}
@@ -0,0 +1,51 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Allocations stored here cannot be elided by the compiler.
+ */
+static void *volatile sink;
+
+TEST(alloc, no_alloc) {
+	char buffer[64];
+	EXPECT_NO_ALLOC() {
+		memset(buffer, 'a', sizeof buffer);
+		sink = buffer;
+	}
+}
+
+TEST(alloc, within_budget) {
+	EXPECT_ALLOCS_LE(3) {
+		sink = malloc(16);
+		sink = realloc(sink, 4096);
+		free(sink);
+		sink = calloc(4, 8);
+		free(sink);
+	}
+}
+
+TEST(alloc, frees_are_free) {
+	sink = malloc(32);
+	EXPECT_NO_ALLOC() {
+		free(sink);
+	}
+}
+
+TEST(mismatch, over_budget) {
+	EXPECT_ALLOCS_LE(1, "while building the list") {
+		for (size_t i = 0; i < 3; i++) {
+			sink = malloc(100);
+			free(sink);
+		}
+	}
+}
+
+/*
+ * Passes, but leaks its blocks.
+ */
+TEST(mismatch, leak) {
+	sink = malloc(100);
+	sink = malloc(200);
+}
@@ -0,0 +1,42 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <string.h>
+
+static unsigned fibonacci(unsigned n) {
+	return (n < 2) ? n : fibonacci(n - 1) + fibonacci(n - 2);
+}
+
+TEST(fibonacci, small_values) {
+	EXPECT_EQ(fibonacci(0), 0);
+	EXPECT_EQ(fibonacci(1), 1);
+	EXPECT_EQ(fibonacci(10), 55);
+}
+
+TEST(fibonacci, instruction_budget) {
+	unsigned result = 0;
+	EXPECT_INSTRUCTIONS_LE(1000000) {
+		result = fibonacci(15);
+	}
+	EXPECT_EQ(result, 610);
+}
+
+BENCHMARK(fibonacci, recursive_20) {
+	unsigned n = 20;
+	cutest_benchmark_set_items_per_iteration(state, 1);
+	while (cutest_benchmark_loop(state)) {
+		cutest_do_not_optimize(n);
+		unsigned result = fibonacci(n);
+		cutest_do_not_optimize(result);
+	}
+}
+
+BENCHMARK(memory, copy_4k) {
+	static char source[4096];
+	static char destination[4096];
+	cutest_benchmark_set_bytes_per_iteration(state, sizeof source);
+	while (cutest_benchmark_loop(state)) {
+		memcpy(destination, source, sizeof source);
+		cutest_clobber_memory();
+	}
+	EXPECT_EQ(memcmp(destination, source, sizeof source), 0);
+}
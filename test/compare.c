@@ -0,0 +1,111 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <math.h>
+#include <stdint.h>
+
+/*
+ * Sizes around the blocks of the vectorized kernels, to cover the whole blocks
+ * and the elements after them.
+ */
+static const size_t sizes[] = {0, 1, 7, 31, 32, 33, 63, 64, 65, 1000};
+
+TEST(memeq, equal_blocks) {
+	unsigned char lhs[1000];
+	unsigned char rhs[1000];
+	for (size_t i = 0; i < sizeof lhs; i++) {
+		lhs[i] = rhs[i] = (unsigned char) (i * 7);
+	}
+	for (size_t i = 0; i < sizeof sizes / sizeof *sizes; i++) {
+		EXPECT_MEMEQ(lhs, rhs, sizes[i], "size %zu", sizes[i]);
+	}
+}
+
+TEST(memeq, unaligned_blocks) {
+	unsigned char lhs[128] = {};
+	unsigned char rhs[128] = {};
+	for (size_t i = 1; i < 32; i++) {
+		EXPECT_MEMEQ(lhs + i, rhs + 32 - i, 96, "offset %zu", i);
+	}
+}
+
+TEST(array_eq, integers) {
+	uint16_t lhs_16[1000];
+	uint32_t lhs_32[1000];
+	uint64_t lhs_64[1000];
+	for (size_t i = 0; i < 1000; i++) {
+		lhs_16[i] = (uint16_t) i;
+		lhs_32[i] = (uint32_t) i * 3;
+		lhs_64[i] = (uint64_t) i << 40;
+	}
+	const uint16_t *rhs_16 = lhs_16;
+	for (size_t i = 0; i < sizeof sizes / sizeof *sizes; i++) {
+		uint32_t rhs_32[1000];
+		uint64_t rhs_64[1000];
+		memcpy(rhs_32, lhs_32, sizeof rhs_32);
+		memcpy(rhs_64, lhs_64, sizeof rhs_64);
+		EXPECT_ARRAY_EQ(lhs_16, rhs_16, sizes[i]);
+		EXPECT_ARRAY_EQ(lhs_32, rhs_32, sizes[i]);
+		EXPECT_ARRAY_EQ(lhs_64, rhs_64, sizes[i]);
+	}
+}
+
+TEST(array_eq, structures) {
+	struct rgb {
+		unsigned char r, g, b;
+	} lhs[] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+	struct rgb rhs[] = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}};
+	ASSERT_ARRAY_EQ(lhs, rhs, 3);
+}
+
+TEST(array_float_ulp_near, within_ulps) {
+	float lhs_f[100];
+	float rhs_f[100];
+	double lhs_d[100];
+	double rhs_d[100];
+	for (size_t i = 0; i < 100; i++) {
+		lhs_f[i] = (float) i / 7.0f - 5.0f;
+		rhs_f[i] = nextafterf(nextafterf(lhs_f[i], INFINITY), INFINITY);
+		lhs_d[i] = (double) i / 7.0 - 5.0;
+		rhs_d[i] = nextafter(nextafter(lhs_d[i], -INFINITY), -INFINITY);
+	}
+	EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs_f, rhs_f, 100, 2);
+	EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs_d, rhs_d, 100, 2);
+}
+
+TEST(array_float_ulp_near, signed_zeros) {
+	const double lhs[] = {0.0, -0.0, 0.0, -0.0, 1.0, 0.0, -0.0, 0.0};
+	const double rhs[] = {-0.0, 0.0, 0.0, -0.0, 1.0, -0.0, 0.0, 0.0};
+	EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs, rhs, 8, 0);
+}
+
+TEST(array_float_ulp_near, long_double) {
+	const long double lhs[] = {1.0L, 2.0L, 3.0L};
+	const long double rhs[] = {1.0L, 2.0L, 3.0L};
+	EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs, rhs, 3, 4);
+}
+
+TEST(mismatch, memory) {
+	unsigned char lhs[100] = {};
+	unsigned char rhs[100] = {};
+	rhs[40] = 0xab;
+	rhs[95] = 0xcd;
+	EXPECT_MEMEQ(lhs, rhs, sizeof lhs);
+}
+
+TEST(mismatch, integers) {
+	int32_t lhs[100] = {};
+	int32_t rhs[100] = {};
+	for (size_t i = 31; i < 100; i += 7) {
+		rhs[i] = -1;
+	}
+	EXPECT_ARRAY_EQ(lhs, rhs, 100);
+}
+
+TEST(mismatch, floats) {
+	float lhs[40] = {};
+	float rhs[40] = {};
+	lhs[35] = 1.0f;
+	rhs[35] = nextafterf(nextafterf(1.0f, 2.0f), 2.0f);
+	rhs[36] = NAN;
+	EXPECT_ARRAY_FLOAT_ULP_NEAR(lhs, rhs, 40, 1);
+}
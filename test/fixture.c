@@ -0,0 +1,78 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <stdlib.h>
+
+static size_t environment_set_ups;
+static size_t table_suite_set_ups;
+static int *table_rows;
+
+static void count_set_up(void *context) {
+	(*(size_t *) context)++;
+}
+
+static const struct cutest_environment environment = {
+	.set_up = count_set_up,
+	.context = &environment_set_ups,
+};
+
+[[gnu::constructor]]
+static void register_environment() {
+	cutest_environment_add(&environment);
+}
+
+FIXTURE(table) {
+	int *row;
+	size_t size;
+};
+
+FIXTURE_SET_UP_SUITE(table) {
+	table_suite_set_ups++;
+	table_rows = calloc(64, sizeof *table_rows);
+	ASSERT_NE(table_rows, nullptr);
+}
+
+FIXTURE_TEAR_DOWN_SUITE(table) {
+	free(table_rows);
+	table_rows = nullptr;
+}
+
+FIXTURE_SET_UP(table) {
+	fixture->size = 4;
+	fixture->row = calloc(fixture->size, sizeof *fixture->row);
+	ASSERT_NE(fixture->row, nullptr);
+}
+
+FIXTURE_TEAR_DOWN(table) {
+	free(fixture->row);
+}
+
+TEST_F(table, suite_set_up_runs_once) {
+	EXPECT_EQ(table_suite_set_ups, 1);
+	EXPECT_NE(table_rows, nullptr);
+}
+
+TEST_F(table, set_up_runs_before_each_test) {
+	EXPECT_EQ(fixture->size, 4);
+	fixture->row[0] = 1;
+}
+
+TEST_F(table, fixture_is_not_shared_between_tests) {
+	EXPECT_EQ(fixture->row[0], 0);
+}
+
+TEST(environment, set_up_runs_before_the_tests) {
+	EXPECT_EQ(environment_set_ups, 1);
+}
+
+FIXTURE(mismatch) {
+	int unused;
+};
+
+// Fails the tests of its suite before they run.
+FIXTURE_SET_UP_SUITE(mismatch) {
+	ASSERT_TRUE(false, "in the set-up of the suite");
+}
+
+TEST_F(mismatch, first) {}
+
+TEST_F(mismatch, second) {}
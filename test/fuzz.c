@@ -0,0 +1,60 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*
+ * Run-length encoding as pairs of a count and a byte, the code under test of
+ * the round trip property.
+ */
+static size_t rle_encode(const uint8_t data[], size_t size, uint8_t encoded[]) {
+	size_t length = 0;
+	for (size_t i = 0; i < size;) {
+		size_t run = 1;
+		for (; i + run < size && run < 255 && data[i + run] == data[i]; run++);
+		encoded[length++] = (uint8_t) run;
+		encoded[length++] = data[i];
+		i += run;
+	}
+	return length;
+}
+
+static size_t rle_decode(const uint8_t encoded[], size_t size, uint8_t data[]) {
+	size_t length = 0;
+	for (size_t i = 0; i + 1 < size; i += 2) {
+		for (size_t j = 0; j < encoded[i]; j++) {
+			data[length++] = encoded[i + 1];
+		}
+	}
+	return length;
+}
+
+FUZZ_TEST(rle, round_trip, const uint8_t *data, size_t size) {
+	uint8_t *encoded = malloc(2 * size + 1);
+	uint8_t *decoded = malloc(size + 1);
+	ASSERT_TRUE(encoded != nullptr && decoded != nullptr);
+	size_t encoded_size = rle_encode(data, size, encoded);
+	EXPECT_LE(encoded_size, 2 * size);
+	EXPECT_EQ(rle_decode(encoded, encoded_size, decoded), size);
+	EXPECT_MEMEQ(decoded, data, size);
+	free(decoded);
+	free(encoded);
+}
+
+/*
+ * A bug for the fuzzer to find.
+ */
+FUZZ_TEST(mismatch, magic, const uint8_t *data, size_t size) {
+	if (size >= 3 && data[0] == 'B') {
+		if (data[1] == 'U') {
+			EXPECT_NE(data[2], 'G', "Found the bug.");
+		}
+	}
+}
+
+/*
+ * Fails on an input of its corpus.
+ */
+FUZZ_TEST(mismatch, replay, const uint8_t *data, size_t size) {
+	EXPECT_FALSE(size == 3 && data[0] == 'a');
+}
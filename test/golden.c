@@ -0,0 +1,52 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <string.h>
+
+static const char greeting[] = "Hello, golden world!\nThe second line.\n";
+
+static void fill_bytes(unsigned char bytes[static 1000]) {
+	for (size_t i = 0; i < 1000; i++) {
+		bytes[i] = (unsigned char) (i * 31 + 7);
+	}
+}
+
+TEST(golden, text) {
+	EXPECT_MATCHES_GOLDEN(greeting, strlen(greeting), "golden/greeting.txt");
+}
+
+TEST(golden, binary) {
+	unsigned char bytes[1000];
+	fill_bytes(bytes);
+	EXPECT_MATCHES_GOLDEN(bytes, sizeof bytes, "golden/bytes.bin");
+}
+
+TEST(golden, empty) {
+	EXPECT_MATCHES_GOLDEN("", 0, "golden/empty.bin");
+}
+
+/*
+ * The tests of the update suite write their golden file in the build tree when
+ * run by test_golden_update, and test_golden_updated checks them afterwards.
+ */
+TEST(update, snapshot) {
+	unsigned char bytes[1000];
+	fill_bytes(bytes);
+	bytes[500] = 0;
+	EXPECT_MATCHES_GOLDEN(bytes, sizeof bytes, GOLDEN_OUTPUT_DIR "/snapshot.bin");
+}
+
+TEST(mismatch, text) {
+	const char text[] = "Hello, golden world!\nThe 2nd line.\n";
+	EXPECT_MATCHES_GOLDEN(text, strlen(text), "golden/greeting.txt");
+}
+
+TEST(mismatch, binary) {
+	unsigned char bytes[1000];
+	fill_bytes(bytes);
+	bytes[300] ^= 0xff;
+	EXPECT_MATCHES_GOLDEN(bytes, 900, "golden/bytes.bin");
+}
+
+TEST(mismatch, missing) {
+	EXPECT_MATCHES_GOLDEN(greeting, strlen(greeting), "golden/missing.txt");
+}
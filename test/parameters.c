@@ -0,0 +1,57 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+struct rle_vector {
+	const char *plain;
+	const char *encoded;
+};
+
+static const struct rle_vector rle_vectors[] = {
+	{"", ""},
+	{"a", "1a"},
+	{"aaa", "3a"},
+	{"aab", "2a1b"},
+	{"abba", "1a2b1a"},
+};
+
+static void rle_encode(const char plain[static 1], char encoded[static 1]) {
+	while (*plain != '\0') {
+		size_t length = strspn(plain, (char[]) {*plain, '\0'});
+		encoded += sprintf(encoded, "%zu%c", length, *plain);
+		plain += length;
+	}
+	*encoded = '\0';
+}
+
+TEST_P(rle, encode, struct rle_vector) {
+	char encoded[32];
+	rle_encode(param->plain, encoded);
+	EXPECT_STREQ(encoded, param->encoded);
+}
+
+TEST_P(rle, encoded_is_not_shorter_than_runs, struct rle_vector) {
+	EXPECT_GE(strlen(param->encoded), 2 * strlen(param->plain) / (strlen(param->plain) + 1));
+}
+
+INSTANTIATE_TEST_SUITE_P(vectors, rle, rle_vectors);
+
+TEST_P(power_of_two, is_power_of_two, unsigned) {
+	EXPECT_NE(*param, 0U);
+	EXPECT_EQ(*param & (*param - 1), 0U);
+}
+
+static void power_of_two(size_t index, unsigned parameter[static 1]) {
+	*parameter = 1U << index;
+}
+
+INSTANTIATE_TEST_SUITE_P_GENERATOR(generated, power_of_two, 16, power_of_two);
+
+TEST_P(parity, multiple_of_step, int) {
+	EXPECT_EQ(*param % 3, 0);
+	EXPECT_LT(*param, 100);
+}
+
+INSTANTIATE_TEST_SUITE_P_RANGE(range, parity, 0, 100, 3);
@@ -0,0 +1,20 @@
+#include <buracchi/cutest/cutest.h>
+
+TEST(order, first) {
+}
+
+TEST(order, second) {
+}
+
+TEST(order, third) {
+}
+
+TEST(mismatch, flaky) {
+	static int runs = 0;
+	EXPECT_NE(++runs, 1, "on the first run");
+}
+
+TEST(mismatch, third_run) {
+	static int runs = 0;
+	EXPECT_LT(++runs, 3);
+}
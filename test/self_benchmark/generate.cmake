@@ -0,0 +1,11 @@
+# Write to OUTPUT a source file with the TEST()s of index FIRST to LAST of a
+# synthetic test program with TESTS tests spread evenly over SUITES suites.
+cmake_minimum_required(VERSION 3.31)
+
+math(EXPR tests_per_suite "${TESTS} / ${SUITES}")
+set(source "#include <buracchi/cutest/cutest.h>\n\n")
+foreach(index RANGE ${FIRST} ${LAST})
+    math(EXPR suite "${index} / ${tests_per_suite}")
+    string(APPEND source "TEST(suite${suite}, test${index}) {\n}\n\n")
+endforeach()
+file(WRITE "${OUTPUT}" "${source}")
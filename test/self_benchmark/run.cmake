@@ -0,0 +1,86 @@
+# Run the self-benchmark and time the synthetic test programs, listed in
+# SYNTHETIC as tests:suites:path separated by |, writing the table of the
+# results to OUTPUT and to the console. Every synthetic program is timed running
+# no test, which is its start-up and the registration and filtering of its
+# tests, and running all of them, the difference being the dispatch of the
+# tests. When COMPILER is set, SOURCE, one of the generated sources, is
+# compiled with and without its TEST()s to measure what each of them costs to
+# compile and in object size.
+cmake_minimum_required(VERSION 3.31)
+
+set(repetitions 5)
+
+# The best wall time in microseconds of repetitions runs of the command.
+function(time_command result_var)
+    set(best "")
+    foreach(repetition RANGE 1 ${repetitions})
+        string(TIMESTAMP start_time "%s%f" UTC)
+        execute_process(COMMAND ${ARGN}
+                        OUTPUT_FILE "${WORKING_DIR}/output.txt"
+                        ERROR_FILE "${WORKING_DIR}/output.txt"
+                        RESULT_VARIABLE result)
+        string(TIMESTAMP end_time "%s%f" UTC)
+        if(NOT result EQUAL 0)
+            message(FATAL_ERROR "${ARGN} failed: ${result}")
+        endif()
+        math(EXPR time "${end_time} - ${start_time}")
+        if(best STREQUAL "" OR time LESS best)
+            set(best ${time})
+        endif()
+    endforeach()
+    set(${result_var} ${best} PARENT_SCOPE)
+endfunction()
+
+# Format numerator / denominator with two decimals.
+function(format_ratio result_var numerator denominator)
+    math(EXPR hundredths "${numerator} * 100 / ${denominator}")
+    math(EXPR integer "${hundredths} / 100")
+    math(EXPR fraction "${hundredths} % 100")
+    if(fraction LESS 10)
+        set(fraction "0${fraction}")
+    endif()
+    set(${result_var} "${integer}.${fraction}" PARENT_SCOPE)
+endfunction()
+
+execute_process(COMMAND "${BENCHMARK}" OUTPUT_VARIABLE table RESULT_VARIABLE result)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "${BENCHMARK} failed: ${result}")
+endif()
+
+string(REPLACE "|" ";" SYNTHETIC "${SYNTHETIC}")
+foreach(synthetic IN LISTS SYNTHETIC)
+    string(REGEX MATCH "^([0-9]+):([0-9]+):(.*)$" synthetic "${synthetic}")
+    set(tests ${CMAKE_MATCH_1})
+    set(suites ${CMAKE_MATCH_2})
+    set(program "${CMAKE_MATCH_3}")
+    set(configuration "tests=${tests},suites=${suites}")
+    time_command(startup_time "${program}" "--cutest_filter=-*")
+    time_command(run_time "${program}")
+    math(EXPR startup_time_ns "${startup_time} * 1000")
+    math(EXPR dispatch_time_ns "(${run_time} - ${startup_time}) * 1000")
+    format_ratio(startup "${startup_time_ns}" "${tests}")
+    format_ratio(dispatch "${dispatch_time_ns}" "${tests}")
+    string(APPEND table "startup\t${configuration}\t${startup}\tns/test\n")
+    string(APPEND table "dispatch\t${configuration}\t${dispatch}\tns/test\n")
+endforeach()
+
+if(COMPILER)
+    set(empty_source "${WORKING_DIR}/empty.c")
+    file(WRITE "${empty_source}" "#include <buracchi/cutest/cutest.h>\n")
+    file(STRINGS "${SOURCE}" test_lines REGEX "^TEST\\(")
+    list(LENGTH test_lines tests)
+    separate_arguments(flags NATIVE_COMMAND "${FLAGS}")
+    time_command(empty_time "${COMPILER}" ${flags} "-I${INCLUDE_DIR}" -c "${empty_source}" -o "${WORKING_DIR}/empty.o")
+    time_command(source_time "${COMPILER}" ${flags} "-I${INCLUDE_DIR}" -c "${SOURCE}" -o "${WORKING_DIR}/source.o")
+    file(SIZE "${WORKING_DIR}/empty.o" empty_size)
+    file(SIZE "${WORKING_DIR}/source.o" source_size)
+    math(EXPR compile_time "${source_time} - ${empty_time}")
+    math(EXPR object_size "${source_size} - ${empty_size}")
+    format_ratio(compile "${compile_time}" "${tests}")
+    format_ratio(size "${object_size}" "${tests}")
+    string(APPEND table "compile_time\tTEST()\t${compile}\tus/test\n")
+    string(APPEND table "object_size\tTEST()\t${size}\tbytes/test\n")
+endif()
+
+file(WRITE "${OUTPUT}" "${table}")
+message("${table}")
@@ -0,0 +1,284 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Measures what cutest itself costs, printing a tab-separated table with a row
+ * per measurement. It has a main of its own, so that it can also fail
+ * assertions outside of a test run by cutest_main, where they are attributed
+ * by the name of the failing function.
+ */
+
+enum {
+	REPETITIONS = 5,
+	PASSING_ITERATIONS = 10000000,
+	FAILING_ITERATIONS = 100000,
+	PADDING_SUITES = 100,
+	PADDING_TESTS = 10000,
+	NAME_SIZE = 32,
+};
+
+struct registration_size {
+	size_t tests;
+	size_t suites;
+};
+
+struct assertion_benchmark {
+	const char *name;
+	void (*run)(size_t iterations);
+};
+
+static void run_expect_true(size_t iterations);
+static void run_expect_eq(size_t iterations);
+static void run_expect_streq(size_t iterations);
+static void run_expect_strcase_eq(size_t iterations);
+static void run_expect_double_eq(size_t iterations);
+static void run_expect_near(size_t iterations);
+static void run_expect_memeq(size_t iterations);
+static void run_expect_array_eq(size_t iterations);
+static void run_failing_assertions(size_t iterations);
+static void run_failing_test(size_t iterations);
+static void measure_registration(struct registration_size size);
+static void measure_failures();
+static double measure(void run(size_t iterations), size_t iterations);
+static char (*names_create(const char prefix[static 1], size_t count))[NAME_SIZE];
+static void empty_test();
+static uint64_t now();
+
+static const struct registration_size registration_sizes[] = {
+	{.tests = 1000, .suites = 10},
+	{.tests = 1000, .suites = 100},
+	{.tests = 10000, .suites = 10},
+	{.tests = 10000, .suites = 1000},
+	{.tests = 100000, .suites = 10},
+	{.tests = 100000, .suites = 10000},
+};
+
+static const struct assertion_benchmark assertion_benchmarks[] = {
+	{"EXPECT_TRUE", run_expect_true},
+	{"EXPECT_EQ", run_expect_eq},
+	{"EXPECT_STREQ", run_expect_streq},
+	{"EXPECT_STRCASE_EQ", run_expect_strcase_eq},
+	{"EXPECT_DOUBLE_EQ", run_expect_double_eq},
+	{"EXPECT_NEAR", run_expect_near},
+	{"EXPECT_MEMEQ", run_expect_memeq},
+	{"EXPECT_ARRAY_EQ", run_expect_array_eq},
+};
+
+/*
+ * Called directly by main, the assertions of this test find it by name.
+ */
+TEST(self_benchmark, fails) {
+	int value = 1;
+	cutest_do_not_optimize(value);
+	EXPECT_EQ(value, 0);
+}
+
+int main() {
+	// Without the console listener the failures cost what cutest does to
+	// record them, rather than the writes to the terminal.
+	cutest_listener_remove(&cutest_console_listener);
+	printf("benchmark\tconfiguration\tvalue\tunit\n");
+	for (size_t i = 0; i < sizeof registration_sizes / sizeof *registration_sizes; i++) {
+		measure_registration(registration_sizes[i]);
+	}
+	for (size_t i = 0; i < sizeof assertion_benchmarks / sizeof *assertion_benchmarks; i++) {
+		double time = measure(assertion_benchmarks[i].run, PASSING_ITERATIONS);
+		printf("passing_assertion\t%s\t%.2f\tns/assertion\n", assertion_benchmarks[i].name, time);
+	}
+	measure_failures();
+	return EXIT_SUCCESS;
+}
+
+static void run_expect_true(size_t iterations) {
+	bool value = true;
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_TRUE(value);
+	}
+}
+
+static void run_expect_eq(size_t iterations) {
+	int value = 1;
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_EQ(value, 1);
+	}
+}
+
+static void run_expect_streq(size_t iterations) {
+	const char *value = "cutest";
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_STREQ(value, "cutest");
+	}
+}
+
+static void run_expect_strcase_eq(size_t iterations) {
+	const char *value = "cutest";
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_STRCASE_EQ(value, "CuTest");
+	}
+}
+
+static void run_expect_double_eq(size_t iterations) {
+	double value = 0.1;
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_DOUBLE_EQ(value, 0.1);
+	}
+}
+
+static void run_expect_near(size_t iterations) {
+	double value = 0.1;
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_NEAR(value, 0.1, 1e-9);
+	}
+}
+
+static void run_expect_memeq(size_t iterations) {
+	static const unsigned char zeros[64];
+	unsigned char value[64] = {};
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_clobber_memory();
+		EXPECT_MEMEQ(value, zeros, sizeof value);
+	}
+}
+
+static void run_expect_array_eq(size_t iterations) {
+	static const int zeros[16];
+	int value[16] = {};
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_clobber_memory();
+		EXPECT_ARRAY_EQ(value, zeros, 16);
+	}
+}
+
+static void run_failing_assertions(size_t iterations) {
+	int value = 1;
+	for (size_t i = 0; i < iterations; i++) {
+		cutest_do_not_optimize(value);
+		EXPECT_EQ(value, 0);
+	}
+}
+
+static void run_failing_test(size_t iterations) {
+	for (size_t i = 0; i < iterations; i++) {
+		test_self_benchmarkfails();
+	}
+}
+
+/*
+ * Registers the tests in a registry of their own, as TEST() does at start-up,
+ * then looks their suites up once per test.
+ */
+static void measure_registration(struct registration_size size) {
+	char (*suite_name)[NAME_SIZE] = names_create("suite", size.suites);
+	char (*test_name)[NAME_SIZE] = names_create("test", size.tests);
+	struct cutest *cutest = cutest_init(1, 1);
+	if (cutest == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	size_t tests_per_suite = size.tests / size.suites;
+	uint64_t start_time = now();
+	for (size_t i = 0; i < size.tests; i++) {
+		if (cutest_test_add(cutest, suite_name[i / tests_per_suite], test_name[i], empty_test) == nullptr) {
+			perror(strerror(errno));
+			exit(1);
+		}
+	}
+	uint64_t registration_time = now() - start_time;
+	start_time = now();
+	for (size_t i = 0; i < size.tests; i++) {
+		struct cutest_test_suite *suite = cutest_test_suite_get(cutest, suite_name[i % size.suites]);
+		cutest_do_not_optimize(suite);
+	}
+	uint64_t lookup_time = now() - start_time;
+	printf("registration\ttests=%zu,suites=%zu\t%.2f\tns/test\n",
+	       size.tests,
+	       size.suites,
+	       (double) registration_time / (double) size.tests);
+	printf("suite_lookup\ttests=%zu,suites=%zu\t%.2f\tns/lookup\n",
+	       size.tests,
+	       size.suites,
+	       (double) lookup_time / (double) size.tests);
+	cutest_destroy(cutest);
+	free(test_name);
+	free(suite_name);
+}
+
+/*
+ * Failures inside a test go straight to it, failures outside of one look the
+ * test up by the name of the failing function. For the lookup to scan the
+ * whole registry, the suite of the failing test is moved after the padding.
+ */
+static void measure_failures() {
+	struct cutest_test target = {.name = "target"};
+	cutest_thread_attach((struct cutest_thread_context) {.test = &target});
+	double time = measure(run_failing_assertions, FAILING_ITERATIONS);
+	cutest_thread_attach((struct cutest_thread_context) {});
+	printf("failing_assertion\tin_test\t%.2f\tns/failure\n", time);
+	char (*suite_name)[NAME_SIZE] = names_create("padding", PADDING_SUITES);
+	char (*test_name)[NAME_SIZE] = names_create("test", PADDING_TESTS);
+	for (size_t i = 0; i < PADDING_TESTS; i++) {
+		cutest_test_add_(suite_name[i % PADDING_SUITES], test_name[i], empty_test);
+	}
+	for (size_t i = 0; i + 1 < cutest_->size; i++) {
+		if (strcmp(cutest_->suite[i].name, "self_benchmark") == 0) {
+			struct cutest_test_suite suite = cutest_->suite[i];
+			cutest_->suite[i] = cutest_->suite[cutest_->size - 1];
+			cutest_->suite[cutest_->size - 1] = suite;
+			break;
+		}
+	}
+	time = measure(run_failing_test, FAILING_ITERATIONS);
+	printf("failing_assertion\tby_name,tests=%d,suites=%d\t%.2f\tns/failure\n", PADDING_TESTS, PADDING_SUITES, time);
+	// The registry refers to the names of the padding.
+	cutest_destroy(cutest_);
+	cutest_ = nullptr;
+	free(test_name);
+	free(suite_name);
+}
+
+/*
+ * The best time per iteration in nanoseconds out of REPETITIONS runs.
+ */
+static double measure(void run(size_t iterations), size_t iterations) {
+	double best = INFINITY;
+	for (size_t i = 0; i < REPETITIONS; i++) {
+		uint64_t start_time = now();
+		run(iterations);
+		best = fmin(best, (double) (now() - start_time) / (double) iterations);
+	}
+	return best;
+}
+
+static char (*names_create(const char prefix[static 1], size_t count))[NAME_SIZE] {
+	char (*name)[NAME_SIZE] = malloc(count * sizeof *name);
+	if (name == nullptr) {
+		perror(strerror(errno));
+		exit(1);
+	}
+	for (size_t i = 0; i < count; i++) {
+		snprintf(name[i], sizeof name[i], "%s%zu", prefix, i);
+	}
+	return name;
+}
+
+static void empty_test() {
+}
+
+static uint64_t now() {
+	struct timespec time;
+	timespec_get(&time, TIME_UTC);
+	return (uint64_t) time.tv_sec * 1000000000 + (uint64_t) time.tv_nsec;
+}
@@ -0,0 +1,120 @@
+#include <buracchi/cutest/cutest.h>
+
+#include <stdatomic.h>
+#include <threads.h>
+
+enum {
+	THREADS = 4,
+};
+
+/*
+ * Lets mismatch.unattributed fail while mismatch.companion runs on another
+ * worker, so that its failures cannot go to the only running test.
+ */
+static atomic_bool companion_running = false;
+static atomic_bool unattributed_done = false;
+
+/*
+ * The assertions return nothing when fatal, and are made in functions called
+ * by the start functions of the threads.
+ */
+static void check_index(const int index[static 1]) {
+	EXPECT_GE(*index, 0);
+	EXPECT_LT(*index, THREADS);
+}
+
+static void check_attached(const struct cutest_thread_context context[static 1]) {
+	cutest_thread_attach(*context);
+	EXPECT_TRUE(cutest_thread_context().test == context->test);
+	cutest_thread_attach((struct cutest_thread_context) {});
+}
+
+static void fail_index(const int index[static 1]) {
+	EXPECT_EQ(*index, -1, "from thread %d", *index);
+}
+
+static int run_check_index(void *arg) {
+	check_index(arg);
+	return 0;
+}
+
+static int run_check_attached(void *arg) {
+	check_attached(arg);
+	return 0;
+}
+
+static int run_fail_index(void *arg) {
+	fail_index(arg);
+	return 0;
+}
+
+static void increment(void *context, size_t thread, size_t iteration) {
+	(void) thread;
+	(void) iteration;
+	atomic_fetch_add_explicit((atomic_size_t *) context, 1, memory_order_relaxed);
+}
+
+static void fail_every_thousandth(void *context, size_t thread, size_t iteration) {
+	(void) context;
+	EXPECT_NE(iteration % 1000, 999, "from thread %zu", thread);
+}
+
+static void spawn_threads(int function(void *arg)) {
+	thrd_t thread[THREADS];
+	int index[THREADS];
+	for (int i = 0; i < THREADS; i++) {
+		index[i] = i;
+		ASSERT_EQ(thrd_create(&thread[i], function, &index[i]), thrd_success);
+	}
+	for (int i = 0; i < THREADS; i++) {
+		thrd_join(thread[i], nullptr);
+	}
+}
+
+TEST(threads, assertions) {
+	spawn_threads(run_check_index);
+}
+
+TEST(threads, attach) {
+	struct cutest_thread_context context = cutest_thread_context();
+	ASSERT_TRUE(context.test != nullptr);
+	thrd_t thread[THREADS];
+	for (int i = 0; i < THREADS; i++) {
+		ASSERT_EQ(thrd_create(&thread[i], run_check_attached, &context), thrd_success);
+	}
+	for (int i = 0; i < THREADS; i++) {
+		thrd_join(thread[i], nullptr);
+	}
+}
+
+TEST(stress, counter) {
+	atomic_size_t counter = 0;
+	struct cutest_stress_result result = CUTEST_STRESS(THREADS, 10000, increment, &counter);
+	EXPECT_EQ(atomic_load(&counter), THREADS * 10000);
+	EXPECT_GT(result.throughput, 0);
+	EXPECT_LE(result.p50, result.p99);
+	EXPECT_LE(result.p99, result.max);
+}
+
+TEST(mismatch, threads) {
+	spawn_threads(run_fail_index);
+}
+
+TEST(mismatch, stress) {
+	CUTEST_STRESS(THREADS, 2000, fail_every_thousandth, nullptr);
+}
+
+TEST(mismatch, unattributed) {
+	for (int i = 0; i < 5000 && !atomic_load(&companion_running); i++) {
+		thrd_sleep(&(struct timespec) {.tv_nsec = 1000000}, nullptr);
+	}
+	spawn_threads(run_fail_index);
+	atomic_store(&unattributed_done, true);
+}
+
+TEST(mismatch, companion) {
+	atomic_store(&companion_running, true);
+	for (int i = 0; i < 5000 && !atomic_load(&unattributed_done); i++) {
+		thrd_sleep(&(struct timespec) {.tv_nsec = 1000000}, nullptr);
+	}
+}